@@ -258,7 +258,7 @@ std::unique_ptr<BeamlineNode> Group::releaseNodeFromTree(const BeamlineNode* nod
     throw std::runtime_error("Attempted to release a node that is not part of this Group or its children!");
 }
 
-MaterialTables Group::calcMinimalMaterialTables() const {
+std::shared_ptr<const MaterialTables> Group::calcMinimalMaterialTables() const {
     auto elements = getElements();
     std::array<bool, 133> relevantMaterials{};
     relevantMaterials.fill(false);
@@ -270,10 +270,9 @@ MaterialTables Group::calcMinimalMaterialTables() const {
                 relevantMaterials[materialcoating - 1] = true;
             }
         } else if (coating.is<detail::CoatingTypes::MultilayerCoating>()) {
-            auto mlCoating = coating.get<detail::CoatingTypes::MultilayerCoating>();
-            for (const auto& mat : mlCoating.material) {
-                if (mat >= 1 && mat <= 133) {
-                    relevantMaterials[mat - 1] = true;
+            for (const auto& layer : elemPtr->getCoatingLayers()) {
+                if (layer.material >= 1 && layer.material <= 133) {
+                    relevantMaterials[layer.material - 1] = true;
                 }
             }
         }
@@ -282,7 +281,7 @@ MaterialTables Group::calcMinimalMaterialTables() const {
             relevantMaterials[material - 1] = true;
         }
     }
-    return loadMaterialTables(relevantMaterials);
+    return loadMaterialTablesCached(relevantMaterials);
 }
 
 void Group::accumulateLightSourcesWorldPositions(const Group& group, const glm::dvec4& parentPos, const glm::dmat4& parentOri,
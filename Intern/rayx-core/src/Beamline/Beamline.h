@@ -126,9 +126,12 @@ class RAYX_API Group : public BeamlineNode {
      * Gathers the material IDs used by all child DesignElements and merges them
      * into a single MaterialTables object.
      *
+     * The tables are cached process-wide (see loadMaterialTablesCached), so repeated calls for the same set of
+     * materials return the same object, as long as it is still in use.
+     *
      * @return A MaterialTables object with data for all relevant materials.
      */
-    MaterialTables calcMinimalMaterialTables() const;
+    std::shared_ptr<const MaterialTables> calcMinimalMaterialTables() const;
 
     // TODO: this should not be part of the API
     /**
@@ -193,6 +193,7 @@ inline std::vector<double> formatAsVec(T) {
 }
 
 inline std::vector<double> formatAsVec(int arg) { return {static_cast<double>(arg)}; }
+inline std::vector<double> formatAsVec(int64_t arg) { return {static_cast<double>(arg)}; }
 inline std::vector<double> formatAsVec(RandCounter arg) { return {static_cast<double>(arg)}; }
 inline std::vector<double> formatAsVec(EventType arg) { return {static_cast<double>(arg)}; }
 inline std::vector<double> formatAsVec(double arg) { return {arg}; }
@@ -511,17 +511,34 @@ DesignPlane DesignElement::getDesignPlane() const { return m_elementParameters["
 void DesignElement::setSurfaceCoatingType(SurfaceCoatingType value) { m_elementParameters["surfaceCoatingType"] = value; }
 SurfaceCoatingType DesignElement::getSurfaceCoatingType() const { return m_elementParameters["surfaceCoatingType"].as_surfaceCoatingType(); }
 
-void DesignElement::setMultilayerCoating(const Coating::MultilayerCoating& coating) {
-    m_elementParameters["numLayers"] = coating.numLayers;
+void DesignElement::setMultilayerCoating(const std::vector<CoatingLayer>& layers) {
+    const auto numLayers             = static_cast<int>(layers.size());
+    m_elementParameters["numLayers"] = numLayers;
     m_elementParameters["coating"]   = Map();
-    for (int i = 0; i < coating.numLayers; ++i) {
+    for (int i = 0; i < numLayers; ++i) {
         m_elementParameters["coating"]["layer" + std::to_string(i + 1)]              = Map();
-        m_elementParameters["coating"]["layer" + std::to_string(i + 1)]["material"]  = coating.material[i];
-        m_elementParameters["coating"]["layer" + std::to_string(i + 1)]["thickness"] = coating.thickness[i];
-        m_elementParameters["coating"]["layer" + std::to_string(i + 1)]["roughness"] = coating.roughness[i];
+        m_elementParameters["coating"]["layer" + std::to_string(i + 1)]["material"]  = layers[i].material;
+        m_elementParameters["coating"]["layer" + std::to_string(i + 1)]["thickness"] = layers[i].thickness;
+        m_elementParameters["coating"]["layer" + std::to_string(i + 1)]["roughness"] = layers[i].roughness;
     }
 }
 
+std::vector<CoatingLayer> DesignElement::getCoatingLayers() const {
+    if (getSurfaceCoatingType() != SurfaceCoatingType::MultipleCoatings) return {};
+
+    const auto numLayers = m_elementParameters["numLayers"].as_int();
+    auto layers          = std::vector<CoatingLayer>(numLayers);
+    for (int i = 0; i < numLayers; ++i) {
+        std::string layerKey = "layer" + std::to_string(i + 1);
+        try {
+            layers[i].material  = m_elementParameters["coating"][layerKey]["material"].as_int();
+            layers[i].thickness = m_elementParameters["coating"][layerKey]["thickness"].as_double();
+            layers[i].roughness = m_elementParameters["coating"][layerKey]["roughness"].as_double();
+        } catch (const std::exception& e) { std::cerr << "Error deserializing layer " << layerKey << ": " << e.what() << std::endl; }
+    }
+    return layers;
+}
+
 Coating DesignElement::getCoating() const {  // 0 = substrate only, 1 = one coating, 2 = multiple coatings
     SurfaceCoatingType type = getSurfaceCoatingType();
     if (type == SurfaceCoatingType::SubstrateOnly) {
@@ -533,21 +550,16 @@ Coating DesignElement::getCoating() const {  // 0 = substrate only, 1 = one coat
         oneCoating.roughness = getRoughnessCoating();
         return Coating::OneCoating{oneCoating};
     } else if (type == SurfaceCoatingType::MultipleCoatings) {
-        Coating::MultilayerCoating mlCoating;
-        mlCoating.numLayers = m_elementParameters["numLayers"].as_int();
-        for (int i = 0; i < mlCoating.numLayers; ++i) {
-            std::string layerKey = "layer" + std::to_string(i + 1);
-            try {
-                mlCoating.material[i]  = m_elementParameters["coating"][layerKey]["material"].as_int();
-                mlCoating.thickness[i] = m_elementParameters["coating"][layerKey]["thickness"].as_double();
-                mlCoating.roughness[i] = m_elementParameters["coating"][layerKey]["roughness"].as_double();
-            } catch (const std::exception& e) { std::cerr << "Error deserializing layer " << layerKey << ": " << e.what() << std::endl; }
-        }
-        if (0 > mlCoating.material[0] || mlCoating.material[0] > 97) {
+        const auto layers = getCoatingLayers();
+        if (layers.empty() || 0 > layers[0].material || layers[0].material > 97) {
             std::cerr << "Warning: No coating layers found in DesignElement." << std::endl;
             return Coating::SubstrateOnly{};  // Default case if no layers are found
         }
-        return Coating::MultilayerCoating{mlCoating};
+        // the layer offset is assigned when the layers are uploaded into the coating layer table of the tracer
+        return Coating::MultilayerCoating{
+            .numLayers   = static_cast<int>(layers.size()),
+            .layerOffset = 0,
+        };
     } else {
         return Coating::SubstrateOnly{};  // Placeholder for multiple coatings, needs implementation
     }
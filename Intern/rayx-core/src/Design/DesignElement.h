@@ -246,7 +246,8 @@ class RAYX_API DesignElement : public BeamlineNode {
     void setSurfaceCoatingType(SurfaceCoatingType value);
     SurfaceCoatingType getSurfaceCoatingType() const;
 
-    void setMultilayerCoating(const Coating::MultilayerCoating& coating);
+    void setMultilayerCoating(const std::vector<CoatingLayer>& layers);
+    std::vector<CoatingLayer> getCoatingLayers() const;
 
     Coating getCoating() const;
 
@@ -13,6 +13,16 @@ enum class SurfaceCoatingType {
     MultipleCoatings  // Multiple coating layers
 };
 
+/// A single layer of a multilayer coating. Multilayer stacks are not stored inside the OpticalElement, but in a separate layer table, which is
+/// referenced by offset and count (see `Coating::MultilayerCoating`). This keeps the OpticalElement compact and of fixed size.
+struct RAYX_API CoatingLayer {
+    int material;
+    double thickness;
+    double roughness;
+
+    bool operator==(const CoatingLayer&) const = default;
+};
+
 namespace detail {
 struct CoatingTypes {
     struct RAYX_API SubstrateOnly{
@@ -23,13 +33,13 @@ struct CoatingTypes {
         int material;
         double thickness;
         double roughness;
+        int reflectivityTableOffset = -1;  // offset of the precomputed reflectivity table (see ReflectivityTable.h), or -1 if there is none
     };
 
     struct RAYX_API MultilayerCoating {
         int numLayers;
-        int material[1000];
-        double thickness[1000];
-        double roughness[1000];
+        int layerOffset;  // index of the first layer in the coating layer table. layers are ordered from top (vacuum side) to bottom
+        int reflectivityTableOffset = -1;  // offset of the precomputed reflectivity table (see ReflectivityTable.h), or -1 if there is none
     };
 };
 }  // namespace detail
@@ -42,6 +42,13 @@ glm::dmat4 calcTransformationMatrices(glm::dvec4 position, glm::dmat4 orientatio
     }
 }
 
+AffineTransform composeAffineTransforms(const AffineTransform& a, const AffineTransform& b) {
+    const auto linearA = glm::dmat3(a);
+    const auto linearB = glm::dmat3(b);
+    const auto linear  = linearA * linearB;
+    return AffineTransform(linear[0], linear[1], linear[2], linearA * b[3] + a[3]);
+}
+
 inline glm::dmat4x4 defaultInMatrix(const DesignElement& dele, DesignPlane plane) {
     return calcTransformationMatrices(dele.getPosition(), dele.getOrientation(), true, plane);
 }
@@ -52,6 +59,23 @@ inline glm::dmat4x4 defaultOutMatrix(const DesignElement& dele, DesignPlane plan
 
 inline int defaultMaterial(const DesignElement& dele) { return static_cast<int>(dele.getMaterial()); }
 
+PackedElements packCoatingLayers(const std::vector<OpticalElementAndTransform>& elementsAndTransforms) {
+    auto packed = PackedElements{};
+    packed.elements.reserve(elementsAndTransforms.size());
+
+    for (const auto& e : elementsAndTransforms) {
+        auto& element = packed.elements.emplace_back(e.element);
+        if (!element.m_coating.is<Coating::MultilayerCoating>()) continue;
+
+        auto& mlCoating       = element.m_coating.get<Coating::MultilayerCoating>();
+        mlCoating.numLayers   = static_cast<int>(e.coatingLayers.size());
+        mlCoating.layerOffset = static_cast<int>(packed.coatingLayers.size());
+        packed.coatingLayers.insert(packed.coatingLayers.end(), e.coatingLayers.begin(), e.coatingLayers.end());
+    }
+
+    return packed;
+}
+
 OpticalElementAndTransform makeElement(const DesignElement& dele, Behaviour behaviour, Surface surface, DesignPlane plane,
                                        std::optional<Cutout> cutout) {
     if (!cutout) { cutout = dele.getCutout(); }
@@ -75,8 +99,9 @@ OpticalElementAndTransform makeElement(const DesignElement& dele, Behaviour beha
     };
 
     return OpticalElementAndTransform{
-        .element   = element,
-        .transform = transform,
+        .element       = element,
+        .transform     = transform,
+        .coatingLayers = dele.getCoatingLayers(),
     };
 }
 
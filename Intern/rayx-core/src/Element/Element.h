@@ -4,6 +4,7 @@
 #include <map>
 #include <optional>
 #include <string>
+#include <vector>
 
 #include "Behaviour.h"
 #include "Coating.h"
@@ -68,11 +69,44 @@ struct ObjectTransform {
 
 RAYX_API glm::dmat4 calcTransformationMatrices(glm::dvec4 position, glm::dmat4 orientation, bool calcInMatrix, DesignPlane plane);
 
+/// Compact affine transformation (3x4): the first three columns hold the linear part, the last column holds the translation.
+/// Equivalent to a glm::dmat4 whose last row is (0, 0, 0, 1), but needs less memory and arithmetic on the device.
+using AffineTransform = glm::dmat4x3;
+
+/// ObjectTransform in compact affine form, as used by the tracer on the device.
+struct AffineObjectTransform {
+    AffineTransform m_inTrans;   ///< Converts a point from world coordinates to local object coordinates.
+    AffineTransform m_outTrans;  ///< Converts a point from local object coordinates to world coordinates.
+};
+
+inline AffineTransform toAffineTransform(const glm::dmat4& m) { return AffineTransform(m); }
+
+inline AffineObjectTransform toAffineObjectTransform(const ObjectTransform& t) {
+    return AffineObjectTransform{
+        .m_inTrans  = toAffineTransform(t.m_inTrans),
+        .m_outTrans = toAffineTransform(t.m_outTrans),
+    };
+}
+
+/// Composes two affine transformations. The result applies `b` first, then `a`.
+RAYX_API AffineTransform composeAffineTransforms(const AffineTransform& a, const AffineTransform& b);
+
 struct OpticalElementAndTransform {
     OpticalElement element;
     ObjectTransform transform;
+    std::vector<CoatingLayer> coatingLayers;  ///< Layers of a multilayer coating. Moved into the coating layer table when uploading the element.
+};
+
+/// elements ready to be uploaded to the device, together with the coating layer table referenced by their multilayer coatings
+struct PackedElements {
+    std::vector<OpticalElement> elements;
+    std::vector<CoatingLayer> coatingLayers;
 };
 
+/// moves the layers of multilayer coatings into a single coating layer table, in order of the elements. the multilayer coating of each element
+/// references its own layers via numLayers and layerOffset
+RAYX_API PackedElements packCoatingLayers(const std::vector<OpticalElementAndTransform>& elementsAndTransforms);
+
 // constructs an OpticalElement given all of its components. Some information that is not explicitly given, will be parsed from the ` dele`.
 OpticalElementAndTransform makeElement(const DesignElement& dele, Behaviour behaviour, Surface surface, DesignPlane plane = DesignPlane::XZ,
                                        std::optional<Cutout> cutout = {});
@@ -0,0 +1,99 @@
+#include "ElementBvh.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "Shader/CutoutFns.h"
+#include "Variant.h"
+
+namespace rayx {
+
+namespace {
+
+constexpr double INF = std::numeric_limits<double>::infinity();
+
+// absolute and relative padding of the bounds. covers rounding errors between the collision search in element coordinates and the bounds test
+// in world coordinates
+constexpr double BOUNDS_PADDING_ABS = 1e-6;
+constexpr double BOUNDS_PADDING_REL = 1e-9;
+
+struct Bounds {
+    glm::dvec3 min;
+    glm::dvec3 max;
+};
+
+constexpr Bounds unboundedBounds() { return {glm::dvec3(-INF), glm::dvec3(INF)}; }
+
+// conservative world-space bounds of an element.
+// a collision with a plane is always at y = 0 in element coordinates, so the bounds of a planar element are given by its cutout. the collision
+// functions of curved surfaces may converge to any sheet of the surface (or, for cubics, even behind the ray), so these elements are unbounded
+Bounds calcElementBounds(const OpticalElementAndTransform& e) {
+    if (!e.element.m_surface.is<Surface::Plane>()) return unboundedBounds();
+
+    // half extents of the element in element coordinates
+    auto halfExtents = glm::dvec3(INF, 0.0, INF);
+    if (!e.element.m_cutout.is<Cutout::Unlimited>()) {
+        const auto boundingBox = cutoutBoundingBox(e.element.m_cutout);
+        halfExtents            = glm::dvec3(boundingBox[0] / 2.0, 0.0, boundingBox[1] / 2.0);
+    }
+
+    const auto& outTrans = e.transform.m_outTrans;
+    const auto center    = glm::dvec3(outTrans * glm::dvec4(0.0, 0.0, 0.0, 1.0));
+
+    Bounds bounds;
+    for (int i = 0; i < 3; ++i) {
+        // extent along world axis i. skip exact zeros, to avoid inf * 0 for unlimited cutouts that are aligned with a world axis
+        auto extent = 0.0;
+        for (int j = 0; j < 3; ++j) {
+            const auto m = glm::abs(outTrans[j][i]);
+            if (m != 0.0 && halfExtents[j] != 0.0) extent += m * halfExtents[j];
+        }
+        extent += BOUNDS_PADDING_ABS + BOUNDS_PADDING_REL * std::max(glm::abs(center[i]), extent);
+
+        bounds.min[i] = center[i] - extent;
+        bounds.max[i] = center[i] + extent;
+    }
+    return bounds;
+}
+
+void buildElementBvhNode(std::vector<ElementBvhNode>& nodes, const std::vector<Bounds>& elementBounds, const int elementBegin,
+                         const int elementEnd) {
+    auto bounds = Bounds{glm::dvec3(INF), glm::dvec3(-INF)};
+    for (int i = elementBegin; i < elementEnd; ++i) {
+        bounds.min = glm::min(bounds.min, elementBounds[i].min);
+        bounds.max = glm::max(bounds.max, elementBounds[i].max);
+    }
+
+    const auto nodeIndex = static_cast<int>(nodes.size());
+    const auto isLeaf    = elementEnd - elementBegin <= ELEMENT_BVH_MAX_LEAF_SIZE;
+    nodes.push_back(ElementBvhNode{
+        .boundsMin    = bounds.min,
+        .boundsMax    = bounds.max,
+        .elementBegin = elementBegin,
+        .elementEnd   = elementEnd,
+        .skipIndex    = 0,
+        .isLeaf       = isLeaf,
+    });
+
+    // split the range of element indices in halves. elements of a beamline are mostly ordered along the beam, so neighbouring indices are close
+    if (!isLeaf) {
+        const auto elementMid = elementBegin + (elementEnd - elementBegin) / 2;
+        buildElementBvhNode(nodes, elementBounds, elementBegin, elementMid);
+        buildElementBvhNode(nodes, elementBounds, elementMid, elementEnd);
+    }
+
+    nodes[nodeIndex].skipIndex = static_cast<int>(nodes.size());
+}
+
+}  // unnamed namespace
+
+std::vector<ElementBvhNode> buildElementBvh(const std::vector<OpticalElementAndTransform>& elements) {
+    auto elementBounds = std::vector<Bounds>(elements.size());
+    std::transform(elements.begin(), elements.end(), elementBounds.begin(), calcElementBounds);
+
+    auto nodes = std::vector<ElementBvhNode>();
+    if (!elements.empty()) buildElementBvhNode(nodes, elementBounds, 0, static_cast<int>(elements.size()));
+    return nodes;
+}
+
+}  // namespace rayx
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glm.hpp>
+#include <vector>
+
+#include "Core.h"
+#include "Element.h"
+
+namespace rayx {
+
+/**
+ * @brief Node of the bounding volume hierarchy over the elements of a beamline.
+ * The hierarchy is used to cull elements in the non-sequential collision search.
+ * Each node partitions a contiguous range of element indices, so that a left-first traversal visits the elements in ascending index order. This is
+ * required to consume random numbers (slope error) in the same order as the brute-force search, which keeps the results bitwise identical.
+ * Nodes are stored in depth-first order. The first child of an inner node is the next node, `skipIndex` is the node after the subtree of this node.
+ * This allows for a stackless traversal.
+ */
+struct ElementBvhNode {
+    glm::dvec3 boundsMin;  ///< World-space bounds of all elements in this node. Unbounded elements have infinite bounds.
+    glm::dvec3 boundsMax;
+    int elementBegin;  ///< First element index of this node.
+    int elementEnd;    ///< One past the last element index of this node.
+    int skipIndex;     ///< Index of the next node after the subtree of this node.
+    bool isLeaf;
+};
+static_assert(std::is_trivially_copyable_v<ElementBvhNode>);
+
+/// maximum number of elements in a leaf of the element bounding volume hierarchy
+constexpr int ELEMENT_BVH_MAX_LEAF_SIZE = 2;
+
+/**
+ * @brief Builds the bounding volume hierarchy over the given elements.
+ * Bounds are conservative: only planar elements are bounded by their cutout, all other surfaces are treated as unbounded and are always tested.
+ * @return The nodes in depth-first order, empty if there are no elements.
+ */
+RAYX_API std::vector<ElementBvhNode> buildElementBvh(const std::vector<OpticalElementAndTransform>& elements);
+
+}  // namespace rayx
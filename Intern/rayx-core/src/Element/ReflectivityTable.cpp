@@ -0,0 +1,186 @@
+#include "ReflectivityTable.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <numeric>
+#include <thread>
+
+#include "Debug/Debug.h"
+#include "Shader/Efficiency.h"
+
+namespace rayx {
+
+namespace {
+
+// offset of the reflectivity table in the coating, or nullptr if the coating can not be tabulated
+int* getReflectivityTableOffset(Coating& coating) {
+    if (coating.is<Coating::OneCoating>()) return &coating.get<Coating::OneCoating>().reflectivityTableOffset;
+    if (coating.is<Coating::MultilayerCoating>()) return &coating.get<Coating::MultilayerCoating>().reflectivityTableOffset;
+    return nullptr;
+}
+
+// only coated mirrors get a table
+bool hasReflectivityTable(const OpticalElement& element) {
+    return (element.m_coating.is<Coating::OneCoating>() || element.m_coating.is<Coating::MultilayerCoating>()) &&
+           element.m_behaviour.is<Behaviour::Mirror>();
+}
+
+int calcGridSize(const int size) { return std::max(size, 2); }
+
+size_t calcTableSize(const ReflectivityTableConfig& config) {
+    return REFLECTIVITY_TABLE_HEADER_SIZE +
+           REFLECTIVITY_TABLE_ENTRY_SIZE * static_cast<size_t>(calcGridSize(config.numEnergies)) * calcGridSize(config.numAngles);
+}
+
+}  // unnamed namespace
+
+ReflectivityTablesKey calcReflectivityTablesKey(const std::vector<OpticalElement>& elements, const std::vector<CoatingLayer>& coatingLayers,
+                                                std::shared_ptr<const MaterialTables> materialTables, glm::dvec2 energyRange,
+                                                const ReflectivityTableConfig& config) {
+    auto keyElements = std::vector<std::optional<ReflectivityTablesKey::Element>>(elements.size());
+    for (size_t i = 0; i < elements.size(); ++i) {
+        const auto& element = elements[i];
+        if (!hasReflectivityTable(element)) continue;
+
+        auto layers = std::vector<CoatingLayer>();
+        if (element.m_coating.is<Coating::OneCoating>()) {
+            const auto& coating = element.m_coating.get<Coating::OneCoating>();
+            layers.push_back({.material = coating.material, .thickness = coating.thickness, .roughness = coating.roughness});
+        } else {
+            const auto& coating = element.m_coating.get<Coating::MultilayerCoating>();
+            layers.assign(coatingLayers.begin() + coating.layerOffset, coatingLayers.begin() + coating.layerOffset + coating.numLayers);
+        }
+        keyElements[i] = ReflectivityTablesKey::Element{
+            .material = element.m_material,
+            .layers   = std::move(layers),
+        };
+    }
+
+    return {
+        .elements       = std::move(keyElements),
+        .materialTables = std::move(materialTables),
+        .energyRange    = energyRange,
+        .config         = config,
+    };
+}
+
+size_t assignReflectivityTableOffsets(std::vector<OpticalElement>& elements, const ReflectivityTableConfig& config) {
+    const auto tableSize = calcTableSize(config);
+
+    auto size = size_t{0};
+    for (auto& element : elements) {
+        if (!hasReflectivityTable(element)) continue;
+
+        *getReflectivityTableOffset(element.m_coating) = static_cast<int>(size);
+        size += tableSize;
+    }
+    return size;
+}
+
+std::vector<double> buildReflectivityTables(std::vector<OpticalElement>& elements, const std::vector<CoatingLayer>& coatingLayers,
+                                            const MaterialTables& materialTables, glm::dvec2 energyRange, const ReflectivityTableConfig& config) {
+    const auto numEnergies = calcGridSize(config.numEnergies);
+    const auto numAngles   = calcGridSize(config.numAngles);
+
+    // a single energy (e.g. a monochromatic source) still needs a grid interval around it
+    auto energyMin = energyRange.x;
+    auto energyMax = energyRange.y;
+    if (energyMax <= energyMin) {
+        const auto margin = std::max(std::abs(energyMin) * 1e-6, 1e-9);
+        energyMin -= margin;
+        energyMax += margin;
+    }
+    const auto angleMin = config.angleMin;
+    const auto angleMax = std::max(config.angleMax, config.angleMin + 1e-9);
+
+    const auto energyStep = (energyMax - energyMin) / (numEnergies - 1);
+    const auto angleStep  = (angleMax - angleMin) / (numAngles - 1);
+
+    const auto* materialIndices = materialTables.indices.data();
+    const auto* materialTable   = materialTables.materials.data();
+    const auto* layers          = coatingLayers.data();
+
+    // the energy rows of a table are independent of each other, so they are distributed over all hardware threads
+    const auto numThreads = static_cast<int>(std::clamp(std::thread::hardware_concurrency(), 1u, static_cast<unsigned>(numEnergies)));
+    const auto forEachRow = [numThreads](const int numRows, const auto& fn) {
+        const auto fnRows = [&](const int threadIndex) {
+            for (int i = threadIndex; i < numRows; i += numThreads) fn(i);
+        };
+        auto futures = std::vector<std::future<void>>();
+        for (int t = 1; t < numThreads; ++t) futures.push_back(std::async(std::launch::async, fnRows, t));
+        fnRows(0);
+        for (auto& future : futures) future.get();
+    };
+
+    auto tables = std::vector<double>(assignReflectivityTableOffsets(elements, config));
+    for (size_t elementIndex = 0; elementIndex < elements.size(); ++elementIndex) {
+        const auto& element = elements[elementIndex];
+        if (!hasReflectivityTable(element)) continue;
+
+        auto* table = tables.data() + *getReflectivityTableOffset(elements[elementIndex].m_coating);
+        table[0]    = energyMin;
+        table[1]    = 1.0 / energyStep;
+        table[2]    = static_cast<double>(numEnergies);
+        table[3]    = angleMin;
+        table[4]    = 1.0 / angleStep;
+        table[5]    = static_cast<double>(numAngles);
+
+        // i and j are positions on the grid in units of grid steps, and may lie in between grid points
+        const auto exact = [&](const double i, const double j) {
+            return computeCoatingReflectance(energyMin + i * energyStep, angleMin + j * angleStep, element.m_coating, element.m_material, layers,
+                                             materialIndices, materialTable);
+        };
+        const auto entry = [table, numAngles](const int i, const int j) {
+            return table + REFLECTIVITY_TABLE_HEADER_SIZE + REFLECTIVITY_TABLE_ENTRY_SIZE * (static_cast<size_t>(i) * numAngles + j);
+        };
+
+        forEachRow(numEnergies, [&](const int i) {
+            for (int j = 0; j < numAngles; ++j) {
+                const auto amplitude = exact(i, j);
+                auto* e              = entry(i, j);
+                e[0]                 = amplitude.s.real();
+                e[1]                 = amplitude.s.imag();
+                e[2]                 = amplitude.p.real();
+                e[3]                 = amplitude.p.imag();
+                e[4]                 = 0.0;
+            }
+        });
+
+        // deviation of the interpolation in grid cell (i, j) at (i + ti, j + tj) from the exact reflection amplitudes
+        const auto interpolationError = [&](const int i, const int j, const double ti, const double tj) {
+            const auto value        = exact(i + ti, j + tj);
+            const double expected[] = {value.s.real(), value.s.imag(), value.p.real(), value.p.imag()};
+
+            auto maxError = 0.0;
+            for (int k = 0; k < 4; ++k) {
+                const auto low          = entry(i, j)[k] + tj * (entry(i, j + 1)[k] - entry(i, j)[k]);
+                const auto high         = entry(i + 1, j)[k] + tj * (entry(i + 1, j + 1)[k] - entry(i + 1, j)[k]);
+                const auto interpolated = low + ti * (high - low);
+                maxError                = std::max(maxError, std::abs(interpolated - expected[k]));
+            }
+            return maxError;
+        };
+
+        // a cell is valid, if interpolation is within tolerance at the midpoints of its edges and at its center. nan errors are not within tolerance
+        auto numValidCells = std::vector<int>(numEnergies - 1);
+        forEachRow(numEnergies - 1, [&](const int i) {
+            for (int j = 0; j < numAngles - 1; ++j) {
+                auto valid = true;
+                for (const auto [ti, tj] : {std::pair(0.5, 0.5), std::pair(0.0, 0.5), std::pair(1.0, 0.5), std::pair(0.5, 0.0), std::pair(0.5, 1.0)})
+                    valid = valid && interpolationError(i, j, ti, tj) <= config.tolerance;
+                entry(i, j)[4] = valid ? 1.0 : 0.0;
+                numValidCells[i] += valid ? 1 : 0;
+            }
+        });
+
+        RAYX_VERB << "reflectivity table of element " << elementIndex << ": "
+                  << std::accumulate(numValidCells.begin(), numValidCells.end(), int64_t{0}) << " of "
+                  << static_cast<int64_t>(numEnergies - 1) * (numAngles - 1) << " grid cells within tolerance";
+    }
+
+    RAYX_VERB << "built reflectivity tables: " << tables.size() * sizeof(double) << " bytes";
+    return tables;
+}
+
+}  // namespace rayx
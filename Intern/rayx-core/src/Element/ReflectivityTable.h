@@ -0,0 +1,79 @@
+#pragma once
+
+#include <glm.hpp>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "Core.h"
+#include "Element.h"
+#include "Material/Material.h"
+#include "Shader/Constants.h"
+
+namespace rayx {
+
+/**
+ * @brief Configuration of the precomputed reflectivity tables of coated mirrors.
+ * For each mirror with a single layer or multilayer coating, the complex s and p reflection amplitudes are tabulated on a regular grid over
+ * the energies of the sources and the incidence angles. The tracer then interpolates bilinearly in this table, instead of evaluating the
+ * coating (a transfer matrix over all layers for multilayer coatings) for every ray.
+ * Grid cells where interpolation deviates from the exact reflection amplitudes by more than `tolerance` (e.g. around the total reflection edge,
+ * Bragg peaks and thickness fringes of multilayers) are marked invalid. For energies and angles in these cells, and outside of the grid, the
+ * reflection amplitudes are computed exactly. A finer grid leaves fewer cells to compute exactly.
+ */
+struct RAYX_API ReflectivityTableConfig {
+    int numEnergies  = 256;
+    int numAngles    = 1024;
+    double angleMin  = 0.0;     ///< minimum incidence angle in rad, measured to the normal
+    double angleMax  = PI / 2;  ///< maximum incidence angle in rad, measured to the normal
+    double tolerance = 1e-4;    ///< maximum absolute error of the real and imaginary parts of the s and p amplitudes
+
+    bool operator==(const ReflectivityTableConfig&) const = default;
+};
+
+/**
+ * @brief Everything the reflectivity tables built by buildReflectivityTables depend on. Equal keys yield equal tables, so tables can be reused
+ * as long as the key does not change.
+ */
+struct RAYX_API ReflectivityTablesKey {
+    /// material and coating layers (from top to bottom, a single layer for a single layer coating) of an element with a table
+    struct Element {
+        int material;
+        std::vector<CoatingLayer> layers;
+
+        bool operator==(const Element&) const = default;
+    };
+
+    std::vector<std::optional<Element>> elements;  ///< per element, empty if the element has no table
+    std::shared_ptr<const MaterialTables> materialTables;
+    glm::dvec2 energyRange;
+    ReflectivityTableConfig config;
+
+    bool operator==(const ReflectivityTablesKey&) const = default;
+};
+
+/// calculates the key of the reflectivity tables, that buildReflectivityTables would build from the same arguments
+RAYX_API ReflectivityTablesKey calcReflectivityTablesKey(const std::vector<OpticalElement>& elements, const std::vector<CoatingLayer>& coatingLayers,
+                                                        std::shared_ptr<const MaterialTables> materialTables, glm::dvec2 energyRange,
+                                                        const ReflectivityTableConfig& config);
+
+/**
+ * @brief References the reflectivity tables in the coatings of the elements, as buildReflectivityTables does, without building the tables.
+ * Used to reference tables that were built before from the same key.
+ * @return The size of the tables of all elements
+ */
+RAYX_API size_t assignReflectivityTableOffsets(std::vector<OpticalElement>& elements, const ReflectivityTableConfig& config);
+
+/**
+ * @brief Builds the reflectivity tables of all coated mirrors and references them in the coatings of the elements.
+ * The error bound of each grid cell is verified at the midpoints of its edges and at its center.
+ * @param elements elements to build tables for. multilayer coatings must already reference their layers in `coatingLayers`
+ * @param materialTables material tables used to evaluate the refractive indices
+ * @param energyRange minimum and maximum energy covered by the grid
+ * @return The tables of all elements, in the layout expected by lookupReflectivityTable. Empty if no element has a coated mirror.
+ */
+RAYX_API std::vector<double> buildReflectivityTables(std::vector<OpticalElement>& elements, const std::vector<CoatingLayer>& coatingLayers,
+                                                     const MaterialTables& materialTables, glm::dvec2 energyRange,
+                                                     const ReflectivityTableConfig& config);
+
+}  // namespace rayx
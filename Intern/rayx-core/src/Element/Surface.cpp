@@ -223,6 +223,7 @@ Surface makeToroid(const DesignElement& dele) {
         .m_longRadius  = dele.getLongRadius(),
         .m_shortRadius = dele.getShortRadius(),
         .m_toroidType  = ToroidType::Concave,
+        .m_solver      = ToroidSolver::Newton,
     };
 }
 
@@ -10,6 +10,13 @@ enum class ToroidType {
     Concave,
 };
 
+// method to find the intersection of a ray with a toroid. all of them refine the intersection with newton's method
+enum class ToroidSolver {
+    Newton,        // newton's method starting at z = 0, like RAY-UI. reproduces the results of RAY-UI
+    SeededNewton,  // newton's method starting at the intersection with the osculating quadric, converges in few steps
+    Quartic,       // newton's method starting at the closed form solution of the quartic torus equation
+};
+
 // a surface is a potentially infinite curved surface in 3d space.
 // as our elements are mostly finite in size, they are represented by a (potentially infinite) surface in combination with a finite cutout (see CTYPE
 // constants)
@@ -38,6 +45,7 @@ struct SurfaceTypes {
         double m_longRadius;
         double m_shortRadius;
         ToroidType m_toroidType;
+        ToroidSolver m_solver;
     };
 
     struct Cubic {
@@ -1,5 +1,8 @@
 #include "Material.h"
 
+#include <map>
+#include <mutex>
+
 #ifdef _WIN32
 #include <string.h>
 #else
@@ -10,6 +13,7 @@
 #include "NffTable.h"
 #include "PalikTable.h"
 #include "CromerTable.h"
+#include "MaterialDatabase.h"
 #include "MolecTable.h"
 
 namespace rayx {
@@ -73,6 +77,11 @@ bool materialFromString(const char* matname, Material* out) {
 }
 
 MaterialTables loadMaterialTables(std::array<bool, 133> relevantMaterials) {
+    if (const auto database = getMaterialDatabase()) return database->slice(relevantMaterials);
+    return loadMaterialTablesFromText(relevantMaterials);
+}
+
+MaterialTables loadMaterialTablesFromText(std::array<bool, 133> relevantMaterials) {
     MaterialTables out;
 
     auto mats = allNormalMaterials();
@@ -181,6 +190,9 @@ MaterialTables loadMaterialTables(std::array<bool, 133> relevantMaterials) {
     // within indices[i]..indices[i+1] can be used without checks.
     out.indices.push_back(out.materials.size());
 
+    // no material has an energy gridded lookup table yet, see RefractiveIndexLut.h
+    out.indices.resize(REFRACTIVE_INDEX_LUT_INDICES_OFFSET + mats.size(), -1);
+
     // materials can't be empty, because
     // Vulkan does not support empty buffers.
     if (out.materials.empty()) {
@@ -191,6 +203,24 @@ MaterialTables loadMaterialTables(std::array<bool, 133> relevantMaterials) {
     return out;
 }
 
+std::shared_ptr<const MaterialTables> loadMaterialTablesCached(std::array<bool, 133> relevantMaterials) {
+    static std::mutex mutex;
+    // the cache does not own the tables, so that tables are freed once no caller uses them anymore
+    static std::map<std::array<bool, 133>, std::weak_ptr<const MaterialTables>> cache;
+
+    // loading happens under the lock, so that concurrent calls with the same set of materials parse the table files only once
+    const auto lock = std::scoped_lock(mutex);
+
+    std::erase_if(cache, [](const auto& entry) { return entry.second.expired(); });
+
+    auto& cached = cache[relevantMaterials];
+    if (auto tables = cached.lock()) return tables;
+
+    auto tables = std::make_shared<const MaterialTables>(loadMaterialTables(relevantMaterials));
+    cached      = tables;
+    return tables;
+}
+
 // returns dvec2(atomic mass, density) extracted from materials.xmacro
 glm::dvec2 getAtomicMassAndRho(int material) {
     // This is an "X-Macro", see https://en.wikipedia.org/wiki/X_macro
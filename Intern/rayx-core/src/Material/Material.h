@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <memory>
 #include <vector>
 #include <glm.hpp>
 
@@ -44,8 +45,17 @@ struct RAYX_API MaterialTables {
 
 // the following function loads the Palik, Nff, and Cromer tables.
 // the tables will later be written to the mat and matIdx buffers of shader.comp
+// the tables are sliced from the precompiled material database (see MaterialDatabase.h) if it is available, otherwise the text files are parsed
 MaterialTables RAYX_API loadMaterialTables(std::array<bool, 133> relevantMaterials);
 
+// same as loadMaterialTables, but always parses the text files in Data/. used to generate the material database
+MaterialTables RAYX_API loadMaterialTablesFromText(std::array<bool, 133> relevantMaterials);
+
+// same as loadMaterialTables, but the result is cached process-wide and keyed by the set of relevant materials.
+// repeated calls with the same set return the same tables without parsing the table files again, as long as the tables are still in use.
+// the cache holds no ownership, so tables are freed once the last returned pointer is released. this function is thread-safe
+std::shared_ptr<const MaterialTables> RAYX_API loadMaterialTablesCached(std::array<bool, 133> relevantMaterials);
+
 // returns dvec2(atomic mass, density) extracted from materials.xmacro
 glm::dvec2 getAtomicMassAndRho(int material);
 
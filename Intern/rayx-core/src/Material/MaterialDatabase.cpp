@@ -0,0 +1,199 @@
+#include "MaterialDatabase.h"
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Debug/Debug.h"
+#include "Rml/Locate.h"
+#include "Shader/RefractiveIndex.h"
+
+namespace rayx {
+
+namespace {
+
+constexpr char MAGIC[8] = {'R', 'A', 'Y', 'X', 'M', 'A', 'T', 'D'};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t numTables;
+    uint32_t numMaterials;
+    uint32_t reserved;
+};
+static_assert(sizeof(Header) == 24);
+
+constexpr size_t NUM_INDICES = MaterialDatabase::NUM_TABLES * MaterialDatabase::NUM_MATERIALS + 1;
+
+// the data section starts right after the indices and is aligned to doubles, because the mapping itself is page aligned
+constexpr size_t DATA_BEGIN = sizeof(Header) + NUM_INDICES * sizeof(uint64_t);
+static_assert(DATA_BEGIN % alignof(double) == 0);
+
+}  // unnamed namespace
+
+// read-only memory mapping of a whole file
+struct MaterialDatabase::MappedFile {
+    const std::byte* data = nullptr;
+    size_t size           = 0;
+#if defined(_WIN32)
+    HANDLE file    = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+    static std::unique_ptr<MappedFile> map(const std::filesystem::path& path) {
+        auto out = std::make_unique<MappedFile>();
+#if defined(_WIN32)
+        out->file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (out->file == INVALID_HANDLE_VALUE) return nullptr;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(out->file, &fileSize) || fileSize.QuadPart == 0) return nullptr;
+        out->mapping = CreateFileMappingW(out->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!out->mapping) return nullptr;
+        const auto view = MapViewOfFile(out->mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view) return nullptr;
+        out->data = static_cast<const std::byte*>(view);
+        out->size = static_cast<size_t>(fileSize.QuadPart);
+#else
+        const auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1) return nullptr;
+        struct stat st;
+        if (fstat(fd, &st) == -1 || st.st_size == 0) {
+            ::close(fd);
+            return nullptr;
+        }
+        // the mapping stays valid after closing the file descriptor
+        const auto view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (view == MAP_FAILED) return nullptr;
+        out->data = static_cast<const std::byte*>(view);
+        out->size = static_cast<size_t>(st.st_size);
+#endif
+        return out;
+    }
+
+    ~MappedFile() {
+#if defined(_WIN32)
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (data) munmap(const_cast<std::byte*>(data), size);
+#endif
+    }
+};
+
+MaterialDatabase::MaterialDatabase(std::unique_ptr<MappedFile> file)
+    : m_file(std::move(file)),
+      m_indices(reinterpret_cast<const uint64_t*>(m_file->data + sizeof(Header))),
+      m_data(reinterpret_cast<const double*>(m_file->data + DATA_BEGIN)) {}
+
+MaterialDatabase::~MaterialDatabase() = default;
+
+std::unique_ptr<MaterialDatabase> MaterialDatabase::open(const std::filesystem::path& path) {
+    auto file = MappedFile::map(path);
+    if (!file) {
+        RAYX_VERB << "could not map material database " << path;
+        return nullptr;
+    }
+
+    if (file->size < DATA_BEGIN) {
+        RAYX_WARN << "material database " << path << " is truncated";
+        return nullptr;
+    }
+
+    Header header;
+    std::memcpy(&header, file->data, sizeof(Header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.numTables != NUM_TABLES ||
+        header.numMaterials != NUM_MATERIALS) {
+        RAYX_WARN << "material database " << path << " has an unknown format or version. regenerate it with rayx-material-db";
+        return nullptr;
+    }
+
+    // indices must be ascending and must not exceed the file
+    const auto indices = reinterpret_cast<const uint64_t*>(file->data + sizeof(Header));
+    for (size_t i = 1; i < NUM_INDICES; ++i) {
+        if (indices[i] < indices[i - 1]) {
+            RAYX_WARN << "material database " << path << " is corrupt";
+            return nullptr;
+        }
+    }
+    if (indices[0] != 0 || indices[NUM_INDICES - 1] > (file->size - DATA_BEGIN) / sizeof(double)) {
+        RAYX_WARN << "material database " << path << " is corrupt";
+        return nullptr;
+    }
+
+    RAYX_VERB << "mapped material database " << path << ": " << file->size << " bytes";
+    return std::unique_ptr<MaterialDatabase>(new MaterialDatabase(std::move(file)));
+}
+
+bool MaterialDatabase::write(const std::filesystem::path& path) {
+    // the tables of all materials. the tables of a material do not depend on which other materials are loaded
+    std::array<bool, 133> allMaterials;
+    allMaterials.fill(true);
+    const auto tables = loadMaterialTablesFromText(allMaterials);
+    if (tables.indices.size() < NUM_INDICES) {
+        RAYX_WARN << "unexpected number of material table indices. this is a bug.";
+        return false;
+    }
+
+    // the indices of the lookup tables are not stored, there are no lookup tables in the database
+    auto indices = std::vector<uint64_t>(tables.indices.begin(), tables.indices.begin() + NUM_INDICES);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        RAYX_WARN << "could not open " << path << " for writing";
+        return false;
+    }
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version      = VERSION;
+    header.numTables    = NUM_TABLES;
+    header.numMaterials = NUM_MATERIALS;
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(uint64_t));
+    file.write(reinterpret_cast<const char*>(tables.materials.data()), indices.back() * sizeof(double));
+    return static_cast<bool>(file);
+}
+
+MaterialTables MaterialDatabase::slice(const std::array<bool, 133>& relevantMaterials) const {
+    MaterialTables out;
+
+    // same layout as loadMaterialTablesFromText: one index per table per material, tables of irrelevant materials are empty
+    out.indices.reserve(REFRACTIVE_INDEX_LUT_INDICES_OFFSET + NUM_MATERIALS);
+    for (size_t i = 0; i < NUM_INDICES - 1; ++i) {
+        out.indices.push_back(static_cast<int>(out.materials.size()));
+        if (relevantMaterials[i % NUM_MATERIALS]) out.materials.insert(out.materials.end(), m_data + m_indices[i], m_data + m_indices[i + 1]);
+    }
+    out.indices.push_back(static_cast<int>(out.materials.size()));
+    out.indices.resize(REFRACTIVE_INDEX_LUT_INDICES_OFFSET + NUM_MATERIALS, -1);
+
+    // materials can't be empty, see loadMaterialTablesFromText
+    if (out.materials.empty()) out.materials.push_back(0);
+
+    return out;
+}
+
+const MaterialDatabase* getMaterialDatabase() {
+    static const auto database = []() -> std::unique_ptr<MaterialDatabase> {
+        const auto path = ResourceHandler::getInstance().getResourcePath(std::filesystem::path("Data") / MaterialDatabase::FILENAME);
+        if (path.empty()) {
+            RAYX_VERB << "material database not found, falling back to parsing material tables";
+            return nullptr;
+        }
+        return MaterialDatabase::open(path);
+    }();
+    return database.get();
+}
+
+}  // namespace rayx
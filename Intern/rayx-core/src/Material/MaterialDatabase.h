@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+#include "Core.h"
+#include "Material.h"
+
+namespace rayx {
+
+/**
+ * @brief Precompiled binary material database.
+ * Holds the tables (Palik, Nff, Cromer, Molec) of all materials as precomputed (energy, n, k) triples, in exactly the layout that
+ * loadMaterialTables produces and getRefractiveIndex expects. The file is generated at build time by the `rayx-material-db` tool and
+ * memory-mapped at runtime, so that loading the tables of a set of materials is a slice operation without parsing any text files.
+ *
+ * File layout (native byte order, the file is generated on the target platform):
+ *   header:  char[8] magic "RAYXMATD", uint32 version, uint32 number of tables, uint32 number of materials, uint32 reserved
+ *   indices: uint64[numTables * numMaterials + 1], offset of the table of each material into data, in doubles.
+ *            ordered by table first, then by material, like MaterialTables::indices
+ *   data:    double[], the (energy, n, k) triples
+ */
+class RAYX_API MaterialDatabase {
+  public:
+    static constexpr uint32_t VERSION       = 1;
+    static constexpr uint32_t NUM_TABLES    = 4;
+    static constexpr uint32_t NUM_MATERIALS = 133;
+    static constexpr const char* FILENAME   = "materials.rayxmat";
+
+    MaterialDatabase(const MaterialDatabase&)            = delete;
+    MaterialDatabase& operator=(const MaterialDatabase&) = delete;
+    ~MaterialDatabase();
+
+    /// memory-maps the database file at `path`. returns nullptr if the file does not exist, or if it is invalid or of another version
+    static std::unique_ptr<MaterialDatabase> open(const std::filesystem::path& path);
+
+    /// generates the database file at `path` from the text tables in Data/. returns false on failure
+    static bool write(const std::filesystem::path& path);
+
+    /// returns the material tables of the relevant materials. equivalent to loadMaterialTablesFromText, but without parsing
+    MaterialTables slice(const std::array<bool, 133>& relevantMaterials) const;
+
+  private:
+    struct MappedFile;
+
+    explicit MaterialDatabase(std::unique_ptr<MappedFile> file);
+
+    std::unique_ptr<MappedFile> m_file;
+    const uint64_t* m_indices;
+    const double* m_data;
+};
+
+/// returns the process-wide material database, located in Data/ and opened on first use. returns nullptr if it is not available
+RAYX_API const MaterialDatabase* getMaterialDatabase();
+
+}  // namespace rayx
@@ -0,0 +1,157 @@
+#include "RefractiveIndexLut.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "Beamline/Beamline.h"
+#include "Debug/Debug.h"
+#include "Design/DesignSource.h"
+#include "Shader/RefractiveIndex.h"
+
+namespace rayx {
+
+namespace {
+
+// number of standard deviations of a soft edge energy distribution that are covered by the grid
+constexpr double SOFT_EDGE_NUM_SIGMAS = 5.0;
+
+// energies of the entries of all tables of a material, in ascending order. the exact refractive index is piecewise linear between these
+std::vector<double> collectTableEnergies(const int material, const int* indices, const double* table) {
+    auto energies = std::vector<double>();
+    for (int i = 0; i < getPalikEntryCount(material, indices); ++i) energies.push_back(getPalikEntry(i, material, indices, table).m_energy);
+    for (int i = 0; i < getNffEntryCount(material, indices); ++i) energies.push_back(getNffEntry(i, material, indices, table).m_energy);
+    for (int i = 0; i < getCromerEntryCount(material, indices); ++i) energies.push_back(getCromerEntry(i, material, indices, table).m_energy);
+    for (int i = 0; i < getMolecEntryCount(material, indices); ++i) energies.push_back(getMolecEntry(i, material, indices, table).m_energy);
+    std::sort(energies.begin(), energies.end());
+    return energies;
+}
+
+// whether getRefractiveIndex finds a table for this energy. mirrors the order in which getRefractiveIndex consults the tables
+bool hasExactRefractiveIndex(const double energy, const int material, const int* indices, const double* table) {
+    if (material > 92) return getMolecEntryCount(material, indices) > 0;
+    if (getNffEntryCount(material, indices) > 0 || getCromerEntryCount(material, indices) > 0) return true;
+
+    const auto numPalikEntries = getPalikEntryCount(material, indices);
+    return numPalikEntries > 0 && getPalikEntry(0, material, indices, table).m_energy <= energy &&
+           energy <= getPalikEntry(numPalikEntries - 1, material, indices, table).m_energy;
+}
+
+}  // unnamed namespace
+
+void appendRefractiveIndexLuts(MaterialTables& materialTables, glm::dvec2 energyRange, const RefractiveIndexLutConfig& config) {
+    const auto logarithmic   = config.spacing == EnergyGridSpacing::Logarithmic;
+    const auto numGridPoints = std::max(config.numGridPoints, 2);
+
+    // a single energy (e.g. a monochromatic source) still needs a grid interval around it
+    auto energyMin = energyRange.x;
+    auto energyMax = energyRange.y;
+    if (energyMax <= energyMin) {
+        const auto margin = std::max(std::abs(energyMin) * 1e-6, 1e-9);
+        energyMin -= margin;
+        energyMax += margin;
+    }
+    if (logarithmic && energyMin <= 0.0) {
+        RAYX_WARN << "refractive index lookup tables with logarithmic spacing require positive energies. lookup tables are disabled";
+        return;
+    }
+
+    const auto toGrid     = [&](const double energy) { return logarithmic ? std::log(energy) : energy; };
+    const auto fromGrid   = [&](const double x) { return logarithmic ? std::exp(x) : x; };
+    const auto gridStart  = toGrid(energyMin);
+    const auto gridStep   = (toGrid(energyMax) - gridStart) / (numGridPoints - 1);
+    const auto gridEnergy = [&](const double u) { return fromGrid(gridStart + u * gridStep); };
+
+    const auto* indices = materialTables.indices.data();
+    const auto* table   = materialTables.materials.data();
+
+    // the lookup tables are appended after all of them are built, so that the exact refractive index below never uses a lookup table
+    auto luts       = std::vector<double>();
+    auto lutOffsets = std::vector<std::pair<int, int>>();  // material, offset in luts
+
+    for (int material = 1; material <= 133; ++material) {
+        const auto tableEnergies = collectTableEnergies(material, indices, table);
+        if (tableEnergies.empty()) continue;
+
+        const auto exact = [&](const double energy) -> std::optional<complex::Complex> {
+            if (!hasExactRefractiveIndex(energy, material, indices, table)) return std::nullopt;
+            return getRefractiveIndex(energy, material, indices, table);
+        };
+
+        auto values = std::vector<std::optional<complex::Complex>>(numGridPoints);
+        for (int i = 0; i < numGridPoints; ++i) values[i] = exact(gridEnergy(i));
+
+        // deviation of the interpolation in grid interval i from the exact refractive index
+        const auto interpolationError = [&](const int i, const double energy) {
+            const auto value = exact(energy);
+            if (!value) return std::numeric_limits<double>::infinity();
+            const auto t            = (toGrid(energy) - gridStart) / gridStep - i;
+            const auto interpolated = *values[i] + t * (*values[i + 1] - *values[i]);
+            return std::max(std::abs(interpolated.real() - value->real()), std::abs(interpolated.imag() - value->imag()));
+        };
+
+        auto lut = std::vector<double>{gridStart, 1.0 / gridStep, static_cast<double>(numGridPoints), logarithmic ? 1.0 : 0.0};
+        auto numValidIntervals = 0;
+        auto tableEnergy       = tableEnergies.begin();
+        for (int i = 0; i < numGridPoints; ++i) {
+            auto valid = false;
+            if (i < numGridPoints - 1 && values[i] && values[i + 1]) {
+                // the exact refractive index has kinks at the table entries, check them as well as the midpoint
+                const auto low  = gridEnergy(i);
+                const auto high = gridEnergy(i + 1);
+                auto maxError   = interpolationError(i, gridEnergy(i + 0.5));
+                tableEnergy     = std::upper_bound(tableEnergy, tableEnergies.end(), low);
+                for (auto it = tableEnergy; it != tableEnergies.end() && *it < high; ++it) maxError = std::max(maxError, interpolationError(i, *it));
+                valid = maxError <= config.tolerance;
+            }
+
+            const auto value = values[i].value_or(complex::Complex(0.0, 0.0));
+            lut.push_back(value.real());
+            lut.push_back(value.imag());
+            lut.push_back(valid ? 1.0 : 0.0);
+            numValidIntervals += valid ? 1 : 0;
+        }
+
+        RAYX_VERB << "refractive index lookup table of material " << material << ": " << numValidIntervals << " of " << numGridPoints - 1
+                  << " grid intervals within tolerance";
+        if (numValidIntervals == 0) continue;
+
+        lutOffsets.emplace_back(material, static_cast<int>(luts.size()));
+        luts.insert(luts.end(), lut.begin(), lut.end());
+    }
+
+    const auto lutsBegin = static_cast<int>(materialTables.materials.size());
+    for (const auto [material, offset] : lutOffsets) materialTables.indices[REFRACTIVE_INDEX_LUT_INDICES_OFFSET + material - 1] = lutsBegin + offset;
+    materialTables.materials.insert(materialTables.materials.end(), luts.begin(), luts.end());
+}
+
+std::optional<glm::dvec2> calcSourcesEnergyRange(const Group& group) {
+    auto range = std::optional<glm::dvec2>();
+    const auto include = [&range](const double energyMin, const double energyMax) {
+        range = range ? glm::dvec2(std::min(range->x, energyMin), std::max(range->y, energyMax)) : glm::dvec2(energyMin, energyMax);
+    };
+
+    for (const auto* source : group.getSources()) {
+        // these sources have no energy distribution
+        if (source->getType() == ElementType::DipoleSource || source->getType() == ElementType::RayListSource) continue;
+
+        std::visit(
+            [&]<typename T>(const T& value) {
+                if constexpr (std::is_same_v<T, HardEdge> || std::is_same_v<T, SeparateEnergies>) {
+                    const auto halfSpread = std::abs(value.m_energySpread) / 2.0;
+                    include(value.m_centerEnergy - halfSpread, value.m_centerEnergy + halfSpread);
+                } else if constexpr (std::is_same_v<T, SoftEdge>) {
+                    const auto halfSpread = SOFT_EDGE_NUM_SIGMAS * std::abs(value.m_sigma);
+                    include(value.m_centerEnergy - halfSpread, value.m_centerEnergy + halfSpread);
+                } else if constexpr (std::is_same_v<T, DatFile>) {
+                    for (const auto& line : value.m_Lines) include(line.m_energy, line.m_energy);
+                }
+            },
+            source->getEnergyDistribution());
+    }
+
+    return range;
+}
+
+}  // namespace rayx
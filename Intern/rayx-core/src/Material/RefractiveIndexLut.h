@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glm.hpp>
+#include <optional>
+
+#include "Core.h"
+#include "Material.h"
+
+namespace rayx {
+
+class Group;
+
+/// spacing of the energy grid of a refractive index lookup table
+enum class EnergyGridSpacing { Uniform, Logarithmic };
+
+/**
+ * @brief Configuration of the energy gridded refractive index lookup tables.
+ * The refractive index of each used material is resampled onto an energy grid covering the energies of the sources. The tracer then looks up
+ * n and k with index arithmetic and linear interpolation, instead of a binary search in the material tables.
+ * Grid intervals where interpolation deviates from the exact refractive index by more than `tolerance` (e.g. around absorption edges) are
+ * marked invalid. For energies in these intervals, and for energies outside of the grid, the exact refractive index is used.
+ */
+struct RAYX_API RefractiveIndexLutConfig {
+    EnergyGridSpacing spacing = EnergyGridSpacing::Logarithmic;
+    int numGridPoints         = 4096;
+    double tolerance          = 1e-9;  ///< maximum absolute error of n and k
+};
+
+/**
+ * @brief Appends an energy gridded lookup table for every material with table entries to `materialTables`, and references them in the indices.
+ * The error bound is verified at the midpoint of each grid interval and at each entry of the material tables within the interval.
+ * @param energyRange minimum and maximum energy covered by the grid
+ */
+RAYX_API void appendRefractiveIndexLuts(MaterialTables& materialTables, glm::dvec2 energyRange, const RefractiveIndexLutConfig& config);
+
+/// returns the range of energies emitted by the sources of the group, or nothing if it is unknown for all sources (e.g. dipole sources)
+RAYX_API std::optional<glm::dvec2> calcSourcesEnergyRange(const Group& group);
+
+}  // namespace rayx
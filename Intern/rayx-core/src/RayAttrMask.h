@@ -14,7 +14,7 @@
 #error macro 'X' must not be defined at this point
 #endif
 
-#define RAYX_X_MACRO_RAY_ATTR_PATH_ID             X(int32_t, path_id, PathId)
+#define RAYX_X_MACRO_RAY_ATTR_PATH_ID             X(int64_t, path_id, PathId)
 #define RAYX_X_MACRO_RAY_ATTR_PATH_EVENT_ID       X(int32_t, path_event_id, PathEventId)
 #define RAYX_X_MACRO_RAY_ATTR_POSITION_X          X(double, position_x, PositionX)
 #define RAYX_X_MACRO_RAY_ATTR_POSITION_Y          X(double, position_y, PositionY)
@@ -27,20 +27,28 @@ bool Rays::contains(const RayAttrMask attr) const { return (attrMask() & attr) =
 
 bool Rays::empty() const { return size() == 0; }
 
-int Rays::size() const {
+int64_t Rays::size() const {
 #define X(type, name, flag) \
-    if (name.size() != 0) return static_cast<int>(name.size());
+    if (name.size() != 0) return static_cast<int64_t>(name.size());
     RAYX_X_MACRO_RAY_ATTR
 #undef X
     return 0;
 }
 
-int Rays::numPaths() const {
+int64_t Rays::numPaths() const {
     auto path_id_copy = path_id;
     std::sort(path_id_copy.begin(), path_id_copy.end());
     return std::distance(path_id_copy.begin(), std::unique(path_id_copy.begin(), path_id_copy.end()));
 }
 
+size_t Rays::bytes() const {
+    auto bytes = size_t{0};
+#define X(type, name, flag) bytes += name.size() * sizeof(type);
+    RAYX_X_MACRO_RAY_ATTR
+#undef X
+    return bytes;
+}
+
 Rays& Rays::append(const Rays& other) {
     RAYX_PROFILE_FUNCTION_STDOUT();
 
@@ -53,6 +61,7 @@ Rays& Rays::append(const Rays& other) {
     RAYX_X_MACRO_RAY_ATTR
 #undef X
 
+    m_objectOffsets.clear();
     return *this;
 }
 
@@ -65,12 +74,12 @@ Rays Rays::concat(const std::vector<Rays>& rays_list) {
         if (attr1 != attr2) throw std::runtime_error("Rays::concat requires all Rays to have the same attributes");
     }
 
-    auto n = 0;
+    auto n = int64_t{0};
     for (const auto& rays : rays_list) n += rays.size();
 
     Rays result;
 
-    auto offset = 0;
+    auto offset = int64_t{0};
     for (const auto& r : rays_list) {
 #define X(type, name, flag)                                                    \
     if (!!(r.attrMask() & RayAttrMask::flag)) {                                \
@@ -79,22 +88,71 @@ Rays Rays::concat(const std::vector<Rays>& rays_list) {
     }
         RAYX_X_MACRO_RAY_ATTR
 #undef X
-        offset += static_cast<int>(r.size());
+        offset += r.size();
     }
 
     return result;
 }
 
 Rays Rays::sortByObjectId() const {
+    RAYX_PROFILE_FUNCTION_STDOUT();
+
     if (!contains(RayAttrMask::ObjectId)) throw std::runtime_error("Rays::sortByObjectId() requires object_id attribute to be present");
-    return sort([&object_id = object_id](int lhs, int rhs) { return object_id[lhs] < object_id[rhs]; });
+
+    const auto attr = attrMask();
+    const auto n    = size();
+
+    // counting sort. count the rays of each object, then scatter the indices of the rays to the offsets of their objects
+    auto numObjects = 0;
+    for (const auto id : object_id) {
+        if (id < 0) throw std::runtime_error("Rays::sortByObjectId() requires object_id to be non-negative");
+        numObjects = std::max(numObjects, id + 1);
+    }
+
+    auto offsets = std::vector<int64_t>(numObjects + 1, 0);
+    for (const auto id : object_id) ++offsets[id + 1];
+    std::inclusive_scan(offsets.begin(), offsets.end(), offsets.begin());
+
+    // the scatter advances the offsets, keep the index of the rays of each object for the result
+    Rays result;
+    result.m_objectOffsets = offsets;
+
+    auto indices = std::vector<int64_t>(n);
+    for (int64_t i = 0; i < n; ++i) indices[offsets[object_id[i]]++] = i;
+
+#define X(type, name, flag)                                                \
+    if (!!(attr & RayAttrMask::flag)) {                                    \
+        result.name.resize(name.size());                                   \
+        for (int64_t i = 0; i < n; ++i) result.name[i] = name[indices[i]]; \
+    }
+    RAYX_X_MACRO_RAY_ATTR
+#undef X
+
+    return result;
+}
+
+std::vector<int64_t> Rays::objectOffsets() const {
+    if (!contains(RayAttrMask::ObjectId)) throw std::runtime_error("Rays::objectOffsets() requires object_id attribute to be present");
+    if (hasObjectOffsets()) return m_objectOffsets;
+
+    auto offsets = std::vector<int64_t>{0};
+    for (int64_t i = 0; i < size(); ++i) {
+        const auto id = object_id[i];
+        if (id < static_cast<int>(offsets.size()) - 2 || id < 0)
+            throw std::runtime_error("Rays::objectOffsets() requires the rays to be sorted by object_id");
+
+        // close the ranges of the objects up to this one
+        while (static_cast<int>(offsets.size()) < id + 2) offsets.push_back(i);
+        offsets.back() = i + 1;
+    }
+    return offsets;
 }
 
 Rays Rays::sortByPathIdAndPathEventId() const {
     if (!contains(RayAttrMask::PathId) || !contains(RayAttrMask::PathEventId))
         throw std::runtime_error("Rays::sortByPathIdAndThenPathEventId() requires path_id and path_event_id attributes to be present");
 
-    return sort([&path_id = path_id, &path_event_id = path_event_id](int lhs, int rhs) {
+    return sort([&path_id = path_id, &path_event_id = path_event_id](int64_t lhs, int64_t rhs) {
         if (path_id[lhs] != path_id[rhs])
             return path_id[lhs] < path_id[rhs];
         else
@@ -107,14 +165,34 @@ Rays& Rays::filterByAttrMask(const RayAttrMask mask) {
     if (!(mask & RayAttrMask::flag)) name.clear();
     RAYX_X_MACRO_RAY_ATTR
 #undef X
+    if (!(mask & RayAttrMask::ObjectId)) m_objectOffsets.clear();
     return *this;
 }
 
 Rays Rays::filterByObjectId(const int object_id) const {
     if (!contains(RayAttrMask::ObjectId)) throw std::runtime_error("Rays::filterByObjectId requires object_id attribute to be present");
-    return filter([&](int i) { return this->object_id[i] == object_id; });
+
+    if (hasObjectOffsets()) {
+        if (object_id < 0 || static_cast<int>(m_objectOffsets.size()) <= object_id + 1) return Rays();
+        return slice(m_objectOffsets[object_id], m_objectOffsets[object_id + 1]);
+    }
+    return filter([&](int64_t i) { return this->object_id[i] == object_id; });
+}
+
+Rays Rays::slice(const int64_t begin, const int64_t end) const {
+    if (begin < 0 || end < begin || size() < end) throw std::runtime_error("Rays::slice() requires 0 <= begin <= end <= size()");
+
+    Rays result;
+#define X(type, name, flag) \
+    if (!name.empty()) result.name.assign(name.begin() + begin, name.begin() + end);
+    RAYX_X_MACRO_RAY_ATTR
+#undef X
+
+    return result;
 }
 
+bool Rays::hasObjectOffsets() const { return !m_objectOffsets.empty() && m_objectOffsets.back() == static_cast<int64_t>(object_id.size()); }
+
 Rays Rays::filterByLastEventInPath() const {
     RAYX_PROFILE_FUNCTION_STDOUT();
 
@@ -122,9 +200,9 @@ Rays Rays::filterByLastEventInPath() const {
         throw std::runtime_error("Rays::finalEventsPerPath requires path_id and path_event_id attributes to be present");
 
     const auto n = size();
-    std::unordered_map<int32_t, int> bestIndex;  // path_id -> index of max path_event_id
+    std::unordered_map<int64_t, int64_t> bestIndex;  // path_id -> index of max path_event_id
 
-    for (int i = 0; i < n; ++i) {
+    for (int64_t i = 0; i < n; ++i) {
         auto pid   = path_id[i];
         auto pevid = path_event_id[i];
         auto it    = bestIndex.find(pid);
@@ -132,17 +210,17 @@ Rays Rays::filterByLastEventInPath() const {
     }
 
     // collect the selected indices
-    std::vector<int> indices;
+    std::vector<int64_t> indices;
     indices.reserve(bestIndex.size());
     for (auto& kv : bestIndex) { indices.push_back(kv.second); }
 
     // build result Rays using selected indices
     const auto attr = attrMask();
     Rays result;
-#define X(type, name, flag)                                                                                           \
-    if (rayx::contains(attr, RayAttrMask::flag)) {                                                                    \
-        result.name.resize(indices.size());                                                                           \
-        std::transform(indices.begin(), indices.end(), result.name.begin(), [this](const int i) { return name[i]; }); \
+#define X(type, name, flag)                                                                                               \
+    if (rayx::contains(attr, RayAttrMask::flag)) {                                                                        \
+        result.name.resize(indices.size());                                                                               \
+        std::transform(indices.begin(), indices.end(), result.name.begin(), [this](const int64_t i) { return name[i]; }); \
     }
     RAYX_X_MACRO_RAY_ATTR
 #undef X
@@ -154,7 +232,7 @@ bool Rays::isValid() const {
     const auto sz   = size();
 
 #define X(type, name, flag) \
-    if (rayx::contains(attr, RayAttrMask::flag) && static_cast<int>(name.size()) != sz) return false;
+    if (rayx::contains(attr, RayAttrMask::flag) && static_cast<int64_t>(name.size()) != sz) return false;
     RAYX_X_MACRO_RAY_ATTR
 #undef X
     return true;
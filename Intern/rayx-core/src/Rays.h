@@ -32,22 +32,22 @@ struct RAYX_API Rays {
     RAYX_X_MACRO_RAY_ATTR
 #undef X
 
-    glm::dvec3 position(const int i) const { return glm::dvec3(position_x[i], position_y[i], position_z[i]); }
-    void position(const int i, const glm::dvec3 position) {
+    glm::dvec3 position(const int64_t i) const { return glm::dvec3(position_x[i], position_y[i], position_z[i]); }
+    void position(const int64_t i, const glm::dvec3 position) {
         position_x[i] = position.x;
         position_y[i] = position.y;
         position_z[i] = position.z;
     }
 
-    glm::dvec3 direction(const int i) const { return glm::dvec3(direction_x[i], direction_y[i], direction_z[i]); }
-    void direction(const int i, const glm::dvec3 direction) {
+    glm::dvec3 direction(const int64_t i) const { return glm::dvec3(direction_x[i], direction_y[i], direction_z[i]); }
+    void direction(const int64_t i, const glm::dvec3 direction) {
         direction_x[i] = direction.x;
         direction_y[i] = direction.y;
         direction_z[i] = direction.z;
     }
 
-    ElectricField electric_field(const int i) const { return ElectricField(electric_field_x[i], electric_field_y[i], electric_field_z[i]); }
-    void electric_field(const int i, const ElectricField electric_field) {
+    ElectricField electric_field(const int64_t i) const { return ElectricField(electric_field_x[i], electric_field_y[i], electric_field_z[i]); }
+    void electric_field(const int64_t i, const ElectricField electric_field) {
         electric_field_x[i] = electric_field.x;
         electric_field_y[i] = electric_field.y;
         electric_field_z[i] = electric_field.z;
@@ -85,14 +85,20 @@ struct RAYX_API Rays {
      * @brief Get the number of events in the ray list.
      * @return The number of events in the ray list.
      */
-    int size() const;
+    int64_t size() const;
 
     /**
      * @brief Get the number of unique paths in the ray list.
      * @return The number of unique path IDs in the ray list.
      * @note Requires that path_id is recorded.
      */
-    int numPaths() const;
+    int64_t numPaths() const;
+
+    /**
+     * @brief Get the memory occupied by the recorded attributes.
+     * @return The sum of the sizes of all attribute vectors in bytes.
+     */
+    size_t bytes() const;
 
     /**
      * @brief Append another Rays instance to this one.
@@ -112,11 +118,22 @@ struct RAYX_API Rays {
 
     /**
      * @brief Sort rays by object_id, so that rays interacting with the same object are grouped together.
+     * This is a counting sort, linear in the number of rays and objects. The order of the rays of each object is preserved.
+     * The sorted rays keep the index of the rays of each object (see objectOffsets), so that filterByObjectId selects the rays of an object by
+     * slicing.
      * @return A new Rays instance with rays sorted by object_id.
-     * @note Requires that object_id is recorded.
+     * @note Requires that object_id is recorded and not negative.
      */
     [[nodiscard]] Rays sortByObjectId() const;
 
+    /**
+     * @brief Get the index of the rays of each object in rays sorted by object_id.
+     * The rays of object i are [offsets[i], offsets[i + 1]). Rays returned by sortByObjectId keep their index, otherwise it is computed.
+     * @return The offsets of the rays of each object. Its size is the largest object_id + 2.
+     * @note Requires that object_id is recorded and that the rays are sorted by object_id, e.g. via sortByObjectId.
+     */
+    std::vector<int64_t> objectOffsets() const;
+
     /**
      * @brief Sort rays by path_id and then by path_event_id, so that rays belonging to the same path are grouped together,
      * and within each path, rays are ordered by their event sequence.
@@ -129,7 +146,7 @@ struct RAYX_API Rays {
 
     /**
      * @brief Sort rays using a custom comparison function.
-     * The comparison function should take two indices (int) and return true if the first index should come before the second.
+     * The comparison function should take two indices (int64_t) and return true if the first index should come before the second.
      * This method can be used to implement custom sorting logic, such as sorting by multiple attributes.
      * @tparam Compare A callable type that defines the comparison function.
      * @param comp The comparison function to use for sorting. Must satisfy the requirements of Compare, see
@@ -139,10 +156,10 @@ struct RAYX_API Rays {
      * @example
      * ```cpp
      * // sort by path_id.
-     * rays = rays.sort([&](int lhs, int rhs) { return rays.path_id[lhs] < rays.path_id[rhs]; });
+     * rays = rays.sort([&](int64_t lhs, int64_t rhs) { return rays.path_id[lhs] < rays.path_id[rhs]; });
      * // sort by path_id and then by path_event_id.
-     * rays = rays.sort([&](int lhs, int rhs) { if (rays.path_id[lhs] == rays.path_id[rhs]) return rays.path_id[lhs] < rays.path_id[rhs]; else return
-     * rays.path_event_id[lhs] < rays.path_event_id[rhs]; });
+     * rays = rays.sort([&](int64_t lhs, int64_t rhs) { if (rays.path_id[lhs] == rays.path_id[rhs]) return rays.path_id[lhs] < rays.path_id[rhs];
+     * else return rays.path_event_id[lhs] < rays.path_event_id[rhs]; });
      * ```
      */
     template <typename Compare>
@@ -157,12 +174,22 @@ struct RAYX_API Rays {
 
     /**
      * @brief Filter the rays to only include those that interacted with a specific object.
+     * Rays returned by sortByObjectId are sliced via their index of the rays of each object, in time linear in the number of selected rays.
+     * Otherwise all rays are scanned.
      * @param object_id The ID of the object to filter by.
      * @return A new Rays instance containing only rays that interacted with the specified object.
      * @note Requires that object_id is recorded.
      */
     [[nodiscard]] Rays filterByObjectId(const int object_id) const;
 
+    /**
+     * @brief Copy a range of rays.
+     * @param begin Index of the first ray.
+     * @param end Index one past the last ray.
+     * @return A new Rays instance containing the rays [begin, end).
+     */
+    [[nodiscard]] Rays slice(const int64_t begin, const int64_t end) const;
+
     /**
      * @brief Filter the rays to only include the final event of each unique path.
      * The final event is determined by the maximum path_event_id for each path_id.
@@ -173,7 +200,7 @@ struct RAYX_API Rays {
 
     /**
      * @brief Filter the rays using a custom predicate function.
-     * The predicate function should take an index (int) and return true if the ray at that index should be included.
+     * The predicate function should take an index (int64_t) and return true if the ray at that index should be included.
      * This method can be used to implement custom filtering logic, such as filtering by multiple attributes or complex conditions.
      * @tparam Pred A callable type that defines the predicate function.
      * @param pred The predicate function to use for filtering.
@@ -181,7 +208,7 @@ struct RAYX_API Rays {
      * @note Requires that path_event_id is recorded.
      * @example
      * ```cpp
-     * rays = rays.filter([&](int i) { return rays.path_event_id[i] == 3; }); // to filter by path_event_id == 3.
+     * rays = rays.filter([&](int64_t i) { return rays.path_event_id[i] == 3; }); // to filter by path_event_id == 3.
      * ```
      */
     template <typename Pred>
@@ -189,17 +216,17 @@ struct RAYX_API Rays {
 
     /**
      * @brief Count the number of rays that satisfy a given predicate function.
-     * The predicate function should take an index (int) and return true if the ray at that index satisfies the condition.
+     * The predicate function should take an index (int64_t) and return true if the ray at that index satisfies the condition.
      * @tparam Pred A callable type that defines the predicate function.
      * @param pred The predicate function to use for counting.
      * @return The number of rays for which the predicate returns true.
      * @example
      * ```cpp
-     * int count = rays.count([&](int i) { return rays.object_id[i] == 3; }); // to count rays with object_id == 3.
+     * int64_t count = rays.count([&](int64_t i) { return rays.object_id[i] == 3; }); // to count rays with object_id == 3.
      * ```
      */
     template <typename Pred>
-    int count(Pred pred) const;
+    int64_t count(Pred pred) const;
 
     /**
      * @brief Check if the sizes of all recorded attribute vectors are valid (i.e., all the same length).
@@ -208,6 +235,13 @@ struct RAYX_API Rays {
     bool isValid() const;
 
     // TODO: implement helper methods to iterate over attributes, to get rid of most of the X-macros
+
+  private:
+    /// index of the rays of each object, set by sortByObjectId and dropped by operations that reorder or change the rays in place.
+    /// modifying the attribute vectors directly does not update it
+    std::vector<int64_t> m_objectOffsets;
+
+    bool hasObjectOffsets() const;
 };
 
 template <typename Compare>
@@ -217,15 +251,15 @@ Rays Rays::sort(Compare comp) const {
     const auto attr = attrMask();
     const auto n    = size();
 
-    auto indices = std::vector<int>(n);
-    std::iota(indices.begin(), indices.end(), 0);
+    auto indices = std::vector<int64_t>(n);
+    std::iota(indices.begin(), indices.end(), int64_t{0});
     std::sort(indices.begin(), indices.end(), comp);
 
     Rays result;
-#define X(type, name, flag)                                            \
-    if (!!(attr & RayAttrMask::flag)) {                                \
-        result.name.resize(name.size());                               \
-        for (int i = 0; i < n; ++i) result.name[i] = name[indices[i]]; \
+#define X(type, name, flag)                                                \
+    if (!!(attr & RayAttrMask::flag)) {                                    \
+        result.name.resize(name.size());                                   \
+        for (int64_t i = 0; i < n; ++i) result.name[i] = name[indices[i]]; \
     }
     RAYX_X_MACRO_RAY_ATTR
 #undef X
@@ -240,15 +274,15 @@ Rays Rays::filter(Pred pred) const {
     const auto attr = attrMask();
     const auto n    = size();
 
-    auto indices = std::vector<int>{};
-    for (int i = 0; i < n; ++i)
+    auto indices = std::vector<int64_t>{};
+    for (int64_t i = 0; i < n; ++i)
         if (pred(i)) indices.push_back(i);
 
     Rays result;
-#define X(type, name, flag)                                                                                           \
-    if (!!(attr & RayAttrMask::flag)) {                                                                               \
-        result.name.resize(indices.size());                                                                           \
-        std::transform(indices.begin(), indices.end(), result.name.begin(), [this](const int i) { return name[i]; }); \
+#define X(type, name, flag)                                                                                               \
+    if (!!(attr & RayAttrMask::flag)) {                                                                                   \
+        result.name.resize(indices.size());                                                                               \
+        std::transform(indices.begin(), indices.end(), result.name.begin(), [this](const int64_t i) { return name[i]; }); \
     }
     RAYX_X_MACRO_RAY_ATTR
 #undef X
@@ -257,10 +291,10 @@ Rays Rays::filter(Pred pred) const {
 }
 
 template <typename Pred>
-int Rays::count(Pred pred) const {
-    const int sz = size();
-    int count    = 0;
-    for (int i = 0; i < sz; ++i)
+int64_t Rays::count(Pred pred) const {
+    const int64_t sz = size();
+    int64_t count    = 0;
+    for (int64_t i = 0; i < sz; ++i)
         if (pred(i)) ++count;
     return count;
 }
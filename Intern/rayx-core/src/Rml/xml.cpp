@@ -231,7 +231,7 @@ double Parser::parseRoughnessCoating() const {
 }
 
 
-bool paramRAYUICoating(const rapidxml::xml_node<>* node, Coating::MultilayerCoating* out) {
+bool paramRAYUICoating(const rapidxml::xml_node<>* node, std::vector<CoatingLayer>* out) {
     if (!node || !out) { return false; }
 
     // Root für die Layer bestimmen: entweder 'node' selbst oder <param id="Coating">
@@ -240,7 +240,7 @@ bool paramRAYUICoating(const rapidxml::xml_node<>* node, Coating::MultilayerCoat
     if (!paramInt(node, "numberLayer", &numberLayer)) {
         return false;
     }
-    out->numLayers = numberLayer;
+    out->resize(numberLayer);
 
     for (int i = 0; i < numberLayer; ++i) {
         std::string materialParam   = "materialCoating" + std::to_string(i + 1);
@@ -253,14 +253,14 @@ bool paramRAYUICoating(const rapidxml::xml_node<>* node, Coating::MultilayerCoat
         }
         Material material;
         materialFromString(materialStr, &material);
-        out->material[i] = static_cast<int>(material);
+        (*out)[i].material = static_cast<int>(material);
 
-        if (!paramDouble(node, thicknessParam.c_str(), &out->thickness[i])) {
+        if (!paramDouble(node, thicknessParam.c_str(), &(*out)[i].thickness)) {
             RAYX_VERB << "Missing thickness for layer " << (i + 1);
             return false;
         }
 
-        if (!paramDouble(node, roughnessParam.c_str(), &out->roughness[i])) {
+        if (!paramDouble(node, roughnessParam.c_str(), &(*out)[i].roughness)) {
             RAYX_VERB << "Missing roughness for layer " << (i + 1);
             return false;
         }
@@ -270,24 +270,25 @@ bool paramRAYUICoating(const rapidxml::xml_node<>* node, Coating::MultilayerCoat
     if (!paramStr(node, "materialTopLayer", &materialTopLayer)) {
         Material material;
         materialFromString(materialTopLayer, &material);
-        out->material[numberLayer] = static_cast<int>(material);
+        CoatingLayer topLayer{};
+        topLayer.material = static_cast<int>(material);
 
-        if (!paramDouble(node, "thicknessTopLayer", &out->thickness[numberLayer])) {
+        if (!paramDouble(node, "thicknessTopLayer", &topLayer.thickness)) {
             RAYX_VERB << "Missing thickness for toplayer ";
             return false;
         }
 
-        if (!paramDouble(node, "roughnessTopLayer", &out->roughness[numberLayer])) {
+        if (!paramDouble(node, "roughnessTopLayer", &topLayer.roughness)) {
             RAYX_VERB << "Missing roughness for toplayer ";
             return false;
         }
-        out->numLayers += 1;
+        out->push_back(topLayer);
     }
     return true;
 }
 
 // multilayer coating
-bool paramCoating(const rapidxml::xml_node<>* node, Coating::MultilayerCoating* out) {
+bool paramCoating(const rapidxml::xml_node<>* node, std::vector<CoatingLayer>* out) {
     if (!node || !out) { return false; }
 
     // Root für die Layer bestimmen: entweder 'node' selbst oder <param id="Coating">
@@ -314,10 +315,10 @@ bool paramCoating(const rapidxml::xml_node<>* node, Coating::MultilayerCoating*
         return false;
     }
 
-    out->numLayers = numLayers;
+    out->resize(numLayers);
 
     int i = 0;
-    for (auto* layerNode = layersRoot->first_node("layer"); layerNode; layerNode = layerNode->next_sibling("layer"), ++i) {
+    for (auto* layerNode = layersRoot->first_node("layer"); layerNode && i < numLayers; layerNode = layerNode->next_sibling("layer"), ++i) {
         const char* materialStr = nullptr;
         if (auto* m = layerNode->first_attribute("material")) {
             materialStr = m->value();
@@ -327,17 +328,17 @@ bool paramCoating(const rapidxml::xml_node<>* node, Coating::MultilayerCoating*
         }
         Material material;
         materialFromString(materialStr, &material);
-        out->material[i] = static_cast<int>(material);
+        (*out)[i].material = static_cast<int>(material);
 
         if (auto* t = layerNode->first_attribute("thickness")) {
-            out->thickness[i] = std::stod(t->value());
+            (*out)[i].thickness = std::stod(t->value());
         } else {
             RAYX_VERB << "Missing thickness for layer " << (i + 1);
             return false;
         }
 
         if (auto* r = layerNode->first_attribute("roughness")) {
-            out->roughness[i] = std::stod(r->value());
+            (*out)[i].roughness = std::stod(r->value());
         } else {
             RAYX_VERB << "Missing roughness for layer " << (i + 1);
             return false;
@@ -345,11 +346,7 @@ bool paramCoating(const rapidxml::xml_node<>* node, Coating::MultilayerCoating*
     }
 
     if (definedCoatings < numLayers) {
-        for (int j = definedCoatings; j < numLayers; ++j) {
-            out->material[j]  = out->material[j % definedCoatings];
-            out->thickness[j] = out->thickness[j % definedCoatings];
-            out->roughness[j] = out->roughness[j % definedCoatings];
-        }
+        for (int j = definedCoatings; j < numLayers; ++j) { (*out)[j] = (*out)[j % definedCoatings]; }
     }
 
     return true;
@@ -481,8 +478,8 @@ Material Parser::parseMaterial() const {
     return m;
 }
 
-Coating::MultilayerCoating Parser::parseCoating() const {
-    Coating::MultilayerCoating m;
+std::vector<CoatingLayer> Parser::parseCoating() const {
+    std::vector<CoatingLayer> m;
     // get children from param Coating
 
     if (!paramCoating(node, &m) && !paramRAYUICoating(node, &m)) { RAYX_EXIT << "parseCoating failed"; }
@@ -102,7 +102,7 @@ struct RAYX_API Parser {
     double parseAdditionalOrder() const;
     Rad parseAzimuthalAngle() const;
     std::filesystem::path parseEnergyDistributionFile() const;
-    Coating::MultilayerCoating parseCoating() const;
+    std::vector<CoatingLayer> parseCoating() const;
     double parseThicknessCoating() const;
     double parseRoughnessCoating() const;
 
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+
+#include "Core.h"
+
+#if defined(__CUDA_ARCH__)
+#include <cooperative_groups.h>
+#endif
+
+namespace rayx {
+
+/// returns a unique index for each call, by atomically incrementing `counter`. indices returned to the same thread are ascending.
+/// on CUDA devices, the increments of the threads of a warp that call this function together are aggregated into a single atomic operation
+RAYX_FN_ACC
+inline int atomicAppendIndex(int* counter) {
+#if defined(__CUDA_ARCH__)
+    const auto group = cooperative_groups::coalesced_threads();
+    auto base        = 0;
+    if (group.thread_rank() == 0) base = atomicAdd(counter, static_cast<int>(group.size()));
+    return group.shfl(base, 0) + static_cast<int>(group.thread_rank());
+#elif defined(__HIP_DEVICE_COMPILE__)
+    return atomicAdd(counter, 1);
+#else
+    return std::atomic_ref<int>(*counter).fetch_add(1, std::memory_order_relaxed);
+#endif
+}
+
+/// atomically adds `value` to `*address`
+RAYX_FN_ACC
+inline void atomicAddDouble(double* address, const double value) {
+#if defined(__CUDA_ARCH__) || defined(__HIP_DEVICE_COMPILE__)
+    atomicAdd(address, value);
+#else
+    std::atomic_ref<double>(*address).fetch_add(value, std::memory_order_relaxed);
+#endif
+}
+
+}  // namespace rayx
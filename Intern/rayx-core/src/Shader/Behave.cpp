@@ -59,7 +59,7 @@ void behaveCrystal(detail::Ray& __restrict ray, const Behaviour::Crystal& __rest
 // Batterman, B. W., & Cole, H. (1964). "Dynamical Diffraction of X Rays by Perfect Crystals".
 // Reviews of Modern Physics, 36(3), 681-717. https://doi.org/10.1103/RevModPhys.36.681
 RAYX_FN_ACC
-void behaveSlit(detail::Ray& __restrict ray, const Behaviour::Slit& __restrict slit) {
+void behaveSlit(detail::Ray& __restrict ray, const Behaviour::Slit& __restrict slit, const double* __restrict diffractionTable) {
     // slit lies in x-y plane instead of x-z plane as other elements
     Cutout openingCutout  = slit.m_openingCutout;
     Cutout beamstopCutout = slit.m_beamstopCutout;
@@ -83,10 +83,10 @@ void behaveSlit(detail::Ray& __restrict ray, const Behaviour::Slit& __restrict s
     if (wavelength > 0) {
         openingCutout.visit([&]<typename T>(const T& cutout) {
             if constexpr (std::is_same_v<T, Cutout::Rect>) {
-                fraun_diff(cutout.m_width, wavelength, dPhi, ray.rand);
-                fraun_diff(cutout.m_length, wavelength, dPsi, ray.rand);
+                fraun_diff_tabulated(cutout.m_width, wavelength, dPhi, ray.rand, diffractionTable);
+                fraun_diff_tabulated(cutout.m_length, wavelength, dPsi, ray.rand, diffractionTable);
             } else if constexpr (std::is_same_v<T, Cutout::Elliptical>) {
-                bessel_diff(cutout.m_diameter_z, wavelength, dPhi, dPsi, ray.rand);
+                bessel_diff_tabulated(cutout.m_diameter_z, wavelength, dPhi, dPsi, ray.rand, diffractionTable);
             } else {
                 _throw("encountered Slit with unsupported openingCutout!");
             }
@@ -141,7 +141,8 @@ void behaveGrating(detail::Ray& __restrict ray, const Behaviour::Grating& __rest
 
 RAYX_FN_ACC
 void behaveMirror(detail::Ray& __restrict ray, const CollisionPoint& __restrict col, const Coating& __restrict coating, const int material,
-                  const int* __restrict materialIndices, const double* __restrict materialTable) {
+                  const CoatingLayer* __restrict coatingLayers, const double* __restrict reflectivityTables, const int* __restrict materialIndices,
+                  const double* __restrict materialTable) {
     // calculate the new direction after the reflection
     const auto incident_vec = ray.direction;
     const auto reflect_vec  = glm::reflect(incident_vec, col.normal);
@@ -158,44 +159,19 @@ void behaveMirror(detail::Ray& __restrict ray, const CollisionPoint& __restrict
             ray.electric_field = reflect_field;
             ray.order          = 0;
         }
-    } else if (coating.is<Coating::OneCoating>()) {
-        Coating::OneCoating oneCoating = coating.get<Coating::OneCoating>();
-
-        constexpr int vacuum_material = -1;
-        const auto vacuum_ior         = getRefractiveIndex(ray.energy, vacuum_material, materialIndices, materialTable);
-        const auto coating_ior        = getRefractiveIndex(ray.energy, oneCoating.material, materialIndices, materialTable);
-        const auto substrate_ior      = getRefractiveIndex(ray.energy, material, materialIndices, materialTable);
-
-        const auto angle         = angleBetweenUnitVectors(-incident_vec, col.normal);
-        const auto incidentAngle = complex::Complex(angle == 0.0 ? 1e-8 : angle, 0.0);
-
-        const double wavelength = energyToWaveLength(ray.energy);
-
-        const auto amplitude =
-            computeSingleCoatingReflectance(incidentAngle, wavelength, oneCoating.thickness, vacuum_ior, coating_ior, substrate_ior);
-
-        const auto polmat  = calcPolaririzationMatrix(incident_vec, reflect_vec, col.normal, amplitude);
-        ray.electric_field = polmat * ray.electric_field;
-        ray.order          = 0;
-    } else if (coating.is<Coating::MultilayerCoating>()) {
-        Coating::MultilayerCoating mlCoating = coating.get<Coating::MultilayerCoating>();
-        constexpr int vacuum_material        = -1;
-        const auto vacuum_ior                = getRefractiveIndex(ray.energy, vacuum_material, materialIndices, materialTable);
-        const auto substrate_ior             = getRefractiveIndex(ray.energy, material, materialIndices, materialTable);
-
-        const int n = mlCoating.numLayers;
-        complex::Complex iors[1002];
-
-        iors[0] = vacuum_ior;
-        for (int i = 0; i < n; ++i) { iors[i + 1] = getRefractiveIndex(ray.energy, mlCoating.material[i], materialIndices, materialTable); }
-        iors[n + 1] = substrate_ior;
-
-        const auto angle         = angleBetweenUnitVectors(-incident_vec, col.normal);
-        const auto incidentAngle = complex::Complex(angle == 0.0 ? 1e-8 : angle, 0.0);
-
-        const double wavelength = energyToWaveLength(ray.energy);
-
-        const auto amplitude = computeMultilayerReflectance(incidentAngle, wavelength, n, mlCoating.thickness, iors);
+    } else if (coating.is<Coating::OneCoating>() || coating.is<Coating::MultilayerCoating>()) {
+        const auto angle = angleBetweenUnitVectors(-incident_vec, col.normal);
+
+        // interpolate the reflection amplitudes in the precomputed reflectivity table of this mirror, if there is one. fall back to computing
+        // them, if there is no table or the ray is outside of its grid
+        const auto reflectivityTableOffset = coating.is<Coating::OneCoating>() ? coating.get<Coating::OneCoating>().reflectivityTableOffset
+                                                                               : coating.get<Coating::MultilayerCoating>().reflectivityTableOffset;
+        const auto tabulated = reflectivityTableOffset >= 0
+                                   ? lookupReflectivityTable(ray.energy, angle, reflectivityTables + reflectivityTableOffset)
+                                   : std::nullopt;
+        const auto amplitude = tabulated ? *tabulated
+                                         : computeCoatingReflectance(ray.energy, angle, coating, material, coatingLayers, materialIndices,
+                                                                     materialTable);
 
         const auto polmat  = calcPolaririzationMatrix(incident_vec, reflect_vec, col.normal, amplitude);
         ray.electric_field = polmat * ray.electric_field;
@@ -235,14 +211,15 @@ RAYX_FN_ACC void behaveImagePlane(detail::Ray& __restrict ray) { ray.order = 0;
 
 RAYX_FN_ACC
 void behave(detail::Ray& __restrict ray, const CollisionPoint& __restrict col, const OpticalElement& __restrict element,
+            const CoatingLayer* __restrict coatingLayers, const double* __restrict reflectivityTables, const double* __restrict diffractionTable,
             const int* __restrict materialIndices, const double* __restrict materialTable) {
     element.m_behaviour.visit([&]<typename T>(const T& behaviour) {
         if constexpr (std::is_same_v<T, Behaviour::Mirror>) {
-            behaveMirror(ray, col, element.m_coating, element.m_material, materialIndices, materialTable);
+            behaveMirror(ray, col, element.m_coating, element.m_material, coatingLayers, reflectivityTables, materialIndices, materialTable);
         } else if constexpr (std::is_same_v<T, Behaviour::Grating>) {
             behaveGrating(ray, behaviour, col);
         } else if constexpr (std::is_same_v<T, Behaviour::Slit>) {
-            behaveSlit(ray, behaviour);
+            behaveSlit(ray, behaviour, diffractionTable);
         } else if constexpr (std::is_same_v<T, Behaviour::RZP>) {
             behaveRZP(ray, behaviour, col);
         } else if constexpr (std::is_same_v<T, Behaviour::Crystal>) {
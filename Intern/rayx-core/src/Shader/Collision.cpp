@@ -10,6 +10,31 @@
 
 namespace {
 constexpr double COLLISION_EPSILON = 1e-6;
+
+// slab test of the ray against axis aligned bounds. only intersections in front of the ray are considered. bounds may be infinite
+RAYX_FN_ACC
+bool rayIntersectsBounds(const glm::dvec3& __restrict rayPosition, const glm::dvec3& __restrict rayDirection, const glm::dvec3& __restrict boundsMin,
+                         const glm::dvec3& __restrict boundsMax) {
+    auto tNear = 0.0;
+    auto tFar  = std::numeric_limits<double>::infinity();
+
+    for (int i = 0; i < 3; ++i) {
+        if (rayDirection[i] == 0.0) {
+            // ray is parallel to the slab
+            if (rayPosition[i] < boundsMin[i] || boundsMax[i] < rayPosition[i]) return false;
+            continue;
+        }
+
+        const auto invDirection = 1.0 / rayDirection[i];
+        const auto t0           = (boundsMin[i] - rayPosition[i]) * invDirection;
+        const auto t1           = (boundsMax[i] - rayPosition[i]) * invDirection;
+        tNear                   = glm::max(tNear, glm::min(t0, t1));
+        tFar                    = glm::min(tFar, glm::max(t0, t1));
+        if (tFar < tNear) return false;
+    }
+
+    return true;
+}
 }  // unnamed namespace
 
 namespace rayx {
@@ -127,228 +152,234 @@ OptCollisionPoint getQuadricCollision(const glm::dvec3& __restrict rayPosition,
     return col;
 }
 
+// every case of getQuadricCollision solves for the coordinate u along the largest component of the direction, and moves the other two
+// coordinates v and w along the ray. picking the coordinates and coefficients of the case per lane evaluates the same expressions without
+// branches:
+//   case 1: (u, v, w) = (x, y, z), case 2: (u, v, w) = (y, x, z), case 3: (u, v, w) = (z, x, y)
+RAYX_FN_ACC
+void getQuadricCollisions(const RayPacket& __restrict packet, const Surface::Quadric& __restrict q, PacketCollisions& __restrict cols) {
+    RAYX_SIMD_LOOP
+    for (int lane = 0; lane < RAY_PACKET_SIZE; ++lane) {
+        const auto px = packet.position_x[lane];
+        const auto py = packet.position_y[lane];
+        const auto pz = packet.position_z[lane];
+        const auto dx = packet.direction_x[lane];
+        const auto dy = packet.direction_y[lane];
+        const auto dz = packet.direction_z[lane];
+
+        const auto ax = glm::abs(dx);
+        const auto ay = glm::abs(dy);
+        const auto az = glm::abs(dz);
+        const auto cs = (ay >= ax && ay >= az) ? 2 : ((az >= ax && az >= ay) ? 3 : 1);
+
+        const auto pu = cs == 1 ? px : (cs == 2 ? py : pz);
+        const auto pv = cs == 1 ? py : px;
+        const auto pw = cs == 3 ? py : pz;
+        const auto du = cs == 1 ? dx : (cs == 2 ? dy : dz);
+        const auto dv = cs == 1 ? dy : dx;
+        const auto dw = cs == 3 ? dy : dz;
+
+        const auto auu = cs == 1 ? q.m_a11 : (cs == 2 ? q.m_a22 : q.m_a33);
+        const auto auv = cs == 3 ? q.m_a13 : q.m_a12;
+        const auto avv = cs == 1 ? q.m_a22 : q.m_a11;
+        const auto auw = cs == 1 ? q.m_a13 : q.m_a23;
+        const auto avw = cs == 1 ? q.m_a23 : (cs == 2 ? q.m_a13 : q.m_a12);
+        const auto aww = cs == 3 ? q.m_a22 : q.m_a33;
+        const auto au4 = cs == 1 ? q.m_a14 : (cs == 2 ? q.m_a24 : q.m_a34);
+        const auto av4 = cs == 1 ? q.m_a24 : q.m_a14;
+        const auto aw4 = cs == 3 ? q.m_a24 : q.m_a34;
+
+        const auto r1     = dv / du;
+        const auto r2     = dw / du;
+        const auto v0     = pv - r1 * pu;
+        const auto w0     = pw - r2 * pu;
+        const auto d_sign = int(glm::sign(du) * q.m_icurv);
+
+        const auto a = auu + 2 * auv * r1 + avv * r1 * r1 + 2 * auw * r2 + 2 * avw * r1 * r2 + aww * r2 * r2;
+        const auto b = au4 + av4 * r1 + aw4 * r2 + (auv + avv * r1 + avw * r2) * v0 + (auw + avw * r1 + aww * r2) * w0;
+        const auto c = q.m_a44 + avv * v0 * v0 + 2 * aw4 * w0 + aww * w0 * w0 + 2 * v0 * (av4 + avw * w0);
+
+        // lanes with a negative discriminant miss. clamping it keeps sqrt free of domain errors, and keeps NaN like getQuadricCollision
+        const auto bbac = b * b - a * c;
+        const auto root = sqrt(bbac < 0 ? 0.0 : bbac);
+        const auto u    = glm::abs(a) > glm::abs(c) * 1e-10 ? (-b + d_sign * root) / a : (-c / 2) / b;
+        const auto v    = v0 + r1 * u;
+        const auto w    = w0 + r2 * u;
+
+        const auto x = cs == 1 ? u : v;
+        const auto y = cs == 2 ? u : (cs == 1 ? v : w);
+        const auto z = cs == 3 ? u : w;
+
+        // intersection point is in the negative direction (behind the position when the direction is followed forwards)
+        const auto behind = ((x - px) / dx < 0) | ((y - py) / dy < 0) | ((z - pz) / dz < 0);
+        cols.hit[lane]    = packet.active[lane] & !(bbac < 0) & !behind;
+
+        const auto fx = 2 * q.m_a14 + 2 * q.m_a11 * x + 2 * q.m_a12 * y + 2 * q.m_a13 * z;
+        const auto fy = 2 * q.m_a24 + 2 * q.m_a12 * x + 2 * q.m_a22 * y + 2 * q.m_a23 * z;
+        const auto fz = 2 * q.m_a34 + 2 * q.m_a13 * x + 2 * q.m_a23 * y + 2 * q.m_a33 * z;
+
+        cols.hitpoint_x[lane] = x;
+        cols.hitpoint_y[lane] = y;
+        cols.hitpoint_z[lane] = z;
+        cols.normal(lane, normalize(glm::dvec3(fx, fy, fz)));
+    }
+}
+
 /**************************************************************
  *                    Cubic collision
  **************************************************************/
-/**
- * taken from RAY-UI Nov. 2023:
- *  new version of Th. Zeschke by Oct. 18, 2007
- *  corresponding exe-version is called ray_thomas1.exe (on VAX only)
- *
- *  calculates intersection of a straight line
- *  equation straight line:
- *  (x-x1)/al = (y-y1)/am = (z-z1)/an
- *  with a surface of 3. order
- *
- *  method: the iterative Newtonmethod is used for zero point search
- *  result is X,Y,Z of intersection
- * Ray in in element koordinates.
- */
+namespace {
+
+// cubic polynomial g3 * s^3 + g2 * s^2 + g1 * s + g0
+struct CubicPolynomial {
+    double g3, g2, g1, g0;
+
+    RAYX_FN_ACC double operator()(const double s) const { return ((g3 * s + g2) * s + g1) * s + g0; }
+    RAYX_FN_ACC double derivative(const double s) const { return (3.0 * g3 * s + 2.0 * g2) * s + g1; }
+};
+
+constexpr int CUBIC_MAX_ITERATIONS = 64;
+constexpr double CUBIC_TOLERANCE   = 1e-12;
+
+// root of the polynomial in [lo, hi], which must have a sign change. newton's method, falling back to bisection whenever a newton step leaves
+// the bracket. starts at the point of the bracket closest to 0
 RAYX_FN_ACC
-OptCollisionPoint getCubicCollision(const glm::dvec3& __restrict rayPosition, const glm::dvec3& __restrict rayDirection,
-                                    const Surface::Cubic& __restrict cu) {
-    // TODO: what is this and do we need it?
-    // Ray r = rotateForCubic(rin, cu.m_psi, 1000);
+double findBracketedRoot(const CubicPolynomial& __restrict p, double lo, double hi) {
+    auto flo = p(lo);
+    auto s   = glm::clamp(0.0, lo, hi);
+
+    for (int i = 0; i < CUBIC_MAX_ITERATIONS; ++i) {
+        const auto f = p(s);
+        if (f == 0.0) return s;
+
+        // shrink the bracket
+        if ((f < 0.0) == (flo < 0.0)) {
+            lo  = s;
+            flo = f;
+        } else {
+            hi = s;
+        }
 
-    int cs = 1;
-    if (glm::abs(rayDirection[1]) >= glm::abs(rayDirection[0]) && glm::abs(rayDirection[1]) >= glm::abs(rayDirection[2])) {
-        cs = 2;
-    } else if (glm::abs(rayDirection[2]) >= glm::abs(rayDirection[0]) && glm::abs(rayDirection[2]) >= glm::abs(rayDirection[1])) {
-        cs = 3;
+        const auto df = p.derivative(s);
+        auto next     = df != 0.0 ? s - f / df : lo;
+        if (!(lo < next && next < hi)) next = 0.5 * (lo + hi);
+
+        if (glm::abs(next - s) <= CUBIC_TOLERANCE * (1.0 + glm::abs(next))) return next;
+        s = next;
     }
+    return s;
+}
 
-    glm::dvec3 pos = cubicPosition(rayPosition, cu.m_psi);
-    double x       = pos.x;
-    double y       = pos.y;
-    double z       = pos.z;
-    double x1      = 0;
-    double xx      = 0;
-    double y1      = 0;
-    double yy      = 0;
-    double z1      = 0;
-    double zz      = 0;
-    double counter = 0;
-    double dx      = 0;
-
-    glm::dvec3 dir = cubicDirection(rayDirection, cu.m_psi);
-    double al      = dir.x;
-    double am      = dir.y;
-    double an      = dir.z;
+// real root of the polynomial closest to 0, if there is one. the real line is split at the extrema of the polynomial into intervals on which the
+// polynomial is monotonic, each of which contains at most one root
+RAYX_FN_ACC
+std::optional<double> findRootClosestToZero(const CubicPolynomial& __restrict p) {
+    // all roots are within the cauchy bound of the polynomial of the actual degree
+    const auto lead = p.g3 != 0.0 ? p.g3 : p.g2 != 0.0 ? p.g2 : p.g1;
+    if (lead == 0.0) return std::nullopt;
+    const auto bound = 1.0 + glm::max(glm::max(glm::abs(p.g2), glm::abs(p.g1)), glm::abs(p.g0)) / glm::abs(lead);
+
+    // extrema, i.e. roots of the derivative 3 * g3 * s^2 + 2 * g2 * s + g1, in ascending order
+    double breaks[4] = {-bound, bound, bound, bound};
+    int numBreaks    = 1;
+    const auto a     = 3.0 * p.g3;
+    const auto b     = 2.0 * p.g2;
+    const auto c     = p.g1;
+    if (a != 0.0) {
+        const auto discriminant = b * b - 4.0 * a * c;
+        if (discriminant > 0.0) {
+            // numerically stable form of the quadratic formula
+            const auto q  = -0.5 * (b + glm::sign(b == 0.0 ? 1.0 : b) * glm::sqrt(discriminant));
+            const auto e0 = q / a;
+            const auto e1 = c / q;
+            breaks[numBreaks++] = glm::clamp(glm::min(e0, e1), -bound, bound);
+            breaks[numBreaks++] = glm::clamp(glm::max(e0, e1), -bound, bound);
+        }
+    } else if (b != 0.0) {
+        breaks[numBreaks++] = glm::clamp(-c / b, -bound, bound);
+    }
+    breaks[numBreaks++] = bound;
 
-    if (cs == 1) {
-        double aml = am / al;
-        double anl = an / al;
-
-        do {
-            x1 = xx;
-            y1 = y - aml * (x - xx);
-            z1 = z - anl * (x - xx);
-
-            double func = (2 * ((x1 - xx) * an - al * z1) * cu.m_a23 - (2 * cu.m_a24 + cu.m_b12 * pow(float(xx), 2.0)) * al +
-                           ((x1 - xx) * am - al * y1) * (cu.m_a22 + cu.m_b21 * xx)) *
-                          ((x1 - xx) * am - al * y1);
-            func = func + pow(float(((x1 - xx) * an - al * z1)), 2.0) * cu.m_a33;
-            func = func - ((x1 - xx) * an - al * z1) * (2 * cu.m_a34 + cu.m_b13 * pow(float(xx), 2.0) * al + cu.m_a44 * pow(float(al), 2.0));
-            func = (func -
-                    (2 * ((x1 - xx) * an - al * z1) * cu.m_a13 - (cu.m_a11 * xx + 2 * cu.m_a14) * al + 2 * ((x1 - xx) * am - al * y1) * cu.m_a12) *
-                        al * xx) *
-                   al;
-            func = (func - (pow(float(((x1 - xx) * am - al * y1)), 2.0) * cu.m_b23 +
-                            ((x1 - xx) * am - al * y1) * ((x1 - xx) * an - al * z1) * cu.m_b32 - ((x1 - xx) * an - al * z1) * al * cu.m_b31 * xx) *
-                               ((x1 - xx) * an - al * z1) / pow(float(al), 3));
-
-            double dfunc = (2 * ((x1 - xx) * an - al * z1) * cu.m_a23 - (2 * cu.m_a24 + cu.m_b12 * pow(float(xx), 2)) * al +
-                            ((x1 - xx) * am - al * y1) * (cu.m_a22 + cu.m_b21 * xx)) *
-                           am;
-            dfunc = dfunc - (2 * (cu.m_a12 * am + cu.m_a13 * an) + cu.m_a11 * al) * al * xx;
-            dfunc =
-                dfunc + (2 * ((x1 - xx) * an - al * z1) * cu.m_a13 - (cu.m_a11 * xx + 2 * cu.m_a14) * al + 2 * ((x1 - xx) * am - al * y1) * cu.m_a12);
-            dfunc =
-                dfunc * al + ((cu.m_a22 + cu.m_b21 * xx) * am + 2 * (cu.m_a23 * an + al * cu.m_b12 * xx) - ((x1 - xx) * am - al * y1) * cu.m_b21) *
-                                 ((x1 - xx) * am - al * y1);
-            dfunc = (dfunc + 2 * ((x1 - xx) * an - al * z1) * (cu.m_a33 * an + al * cu.m_b13 * xx) -
-                     (2 * cu.m_a34 + cu.m_b13 * pow(float(xx), 2)) * al * an) *
-                    al;
-            dfunc = (dfunc - ((((x1 - xx) * an - al * z1) * (al * cu.m_b31 + am * cu.m_b32) - al * an * cu.m_b31 * xx +
-                               ((x1 - xx) * am - al * y1) * (2 * am * cu.m_b23 + an * cu.m_b32)) *
-                                  ((x1 - xx) * an - al * z1) +
-                              (pow(float(((x1 - xx) * am - al * y1)), 2) * cu.m_b23 +
-                               ((x1 - xx) * am - al * y1) * ((x1 - xx) * an - al * z1) * cu.m_b32 - ((x1 - xx) * an - al * z1) * al * cu.m_b31 * xx) *
-                                  an));
-            dfunc = dfunc / pow(float(al), 3);
-
-            if (glm::abs(dfunc) < 0.001) { dfunc = 0.001; }
-
-            dx = func / dfunc;
-            xx = xx - dx;
-
-            x = x1;
-            y = y1;
-            z = z1;
-
-            if (counter > 1000) {
-                x = -2 * y1 / 2 / aml;
-                y = y1 + aml * x;
-                z = z1 + anl * x;
-            }
-            counter++;
-        } while (glm::abs(dx) > 0.001);
-    } else if (cs == 2) {
-        double alm = al / am;
-        double anm = an / am;
-
-        do {
-            x1 = x - alm * (y - yy);
-            y1 = yy;
-            z1 = z - anm * (y - yy);
-
-            double func = (2 * (((y1 - yy) * an - am * z1) * cu.m_a13 - (cu.m_a12 * yy + cu.m_a14) * am) +
-                           ((y1 - yy) * al - am * x1) * (cu.m_a11 + cu.m_b12 * yy)) *
-                          ((y1 - yy) * al - am * x1);
-            func = func + (((y1 - yy) * an - am * z1) * cu.m_a33 - 2 * (cu.m_a23 * yy + cu.m_a34) * am) * ((y1 - yy) * an - am * z1) +
-                   (2 * cu.m_a24 * yy + cu.m_a44 + cu.m_a22 * pow(float(yy), 2) * pow(float(am), 2));
-            func = func * am +
-                   ((((y1 - yy) * an - am * z1) * cu.m_b32 - am * cu.m_b23 * yy) * am * yy - pow(float((y1 - yy) * al - am * x1), 2) * cu.m_b13) *
-                       ((y1 - yy) * an - am * z1);
-            func = func - (pow(float(((y1 - yy) * an - am * z1)), 2) * cu.m_b31 + pow(float(am), 2) * cu.m_b21 * pow(float(yy), 2)) *
-                              ((y1 - yy) * al - am * x1);
-            func = func / pow(float(am), 3);
-
-            double dfunc = (pow(float((y1 - yy) * an - am * z1), 2) * cu.m_b31 + pow(float(am), 2) * cu.m_b21 * pow(float(yy), 2) * al +
-                            2 * (((y1 - yy) * an - am * z1) * an * cu.m_b31 - pow(float(am), 2)) * cu.m_b21 * yy) *
-                           ((y1 - yy) * al - am * x1);
-            dfunc =
-                dfunc -
-                ((((y1 - yy) * an - am * z1) * cu.m_b32 - am * cu.m_b23 * yy) * am * yy - pow(float((y1 - yy) * al - am * x1), 2) * cu.m_b13) * an;
-            dfunc = dfunc + (2 * ((y1 - yy) * al - am * x1) * al * cu.m_b13 - (am * cu.m_b23 + an * cu.m_b32) * am * yy +
-                             (((y1 - yy) * an - am * z1) * cu.m_b32 - am * cu.m_b23 * yy) * am) *
-                                ((y1 - yy) * an - am * z1);
-            dfunc = dfunc - (((cu.m_a11 + cu.m_b12 * yy) * al + 2 * (cu.m_a12 * am + cu.m_a13 * an) - ((y1 - yy) * al - am * x1) * cu.m_b12) *
-                                 ((y1 - yy) * al - am * x1) -
-                             2 * (cu.m_a22 * pow(float(am), 2) * yy + cu.m_a23 * pow(float(am), 2) * z1 - cu.m_a23 * am * an * y1 +
-                                  2 * cu.m_a23 * am * an * yy + cu.m_a24 * pow(float(am), 2) + cu.m_a33 * am * an * z1 -
-                                  cu.m_a33 * pow(float(an), 2) * y1 + cu.m_a33 * pow(float(an), 2) * yy + cu.m_a34 * am * an) +
-                             (2 * (((y1 - yy) * an - am * z1) * cu.m_a13 - (cu.m_a12 * yy + cu.m_a14) * am) +
-                              ((y1 - yy) * al - am * x1) * (cu.m_a11 + cu.m_b12 * yy)) *
-                                 al) *
-                                am;
-            dfunc = dfunc / pow(float(am), 3);
-
-            if (glm::abs(dfunc) < 0.001) { dfunc = 0.001; }
-
-            dx = func / dfunc;
-            yy = yy - dx;
-
-            x = x1;
-            y = y1;
-            z = z1;
-
-            if (counter > 1000) {
-                x = x1;
-                y = 0;
-                z = z1;
-            }
-            counter++;
-        } while (glm::abs(dx) > 0.001);
-    } else {
-        double aln = al / an;
-        double amn = am / an;
-
-        do {
-            x1 = x - aln * (z - zz);
-            y1 = y - amn * (z - zz);
-            z1 = zz;
-
-            double func = ((2 * (((z1 - zz) * am - an * y1) * cu.m_a12 - (cu.m_a13 * zz + cu.m_a14) * an) + ((z1 - zz) * al - an * x1) * cu.m_a11) *
-                               ((z1 - zz) * al - an * x1) +
-                           (((z1 - zz) * am - an * y1) * cu.m_a22 - 2 * (cu.m_a23 * zz + cu.m_a24) * an) * ((z1 - zz) * am - an * y1) +
-                           (2 * cu.m_a34 * zz + cu.m_a44 + cu.m_a33 * pow(float(zz), 2)) * pow(float(an), 2)) *
-                          an;
-            func = func - ((((z1 - zz) * am - an * y1) * cu.m_b12 - an * cu.m_b13 * zz) * pow(float(((z1 - zz) * al - an * x1)), 2) -
-                           (((z1 - zz) * am - an * y1) * cu.m_b23 - an * cu.m_b32 * zz) * ((z1 - zz) * am - an * y1) * an * zz +
-                           (pow(float(((z1 - zz) * am - an * y1)), 2) * cu.m_b21 + pow(float(an), 2) * cu.m_b31 * pow(float(zz), 2)) *
-                               ((z1 - zz) * al - an * x1));
-            func = func / pow(float(an), 3);
-
-            double dfunc = (((z1 - zz) * am - an * y1) * cu.m_a22 - 2 * (cu.m_a23 * zz + cu.m_a24) * an) * am +
-                           (2 * (cu.m_a12 * am + cu.m_a13 * an) + cu.m_a11 * al) * ((z1 - zz) * al - an * x1);
-            dfunc = dfunc + ((z1 - zz) * am - an * y1) * (cu.m_a22 * am + 2 * cu.m_a23 * an) - 2 * (cu.m_a33 * zz + cu.m_a34) * pow(float(an), 2);
-            dfunc = (dfunc +
-                     (2 * (((z1 - zz) * am - an * y1) * cu.m_a12 - (cu.m_a13 * zz + cu.m_a14) * an) + ((z1 - zz) * al - an * x1) * cu.m_a11) * al) *
-                    an;
-            dfunc = dfunc - (2 *
-                                 (((z1 - zz) * am - an * y1) * am * cu.m_b21 - pow(float(an), 2) * cu.m_b31 * zz +
-                                  (((z1 - zz) * am - an * y1) * cu.m_b12 - an * cu.m_b13 * zz) * al) *
-                                 ((z1 - zz) * al - an * x1) +
-                             (pow(float(((z1 - zz) * am - an * y1)), 2) * cu.m_b21 + pow(float(an), 2) * cu.m_b31 * pow(float(zz), 2)) * al +
-                             pow(float(((z1 - zz) * al - an * x1)), 2) * (am * cu.m_b12 + an * cu.m_b13) -
-                             ((z1 - zz) * am - an * y1) * (am * cu.m_b23 + an * cu.m_b32) * an * zz +
-                             (((z1 - zz) * am - an * y1) * cu.m_b23 - an * cu.m_b32 * zz) * (am * z1 - 2 * am * zz - an * y1) * an);
-            dfunc = (-dfunc) / pow(float(an), 3);
-
-            if (glm::abs(dfunc) < 0.001) { dfunc = 0.001; }
-
-            dx = func / dfunc;
-            zz = zz - dx;
-
-            x = x1;
-            y = y1;
-            z = z1;
-
-            if (counter > 1000) {
-                x = x1 + aln * z;
-                y = y1 + amn * z;
-                z = -2 * y1 / 2 / amn;
-            }
-            counter++;
-        } while (glm::abs(dx) > 0.001);
-        // rayPosition = glm::dvec3(a, b, c);
+    auto root = std::optional<double>();
+    for (int i = 0; i + 1 < numBreaks; ++i) {
+        const auto lo = breaks[i];
+        const auto hi = breaks[i + 1];
+        // the interval can not contain a root closer to 0 than the one found so far
+        if (root && glm::min(glm::abs(lo), glm::abs(hi)) > glm::abs(*root) && (lo > 0.0 || hi < 0.0)) continue;
+
+        const auto flo = p(lo);
+        const auto fhi = p(hi);
+        if ((flo < 0.0) == (fhi < 0.0) && flo != 0.0 && fhi != 0.0) continue;
+
+        const auto candidate = findBracketedRoot(p, lo, hi);
+        if (!root || glm::abs(candidate) < glm::abs(*root)) root = candidate;
     }
+    return root;
+}
 
-    // intersection point is in the negative direction (behind the position when the direction is followed forwards), set weight to 0
-    // if ((x - rayPosition.x) / rayDirection.x < 0 || (y - rayPosition.y) / rayDirection.y < 0 || (z - rayPosition.z) / rayDirection.z < 0) {
-    //    col.found = false;
-    //}
+}  // unnamed namespace
+
+/**
+ * intersection of a ray with a surface of 3. order (taken from RAY-UI), given in coordinates rotated by psi around the x axis by
+ *  a11 x^2 + a22 y^2 + a33 z^2 + 2 a12 xy + 2 a13 xz + 2 a23 yz + 2 a14 x + 2 a24 y + 2 a34 z + a44
+ *  + b12 x^2 y + b13 x^2 z + b21 y^2 x + b23 y^2 z + b31 z^2 x + b32 z^2 y = 0
+ *
+ * the equation is reduced to a cubic polynomial in the distance along the ray once per ray, which is solved by a safeguarded newton method
+ * with a fixed iteration cap. like the newton method of RAY-UI, that iterated along the dominant axis of the ray direction starting at the plane
+ * through the origin, the root closest to this plane is chosen. returns no collision, if the ray does not intersect the surface.
+ * Ray in in element koordinates.
+ */
+RAYX_FN_ACC
+OptCollisionPoint getCubicCollision(const glm::dvec3& __restrict rayPosition, const glm::dvec3& __restrict rayDirection,
+                                    const Surface::Cubic& __restrict cu) {
+    const auto pos = cubicPosition(rayPosition, cu.m_psi);
+    const auto dir = cubicDirection(rayDirection, cu.m_psi);
+
+    // the point where the ray crosses the plane through the origin perpendicular to the dominant axis of its direction
+    int cs = 0;
+    if (glm::abs(dir[1]) > glm::abs(dir[cs])) cs = 1;
+    if (glm::abs(dir[2]) > glm::abs(dir[cs])) cs = 2;
+    if (dir[cs] == 0.0) return std::nullopt;
+    const auto start = pos - pos[cs] / dir[cs] * dir;
+
+    // coefficients of the cubic polynomial in s, for the point start + s * dir
+    auto p           = CubicPolynomial{0.0, 0.0, 0.0, 0.0};
+    const auto& q    = start;
+    const auto& d    = dir;
+    const auto quad  = [&](const double k, const int i, const int j) {
+        // k * x_i * x_j
+        p.g0 += k * q[i] * q[j];
+        p.g1 += k * (q[i] * d[j] + d[i] * q[j]);
+        p.g2 += k * d[i] * d[j];
+    };
+    const auto cubic = [&](const double k, const int i, const int j) {
+        // k * x_i^2 * x_j
+        p.g0 += k * q[i] * q[i] * q[j];
+        p.g1 += k * (2.0 * q[i] * d[i] * q[j] + q[i] * q[i] * d[j]);
+        p.g2 += k * (d[i] * d[i] * q[j] + 2.0 * q[i] * d[i] * d[j]);
+        p.g3 += k * d[i] * d[i] * d[j];
+    };
+    quad(cu.m_a11, 0, 0);
+    quad(cu.m_a22, 1, 1);
+    quad(cu.m_a33, 2, 2);
+    quad(2.0 * cu.m_a12, 0, 1);
+    quad(2.0 * cu.m_a13, 0, 2);
+    quad(2.0 * cu.m_a23, 1, 2);
+    p.g0 += 2.0 * (cu.m_a14 * q[0] + cu.m_a24 * q[1] + cu.m_a34 * q[2]) + cu.m_a44;
+    p.g1 += 2.0 * (cu.m_a14 * d[0] + cu.m_a24 * d[1] + cu.m_a34 * d[2]);
+    cubic(cu.m_b12, 0, 1);
+    cubic(cu.m_b13, 0, 2);
+    cubic(cu.m_b21, 1, 0);
+    cubic(cu.m_b23, 1, 2);
+    cubic(cu.m_b31, 2, 0);
+    cubic(cu.m_b32, 2, 1);
+
+    const auto s = findRootClosestToZero(p);
+    if (!s) return std::nullopt;
+
+    const auto x = start.x + *s * dir.x;
+    const auto y = start.y + *s * dir.y;
+    const auto z = start.z + *s * dir.z;
 
     double fx = 2 * cu.m_a14 + 2 * cu.m_a11 * x + 2 * cu.m_a12 * y + 2 * cu.m_a13 * z;
     double fy = 2 * cu.m_a24 + 2 * cu.m_a12 * x + 2 * cu.m_a22 * y + 2 * cu.m_a23 * z;
@@ -367,31 +398,36 @@ OptCollisionPoint getCubicCollision(const glm::dvec3& __restrict rayPosition, co
 /**************************************************************
  *                    Toroid Collision
  **************************************************************/
-// this uses newton to approximate a solution.
+namespace {
+
+// convergence tolerance of the newton steps in z, same as RAY-UI for all solvers
+constexpr double TOROID_NEWTON_TOLERANCE = 1e-4;
+constexpr int TOROID_MAX_ITERATIONS      = 50;
+
+// signed short radius: positive = concave, negative = convex
 RAYX_FN_ACC
-OptCollisionPoint getToroidCollision(const glm::dvec3& __restrict rayPosition, const glm::dvec3& __restrict rayDirection,
-                                     const Surface::Toroid& __restrict toroid, bool isTriangul) {
-    // Constants
-    const double NEW_TOLERANCE   = 0.0001;
-    const int NEW_MAX_ITERATIONS = 50;
+double toroidShortRadius(const Surface::Toroid& __restrict toroid) {
+    return (toroid.m_toroidType == ToroidType::Convex) ? -toroid.m_shortRadius : toroid.m_shortRadius;
+}
 
+// newton's method on the toroid equation, with the z coordinate along the ray as parameter, starting at zStart. this is the method of RAY-UI
+RAYX_FN_ACC
+OptCollisionPoint solveToroidNewton(const glm::dvec3& __restrict rayPosition, const glm::dvec3& __restrict rayDirection,
+                                    const Surface::Toroid& __restrict toroid, bool isTriangul, double zStart, int& __restrict numIterations) {
     double longRad  = toroid.m_longRadius;
-    double shortRad = (toroid.m_toroidType == ToroidType::Convex) ? -toroid.m_shortRadius : toroid.m_shortRadius;
+    double shortRad = toroidShortRadius(toroid);
 
     // sign radius: +1 = concave, -1 = convex
     double isigro = glm::sign(shortRad);
 
-    // double aln = rayDirection.x / rayDirection.z;
-    // double amn = rayDirection.y / rayDirection.z;
-
     glm::dvec4 normal         = glm::dvec4(0, 0, 0, 0);
     double xx                 = 0.0;
-    double zz                 = 0.0;
+    double zz                 = zStart;
     double yy                 = 0.0;
     double dz                 = 0.0;
     glm::dvec3 normalized_dir = glm::dvec3(rayDirection) / rayDirection.z;
 
-    int n = 0;
+    numIterations = 0;
     // Newton's method iteration
     // While not converged...
     do {
@@ -410,9 +446,9 @@ OptCollisionPoint getToroidCollision(const glm::dvec3& __restrict rayPosition, c
         double func = -rx * rx + (yy - longRad) * (yy - longRad) + zz * zz;
         double df   = normalized_dir.x * normal.x + normalized_dir.y * normal.y + normal.z;  // dot(normalized_dir, glm::dvec3(normal));
         dz          = func / df;
-        n += 1;
-        if (n >= NEW_MAX_ITERATIONS) { return std::nullopt; }
-    } while (glm::abs(dz) > NEW_TOLERANCE);
+        numIterations += 1;
+        if (numIterations >= TOROID_MAX_ITERATIONS) { return std::nullopt; }
+    } while (glm::abs(dz) > TOROID_NEWTON_TOLERANCE);
 
     CollisionPoint col;
     col.normal   = normalize(glm::dvec3(normal));
@@ -431,6 +467,169 @@ OptCollisionPoint getToroidCollision(const glm::dvec3& __restrict rayPosition, c
     return col;
 }
 
+// z coordinate of the intersection with the osculating quadric of the toroid at the origin, (longRad / shortRad) x^2 + y^2 + z^2 - 2 longRad y = 0.
+// it has the same principal radii (short radius along x, long radius along z) and differs from the toroid only in 4. order. the quadric is
+// intersected directly in the parametrization of the newton method, instead of by getQuadricCollision. of the two intersections, the one
+// closer to z = 0 is chosen. falls back to the start of RAY-UI, z = 0, if the ray misses the quadric
+RAYX_FN_ACC
+double getToroidNewtonStart(const glm::dvec3& __restrict rayPosition, const glm::dvec3& __restrict rayDirection,
+                            const Surface::Toroid& __restrict toroid) {
+    const auto longRad = toroid.m_longRadius;
+    const auto a11     = longRad / toroidShortRadius(toroid);
+
+    // ray parametrized by z: x = x0 + z * nx, y = y0 + z * ny
+    const auto nx = rayDirection.x / rayDirection.z;
+    const auto ny = rayDirection.y / rayDirection.z;
+    const auto x0 = rayPosition.x - rayPosition.z * nx;
+    const auto y0 = rayPosition.y - rayPosition.z * ny;
+
+    // a z^2 + 2 b z + c = 0
+    const auto a = a11 * nx * nx + ny * ny + 1.0;
+    const auto b = a11 * x0 * nx + (y0 - longRad) * ny;
+    const auto c = a11 * x0 * x0 + y0 * (y0 - 2.0 * longRad);
+
+    const auto discriminant = b * b - a * c;
+    if (discriminant < 0.0) return 0.0;
+    // numerically stable form of the root with the smaller absolute value
+    const auto q = b + (b < 0.0 ? -1.0 : 1.0) * glm::sqrt(discriminant);
+    return q != 0.0 ? -c / q : 0.0;
+}
+
+// largest real root of the cubic x^3 + a x^2 + b x + c
+RAYX_FN_ACC
+double largestCubicRoot(const double a, const double b, const double c) {
+    // depressed cubic y^3 + p y + q with x = y - a / 3
+    const auto p = b - a * a / 3.0;
+    const auto q = 2.0 * a * a * a / 27.0 - a * b / 3.0 + c;
+
+    const auto discriminant = q * q / 4.0 + p * p * p / 27.0;
+    double y;
+    if (discriminant > 0.0) {
+        const auto sq = glm::sqrt(discriminant);
+        y             = cbrt(-q / 2.0 + sq) + cbrt(-q / 2.0 - sq);
+    } else {
+        // three real roots, trigonometric form. p <= 0 here
+        const auto r = glm::sqrt(-p / 3.0);
+        y            = r > 0.0 ? 2.0 * r * glm::cos(glm::acos(glm::clamp(-q / (2.0 * r * r * r), -1.0, 1.0)) / 3.0) : 0.0;
+    }
+
+    // one newton step against cancellation in the formulas above
+    auto x        = y - a / 3.0;
+    const auto dx = 3.0 * x * x + 2.0 * a * x + b;
+    if (dx != 0.0) x -= (((x + a) * x + b) * x + c) / dx;
+    return x;
+}
+
+// real roots of x^2 + b x + c. returns the number of roots
+RAYX_FN_ACC
+int solveMonicQuadratic(const double b, const double c, double* __restrict roots) {
+    const auto discriminant = b * b - 4.0 * c;
+    if (discriminant < 0.0) return 0;
+    // numerically stable form of the quadratic formula
+    const auto q = -0.5 * (b + (b < 0.0 ? -1.0 : 1.0) * glm::sqrt(discriminant));
+    roots[0]     = q;
+    roots[1]     = q != 0.0 ? c / q : 0.0;
+    return 2;
+}
+
+// z coordinate of the intersection of the ray with the toroid, by ferrari's closed form solution of the quartic torus equation.
+// of all real roots on the sheet of the toroid through the origin, the one closest to z = 0 is chosen, like the newton method of RAY-UI would
+RAYX_FN_ACC
+std::optional<double> solveToroidQuartic(const glm::dvec3& __restrict rayPosition, const glm::dvec3& __restrict rayDirection,
+                                         const Surface::Toroid& __restrict toroid) {
+    // the toroid is the torus around the axis (x, longRad, 0) with the radius c of the tube center and the tube radius |shortRad|
+    const auto longRad  = toroid.m_longRadius;
+    const auto shortRad = toroidShortRadius(toroid);
+    const auto c        = longRad - shortRad;
+    const auto k        = c * c - shortRad * shortRad;
+
+    // ray parametrized by z, relative to the axis: q + z * d
+    const auto d = rayDirection / rayDirection.z;
+    const auto q = rayPosition - rayPosition.z * d - glm::dvec3(0, longRad, 0);
+
+    // (|q + z d|^2 + k)^2 = 4 c^2 ((q.y + z d.y)^2 + (q.z + z d.z)^2)
+    const auto sa = dot(d, d);
+    const auto sb = 2.0 * dot(q, d);
+    const auto sc = dot(q, q);
+    const auto ra = d.y * d.y + d.z * d.z;
+    const auto rb = 2.0 * (q.y * d.y + q.z * d.z);
+    const auto rc = q.y * q.y + q.z * q.z;
+
+    const auto c4 = sa * sa;
+    const auto c3 = (2.0 * sa * sb) / c4;
+    const auto c2 = (sb * sb + 2.0 * sa * (sc + k) - 4.0 * c * c * ra) / c4;
+    const auto c1 = (2.0 * sb * (sc + k) - 4.0 * c * c * rb) / c4;
+    const auto c0 = ((sc + k) * (sc + k) - 4.0 * c * c * rc) / c4;
+
+    // depressed quartic y^4 + p y^2 + r1 y + r0 with z = y - c3 / 4
+    const auto shift = c3 / 4.0;
+    const auto p     = c2 - 6.0 * shift * shift;
+    const auto r1    = c1 - 2.0 * c2 * shift + 8.0 * shift * shift * shift;
+    const auto r0    = c0 - c1 * shift + c2 * shift * shift - 3.0 * shift * shift * shift * shift;
+
+    double roots[4];
+    int numRoots = 0;
+    if (r1 == 0.0) {
+        // biquadratic
+        double squares[2];
+        const auto numSquares = solveMonicQuadratic(p, r0, squares);
+        for (int i = 0; i < numSquares; ++i) {
+            if (squares[i] < 0.0) continue;
+            roots[numRoots++] = glm::sqrt(squares[i]);
+            roots[numRoots++] = -glm::sqrt(squares[i]);
+        }
+    } else {
+        // (y^2 + p / 2 + m)^2 = 2 m (y - r1 / (4 m))^2 for a positive root m of the resolvent cubic
+        const auto m = largestCubicRoot(p, p * p / 4.0 - r0, -r1 * r1 / 8.0);
+        if (m <= 0.0) return std::nullopt;
+        const auto s = glm::sqrt(2.0 * m);
+        numRoots += solveMonicQuadratic(-s, p / 2.0 + m + r1 / (2.0 * s), roots + numRoots);
+        numRoots += solveMonicQuadratic(s, p / 2.0 + m - r1 / (2.0 * s), roots + numRoots);
+    }
+
+    auto z = std::optional<double>();
+    for (int i = 0; i < numRoots; ++i) {
+        const auto root = roots[i] - shift;
+        const auto hit  = q + root * d;
+        // the sheet through the origin: on the side of the axis of the origin, and on the side of the tube center of the origin
+        if (hit.y * longRad > 0.0) continue;
+        if ((glm::sqrt(hit.y * hit.y + hit.z * hit.z) - c) * shortRad < 0.0) continue;
+        if (!z || glm::abs(root) < glm::abs(*z)) z = root;
+    }
+    return z;
+}
+
+}  // unnamed namespace
+
+RAYX_FN_ACC
+OptCollisionPoint getToroidCollision(const glm::dvec3& __restrict rayPosition, const glm::dvec3& __restrict rayDirection,
+                                     const Surface::Toroid& __restrict toroid, bool isTriangul, int& __restrict numIterations) {
+    switch (toroid.m_solver) {
+        case ToroidSolver::SeededNewton: {
+            const auto zStart = getToroidNewtonStart(rayPosition, rayDirection, toroid);
+            return solveToroidNewton(rayPosition, rayDirection, toroid, isTriangul, zStart, numIterations);
+        }
+        case ToroidSolver::Quartic: {
+            // the closed form loses precision for large radii, the newton steps polish its root
+            const auto zStart = solveToroidQuartic(rayPosition, rayDirection, toroid);
+            if (!zStart) {
+                numIterations = 0;
+                return std::nullopt;
+            }
+            return solveToroidNewton(rayPosition, rayDirection, toroid, isTriangul, *zStart, numIterations);
+        }
+        default:
+            return solveToroidNewton(rayPosition, rayDirection, toroid, isTriangul, 0.0, numIterations);
+    }
+}
+
+RAYX_FN_ACC
+OptCollisionPoint getToroidCollision(const glm::dvec3& __restrict rayPosition, const glm::dvec3& __restrict rayDirection,
+                                     const Surface::Toroid& __restrict toroid, bool isTriangul) {
+    int numIterations;
+    return getToroidCollision(rayPosition, rayDirection, toroid, isTriangul, numIterations);
+}
+
 RAYX_FN_ACC
 OptCollisionPoint getPlaneCollision(const glm::dvec3& __restrict rayPosition, const glm::dvec3& __restrict rayDirection) {
     // the `time` that it takes for the ray to hit the plane (if we understand the rays direction as its velocity).
@@ -450,6 +649,23 @@ OptCollisionPoint getPlaneCollision(const glm::dvec3& __restrict rayPosition, co
     return col;
 }
 
+RAYX_FN_ACC
+void getPlaneCollisions(const RayPacket& __restrict packet, PacketCollisions& __restrict cols) {
+    RAYX_SIMD_LOOP
+    for (int lane = 0; lane < RAY_PACKET_SIZE; ++lane) {
+        // see getPlaneCollision
+        const auto time = -packet.position_y[lane] / packet.direction_y[lane];
+
+        cols.hit[lane]        = packet.active[lane] & !(time < 0);
+        cols.hitpoint_x[lane] = packet.position_x[lane] + packet.direction_x[lane] * time;
+        cols.hitpoint_y[lane] = 0;
+        cols.hitpoint_z[lane] = packet.position_z[lane] + packet.direction_z[lane] * time;
+        cols.normal_x[lane]   = 0;
+        cols.normal_y[lane]   = -glm::sign(packet.direction_y[lane]);
+        cols.normal_z[lane]   = 0;
+    }
+}
+
 /**************************************************************
  *                    Collision Finder
  **************************************************************/
@@ -503,10 +719,47 @@ OptCollisionPoint findCollisionInElementCoords(const glm::dvec3& __restrict rayP
     return col;
 }
 
+RAYX_FN_ACC
+void findCollisionsInElementCoords(const RayPacket& __restrict packet, const OpticalElement& __restrict element, detail::Ray* __restrict rays,
+                                   PacketCollisions& __restrict cols) {
+    const auto& surface = element.m_surface;
+
+    if (surface.is<Surface::Plane>() || surface.is<Surface::Quadric>()) {
+        if (surface.is<Surface::Plane>())
+            getPlaneCollisions(packet, cols);
+        else
+            getQuadricCollisions(packet, surface.get<Surface::Quadric>(), cols);
+
+        // the same steps as findCollisionInElementCoordsWithoutSlopeError: apply the cutout in the XZ plane, and flip the normals against the
+        // directions of the rays
+        for (int lane = 0; lane < RAY_PACKET_SIZE; ++lane)
+            if (cols.hit[lane]) cols.hit[lane] = inCutout(element.m_cutout, cols.hitpoint_x[lane], cols.hitpoint_z[lane]);
+
+        RAYX_SIMD_LOOP
+        for (int lane = 0; lane < RAY_PACKET_SIZE; ++lane) {
+            const auto normal = cols.normal(lane);
+            cols.normal(lane, normal * (dot(packet.direction(lane), normal) > 0.0 ? -1.0 : 1.0));
+        }
+    } else {
+        // cubics and toroids are solved iteratively. their lanes diverge too much to share SIMD instructions
+        for (int lane = 0; lane < RAY_PACKET_SIZE; ++lane) {
+            const auto col = packet.active[lane] ? findCollisionInElementCoordsWithoutSlopeError(packet.position(lane), packet.direction(lane),
+                                                                                                 surface, element.m_cutout, false)
+                                                 : std::nullopt;
+            cols.hit[lane] = col.has_value();
+            if (col) cols.collision(lane, *col);
+        }
+    }
+
+    // slope errors draw random numbers, which only lanes that hit may consume
+    for (int lane = 0; lane < RAY_PACKET_SIZE; ++lane)
+        if (cols.hit[lane]) cols.normal(lane, applySlopeError(cols.normal(lane), element.m_slopeError, 0, rays[lane].rand));
+}
+
 RAYX_FN_ACC
 OptCollisionWithElement findCollisionWithElements(glm::dvec3 rayPosition, glm::dvec3 rayDirection, const OpticalElement* __restrict elements,
-                                                  const ObjectTransform* __restrict objectTransforms, const int numSources, const int numElements,
-                                                  Rand& __restrict rand) {
+                                                  const AffineObjectTransform* __restrict objectTransforms, const ElementBvhNode* __restrict bvhNodes,
+                                                  const int numBvhNodes, const int numSources, const int numElements, Rand& __restrict rand) {
     // global coordinates of first intersection point of ray among all elements in beamline
     OptCollisionPoint best_col = std::nullopt;
 
@@ -521,16 +774,19 @@ OptCollisionWithElement findCollisionWithElements(glm::dvec3 rayPosition, glm::d
     // -> prevents self-intersection.
     rayPosition += rayDirection * COLLISION_EPSILON;
 
-    // Find intersection point through all elements
-    for (int elementIndex = 0; elementIndex < numElements; ++elementIndex) {
+    // elements must be tested in ascending index order, because the slope error of each collision consumes random numbers
+    const auto testElement = [&](const int elementIndex) {
         const auto& element = elements[elementIndex];
 
-        rayMatrixMult(objectTransforms[elementIndex + numSources].m_inTrans, rayPosition, rayDirection);
+        // transform a copy of the ray, so that the ray in world coordinates is the same for every element, no matter which elements were culled
+        auto elementRayPosition  = rayPosition;
+        auto elementRayDirection = rayDirection;
+        rayMatrixMult(objectTransforms[elementIndex + numSources].m_inTrans, elementRayPosition, elementRayDirection);
 
-        const auto current_col = findCollisionInElementCoords(rayPosition, rayDirection, element, rand);
+        const auto current_col = findCollisionInElementCoords(elementRayPosition, elementRayDirection, element, rand);
         if (current_col) {
             // calculate distance from ray start to intersection point. doing this in element coordinates is totally fine.
-            const auto current_dist = glm::length(current_col->hitpoint - rayPosition);
+            const auto current_dist = glm::length(current_col->hitpoint - elementRayPosition);
 
             if (current_dist < best_dist) {
                 best_col     = current_col;
@@ -538,8 +794,26 @@ OptCollisionWithElement findCollisionWithElements(glm::dvec3 rayPosition, glm::d
                 best_element = elementIndex;
             }
         }
+    };
 
-        rayMatrixMult(objectTransforms[elementIndex + numSources].m_outTrans, rayPosition, rayDirection);
+    if (bvhNodes) {
+        // stackless traversal of the bounding volume hierarchy. leafs are visited in ascending order of element indices
+        auto nodeIndex = 0;
+        while (nodeIndex < numBvhNodes) {
+            const auto& node = bvhNodes[nodeIndex];
+
+            if (!rayIntersectsBounds(rayPosition, rayDirection, node.boundsMin, node.boundsMax)) {
+                nodeIndex = node.skipIndex;
+            } else if (node.isLeaf) {
+                for (int elementIndex = node.elementBegin; elementIndex < node.elementEnd; ++elementIndex) testElement(elementIndex);
+                nodeIndex = node.skipIndex;
+            } else {
+                ++nodeIndex;
+            }
+        }
+    } else {
+        // Find intersection point through all elements
+        for (int elementIndex = 0; elementIndex < numElements; ++elementIndex) testElement(elementIndex);
     }
 
     if (!best_col) return std::nullopt;
@@ -4,9 +4,11 @@
 
 #include "Core.h"
 #include "Element/Cutout.h"
+#include "Element/ElementBvh.h"
 #include "InvocationState.h"
 #include "Rand.h"
 #include "Ray.h"
+#include "RayPacket.h"
 
 namespace rayx {
 
@@ -17,6 +19,33 @@ struct RAYX_API CollisionPoint {
 static_assert(std::is_trivially_copyable_v<CollisionPoint>);
 using OptCollisionPoint = std::optional<CollisionPoint>;
 
+/// collisions of a packet of rays, one SIMD lane per ray. hitpoints and normals of lanes that did not hit are undefined
+struct PacketCollisions {
+    alignas(64) double hitpoint_x[RAY_PACKET_SIZE];
+    alignas(64) double hitpoint_y[RAY_PACKET_SIZE];
+    alignas(64) double hitpoint_z[RAY_PACKET_SIZE];
+    alignas(64) double normal_x[RAY_PACKET_SIZE];
+    alignas(64) double normal_y[RAY_PACKET_SIZE];
+    alignas(64) double normal_z[RAY_PACKET_SIZE];
+    bool hit[RAY_PACKET_SIZE];
+
+    RAYX_FN_ACC glm::dvec3 hitpoint(const int lane) const { return glm::dvec3(hitpoint_x[lane], hitpoint_y[lane], hitpoint_z[lane]); }
+    RAYX_FN_ACC glm::dvec3 normal(const int lane) const { return glm::dvec3(normal_x[lane], normal_y[lane], normal_z[lane]); }
+    RAYX_FN_ACC void normal(const int lane, const glm::dvec3 normal) {
+        normal_x[lane] = normal.x;
+        normal_y[lane] = normal.y;
+        normal_z[lane] = normal.z;
+    }
+
+    RAYX_FN_ACC CollisionPoint collision(const int lane) const { return {.hitpoint = hitpoint(lane), .normal = normal(lane)}; }
+    RAYX_FN_ACC void collision(const int lane, const CollisionPoint& col) {
+        hitpoint_x[lane] = col.hitpoint.x;
+        hitpoint_y[lane] = col.hitpoint.y;
+        hitpoint_z[lane] = col.hitpoint.z;
+        normal(lane, col.normal);
+    }
+};
+
 struct CollisionWithElement {
     CollisionPoint point;
     int elementIndex;
@@ -24,15 +53,30 @@ struct CollisionWithElement {
 static_assert(std::is_trivially_copyable_v<CollisionWithElement>);
 using OptCollisionWithElement = std::optional<CollisionWithElement>;
 
-RAYX_FN_ACC OptCollisionPoint getQuadricCollision(const glm::dvec3& __restrict rayPosition, const glm::dvec3& __restrict rayDirection,
-                                                  const Surface::Quadric& __restrict quadric);
+RAYX_FN_ACC OptCollisionPoint RAYX_API getPlaneCollision(const glm::dvec3& __restrict rayPosition, const glm::dvec3& __restrict rayDirection);
+
+RAYX_FN_ACC OptCollisionPoint RAYX_API getQuadricCollision(const glm::dvec3& __restrict rayPosition, const glm::dvec3& __restrict rayDirection,
+                                                           const Surface::Quadric& __restrict quadric);
 
-RAYX_FN_ACC OptCollisionPoint getCubicCollision(const glm::dvec3& __restrict rayPosition, const glm::dvec3& __restrict rayDirection,
-                                                const Surface::Cubic& __restrict cu);
+/// getPlaneCollision for all lanes of a packet, without branches. lanes that are not active do not hit.
+/// the results are bitwise identical to getPlaneCollision
+RAYX_FN_ACC void RAYX_API getPlaneCollisions(const RayPacket& __restrict packet, PacketCollisions& __restrict cols);
+
+/// getQuadricCollision for all lanes of a packet, without branches. lanes that are not active do not hit.
+/// the results are bitwise identical to getQuadricCollision
+RAYX_FN_ACC void RAYX_API getQuadricCollisions(const RayPacket& __restrict packet, const Surface::Quadric& __restrict quadric,
+                                               PacketCollisions& __restrict cols);
+
+RAYX_FN_ACC OptCollisionPoint RAYX_API getCubicCollision(const glm::dvec3& __restrict rayPosition, const glm::dvec3& __restrict rayDirection,
+                                                         const Surface::Cubic& __restrict cu);
 
 RAYX_FN_ACC OptCollisionPoint getToroidCollision(const glm::dvec3& __restrict rayPosition, const glm::dvec3& __restrict rayDirection,
                                                  const Surface::Toroid& __restrict toroid, bool isTriangul);
 
+/// getToroidCollision, that additionally sets `numIterations` to the number of newton steps taken
+RAYX_FN_ACC OptCollisionPoint RAYX_API getToroidCollision(const glm::dvec3& __restrict rayPosition, const glm::dvec3& __restrict rayDirection,
+                                                          const Surface::Toroid& __restrict toroid, bool isTriangul, int& __restrict numIterations);
+
 RAYX_FN_ACC OptCollisionPoint RAYX_API findCollisionInElementCoordsWithoutSlopeError(const glm::dvec3& __restrict rayPosition,
                                                                                      const glm::dvec3& __restrict rayDirection,
                                                                                      const Surface& __restrict surface,
@@ -41,8 +85,17 @@ RAYX_FN_ACC OptCollisionPoint RAYX_API findCollisionInElementCoordsWithoutSlopeE
 RAYX_FN_ACC OptCollisionPoint findCollisionInElementCoords(const glm::dvec3& __restrict rayPosition, const glm::dvec3& __restrict rayDirection,
                                                            const OpticalElement& __restrict element, Rand& __restrict rand);
 
+/// findCollisionInElementCoords for all active lanes of a packet. planes and quadrics are intersected in SIMD lanes, other surfaces lane by lane.
+/// slope errors draw random numbers from the lanes of `rays`
+RAYX_FN_ACC void findCollisionsInElementCoords(const RayPacket& __restrict packet, const OpticalElement& __restrict element,
+                                               detail::Ray* __restrict rays, PacketCollisions& __restrict cols);
+
+/// finds the closest collision of the ray (in world coordinates) among all elements.
+/// if `bvhNodes` is given, elements whose bounds can not be reached by the ray are culled. otherwise all elements are tested (brute-force).
+/// both yield bitwise identical results
 RAYX_FN_ACC OptCollisionWithElement findCollisionWithElements(glm::dvec3 rayPosition, glm::dvec3 rayDirection,
-                                                              const OpticalElement* __restrict elements, const ObjectTransform* __restrict,
+                                                              const OpticalElement* __restrict elements, const AffineObjectTransform* __restrict,
+                                                              const ElementBvhNode* __restrict bvhNodes, const int numBvhNodes,
                                                               const int numSources, const int numElements, Rand& __restrict rand);
 
 }  // namespace rayx
@@ -9,7 +9,7 @@ glm::dvec3 RAYX_API cubicPosition(const glm::dvec3& __restrict rayPosition, doub
     double y  = yy * glm::cos(alpha) - rayPosition[2] * glm::sin(alpha);
     double z  = (rayPosition[2]) * glm::cos(alpha) + yy * glm::sin(alpha);
 
-    return glm::dvec3(0, y, z);
+    return glm::dvec3(rayPosition[0], y, z);
 }
 
 // rotates for the cubic collision by angle alpha (taken from RAY-UI)
@@ -19,7 +19,7 @@ glm::dvec3 RAYX_API cubicDirection(const glm::dvec3& __restrict rayDirection, do
     double dy = rayDirection[1] * glm::cos(alpha) - rayDirection[2] * glm::sin(alpha);
     double dz = rayDirection[2] * glm::cos(alpha) + am * glm::sin(alpha);
 
-    return glm::dvec3(0, dy, dz);
+    return glm::dvec3(rayDirection[0], dy, dz);
 }
 
 }  // namespace rayx
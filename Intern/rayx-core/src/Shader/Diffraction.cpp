@@ -1,7 +1,10 @@
 #include "Diffraction.h"
 
+#include <cmath>
+
 #include "Approx.h"
 #include "Constants.h"
+#include "InverseCdf.h"
 #include "Rand.h"
 
 namespace rayx {
@@ -98,4 +101,101 @@ void fraun_diff(double dim, double wl, double& __restrict dAngle, Rand& __restri
     }
 }
 
+namespace {
+
+// number of nodes, at which the densities are evaluated to build the diffraction table
+constexpr int DIFFRACTION_RECT_NUM_NODES   = 8192;
+constexpr int DIFFRACTION_CIRCLE_NUM_NODES = 1024;
+
+// maximum diffraction angle, in units of wavelength / slit opening. see fraun_diff and bessel_diff
+constexpr double DIFFRACTION_MAX_ANGLE = 5.0;
+
+std::vector<double> calcDiffractionTable() {
+    auto table = std::vector<double>(DIFFRACTION_TABLE_SIZE);
+
+    // rectangular
+    {
+        auto nodes   = std::vector<double>(DIFFRACTION_RECT_NUM_NODES);
+        auto density = std::vector<double>(DIFFRACTION_RECT_NUM_NODES);
+        for (int i = 0; i < DIFFRACTION_RECT_NUM_NODES; ++i) {
+            nodes[i]     = -DIFFRACTION_MAX_ANGLE + 2.0 * DIFFRACTION_MAX_ANGLE * i / (DIFFRACTION_RECT_NUM_NODES - 1);
+            const auto u = PI * nodes[i];
+            density[i]   = u != 0 ? std::pow(std::sin(u) / u, 2) : 1.0;
+        }
+        calcInverseCdf(nodes, density, DIFFRACTION_RECT_NUM_QUANTILES, table.data() + DIFFRACTION_RECT_OFFSET);
+    }
+
+    // circular. the density only depends on the radius, so it is tabulated over the radius first, because bessel1 is expensive
+    {
+        constexpr int numRadii = 16 * DIFFRACTION_CIRCLE_NUM_NODES;
+        const auto maxRadius   = DIFFRACTION_MAX_ANGLE * std::sqrt(2.0);
+        auto radialDensity     = std::vector<double>(numRadii);
+        for (int i = 0; i < numRadii; ++i) {
+            const auto xi    = std::sqrt(0.5) * maxRadius * i / (numRadii - 1);
+            const auto u     = 2.0 * PI * xi;
+            radialDensity[i] = u != 0 ? std::pow(2.0 * bessel1(u) / u, 2) : 1.0;
+        }
+        const auto density = [&](const double a, const double c) {
+            const auto x = std::sqrt(a * a + c * c) / maxRadius * (numRadii - 1);
+            const auto i = std::min(static_cast<int>(x), numRadii - 2);
+            return radialDensity[i] + (x - i) * (radialDensity[i + 1] - radialDensity[i]);
+        };
+
+        auto nodes = std::vector<double>(DIFFRACTION_CIRCLE_NUM_NODES);
+        for (int j = 0; j < DIFFRACTION_CIRCLE_NUM_NODES; ++j) nodes[j] = DIFFRACTION_MAX_ANGLE * j / (DIFFRACTION_CIRCLE_NUM_NODES - 1);
+
+        // conditional distribution of the second angle per row, and the marginal density of the first angle at the rows
+        auto rows            = std::vector<double>(DIFFRACTION_CIRCLE_NUM_ROWS);
+        auto marginalDensity = std::vector<double>(DIFFRACTION_CIRCLE_NUM_ROWS);
+        auto rowDensity      = std::vector<double>(DIFFRACTION_CIRCLE_NUM_NODES);
+        for (int r = 0; r < DIFFRACTION_CIRCLE_NUM_ROWS; ++r) {
+            rows[r] = DIFFRACTION_MAX_ANGLE * r / (DIFFRACTION_CIRCLE_NUM_ROWS - 1);
+            for (int j = 0; j < DIFFRACTION_CIRCLE_NUM_NODES; ++j) rowDensity[j] = density(rows[r], nodes[j]);
+            for (int j = 1; j < DIFFRACTION_CIRCLE_NUM_NODES; ++j)
+                marginalDensity[r] += 0.5 * (rowDensity[j - 1] + rowDensity[j]) * (nodes[j] - nodes[j - 1]);
+            calcInverseCdf(nodes, rowDensity, DIFFRACTION_CIRCLE_NUM_QUANTILES,
+                           table.data() + DIFFRACTION_CIRCLE_CONDITIONAL_OFFSET + r * DIFFRACTION_CIRCLE_NUM_QUANTILES);
+        }
+        calcInverseCdf(rows, marginalDensity, DIFFRACTION_CIRCLE_NUM_QUANTILES, table.data() + DIFFRACTION_CIRCLE_MARGINAL_OFFSET);
+    }
+
+    return table;
+}
+
+}  // unnamed namespace
+
+const std::vector<double>& getDiffractionTable() {
+    static const auto table = calcDiffractionTable();
+    return table;
+}
+
+RAYX_FN_ACC
+void bessel_diff_tabulated(double radius, double wl, double& __restrict dphi, double& __restrict dpsi, Rand& __restrict rand,
+                           const double* __restrict diffractionTable) {
+    const auto scale = wl / (glm::abs(radius) * 1e06);
+
+    // first angle from its marginal distribution, second angle from the conditional distributions of the neighbouring rows, interpolated
+    const auto a   = sampleQuantiles(diffractionTable + DIFFRACTION_CIRCLE_MARGINAL_OFFSET, DIFFRACTION_CIRCLE_NUM_QUANTILES, rand.randomDouble());
+    const auto r   = a / DIFFRACTION_MAX_ANGLE * (DIFFRACTION_CIRCLE_NUM_ROWS - 1);
+    const auto row = glm::clamp(static_cast<int>(r), 0, DIFFRACTION_CIRCLE_NUM_ROWS - 2);
+    const auto t   = r - row;
+
+    const auto u     = rand.randomDouble();
+    const auto* rows = diffractionTable + DIFFRACTION_CIRCLE_CONDITIONAL_OFFSET + row * DIFFRACTION_CIRCLE_NUM_QUANTILES;
+    const auto c0    = sampleQuantiles(rows, DIFFRACTION_CIRCLE_NUM_QUANTILES, u);
+    const auto c1    = sampleQuantiles(rows + DIFFRACTION_CIRCLE_NUM_QUANTILES, DIFFRACTION_CIRCLE_NUM_QUANTILES, u);
+    const auto c     = c0 + t * (c1 - c0);
+
+    // 50% neg/pos sign
+    dphi = glm::sign(rand.randomDouble() - 0.5) * a * scale;
+    dpsi = glm::sign(rand.randomDouble() - 0.5) * c * scale;
+}
+
+RAYX_FN_ACC
+void fraun_diff_tabulated(double dim, double wl, double& __restrict dAngle, Rand& __restrict rand, const double* __restrict diffractionTable) {
+    if (dim == 0) return;  // no diffraction in this direction
+    const auto x = sampleQuantiles(diffractionTable + DIFFRACTION_RECT_OFFSET, DIFFRACTION_RECT_NUM_QUANTILES, rand.randomDouble());
+    dAngle       = x * wl / (dim * 1e06);
+}
+
 }  // namespace rayx
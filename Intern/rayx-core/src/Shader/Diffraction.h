@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include "Core.h"
 #include "InvocationState.h"
 
@@ -33,4 +35,31 @@ RAYX_FN_ACC void bessel_diff(double radius, double wl, double& dphi, double& dps
  */
 RAYX_FN_ACC void fraun_diff(double dim, double wl, double& dAngle, Rand& rand);
 
+/**
+ * Layout of the diffraction table, which holds the tabulated inverse cumulative distribution functions of the diffraction angles sampled by
+ * fraun_diff and bessel_diff. The angles are tabulated in units of wavelength / slit opening. Apart from this scaling, the intensity profiles
+ * do not depend on wavelength and slit opening, so a single table serves all slits.
+ *   rectangular: DIFFRACTION_RECT_NUM_QUANTILES angles in [-5, 5], distributed according to (sin(u) / u)^2 with u = pi * angle
+ *   circular:    DIFFRACTION_CIRCLE_NUM_QUANTILES first angles in [0, 5], distributed according to the marginal distribution of the first angle,
+ *                followed by DIFFRACTION_CIRCLE_NUM_ROWS rows of DIFFRACTION_CIRCLE_NUM_QUANTILES second angles in [0, 5], distributed
+ *                according to (2 * J1(u) / u)^2 given the first angle of the row, on a uniform grid of first angles over [0, 5]
+ */
+constexpr int DIFFRACTION_RECT_NUM_QUANTILES   = 4096;
+constexpr int DIFFRACTION_CIRCLE_NUM_ROWS      = 256;
+constexpr int DIFFRACTION_CIRCLE_NUM_QUANTILES = 1024;
+
+constexpr int DIFFRACTION_RECT_OFFSET               = 0;
+constexpr int DIFFRACTION_CIRCLE_MARGINAL_OFFSET    = DIFFRACTION_RECT_OFFSET + DIFFRACTION_RECT_NUM_QUANTILES;
+constexpr int DIFFRACTION_CIRCLE_CONDITIONAL_OFFSET = DIFFRACTION_CIRCLE_MARGINAL_OFFSET + DIFFRACTION_CIRCLE_NUM_QUANTILES;
+constexpr int DIFFRACTION_TABLE_SIZE = DIFFRACTION_CIRCLE_CONDITIONAL_OFFSET + DIFFRACTION_CIRCLE_NUM_ROWS * DIFFRACTION_CIRCLE_NUM_QUANTILES;
+
+/// returns the diffraction table. computed on first use
+RAYX_API const std::vector<double>& getDiffractionTable();
+
+/// same distribution as bessel_diff, sampled in constant time from the diffraction table
+RAYX_FN_ACC void bessel_diff_tabulated(double radius, double wl, double& dphi, double& dpsi, Rand& rand, const double* diffractionTable);
+
+/// same distribution as fraun_diff, sampled in constant time from the diffraction table
+RAYX_FN_ACC void fraun_diff_tabulated(double dim, double wl, double& dAngle, Rand& rand, const double* diffractionTable);
+
 }  // namespace rayx
\ No newline at end of file
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <optional>
+
 #include "Constants.h"
 #include "ElectricField.h"
+#include "Element/Coating.h"
 #include "Rand.h"
+#include "RefractiveIndex.h"
+#include "Utils.h"
 
 namespace rayx {
 
@@ -178,28 +183,48 @@ inline ComplexFresnelCoeffs computeSingleCoatingReflectance(const complex::Compl
     return {r_s, r_p};
 }
 
+// Parratt-Rekursion für einen Schichtstapel. Die Brechungsindizes der Schichten werden während der Rekursion (von unten nach oben) aus der
+// Materialtabelle gelesen, damit weder Brechungsindizes noch Winkel aller Schichten gleichzeitig im Speicher gehalten werden müssen.
 RAYX_FN_ACC
-inline ComplexFresnelCoeffs computeMultilayerReflectance(
-    const complex::Complex incidentAngle, const double wavelength, int numLayers,
-    const double* __restrict thicknesses,    // Längen: numLayers
-    const complex::Complex* __restrict iors  // Längen: numLayers + 2 (Vakuum + Schichten + Substrat)
-) {
-    constexpr int MAX_ANGLES = 18;  // unterstützt bis zu 16 Schichten
-    complex::Complex thetas[MAX_ANGLES];
+inline ComplexFresnelCoeffs computeMultilayerReflectance(const complex::Complex incidentAngle, const double wavelength, const double energy,
+                                                         const int numLayers,
+                                                         const CoatingLayer* __restrict layers,  // Längen: numLayers (von oben nach unten)
+                                                         const complex::Complex iorI,            // n0: z. B. Vakuum
+                                                         const complex::Complex iorS,            // Substrat
+                                                         const int* __restrict materialIndices, const double* __restrict materialTable) {
+    // Brechungsindex von Medium i: 0 = Vakuum, 1..numLayers = Schichten, numLayers + 1 = Substrat
+    const auto getIor = [&](const int i) -> complex::Complex {
+        if (i == 0) return iorI;
+        if (i == numLayers + 1) return iorS;
+        return getRefractiveIndex(energy, layers[i - 1].material, materialIndices, materialTable);
+    };
+
+    // Einfallswinkel in Medium i. Nach Snellius ist n_i * sin(theta_i) im ganzen Stapel konstant
+    const auto getAngle = [&](const int i, const complex::Complex ior) -> complex::Complex {
+        if (i == 0) return incidentAngle;
+        return calcRefractAngle(incidentAngle, iorI, ior);
+    };
 
-    // Einfallswinkel in den einzelnen Schichten
-    thetas[0] = incidentAngle;
-    for (int i = 1; i <= numLayers + 1; ++i) { thetas[i] = calcRefractAngle(thetas[i - 1], iors[i - 1], iors[i]); }
+    auto iorBelow   = iorS;
+    auto angleBelow = getAngle(numLayers + 1, iorBelow);
+    auto iorAbove   = getIor(numLayers);
+    auto angleAbove = getAngle(numLayers, iorAbove);
 
     // Startwert: Reflexion an Substratgrenze
-    ComplexFresnelCoeffs r = calcReflectAmplitude(thetas[numLayers], thetas[numLayers + 1], iors[numLayers], iors[numLayers + 1]);
+    ComplexFresnelCoeffs r = calcReflectAmplitude(angleAbove, angleBelow, iorAbove, iorBelow);
 
     // Parratt-Rekursion von unten nach oben
     for (int j = numLayers - 1; j >= 0; --j) {
-        const auto delta = (2.0 * PI / wavelength) * iors[j + 1] * complex::cos(thetas[j + 1]) * thicknesses[j];
+        // Medium j + 1 ist die Schicht layers[j], Medium j liegt darüber
+        iorBelow   = iorAbove;
+        angleBelow = angleAbove;
+        iorAbove   = getIor(j);
+        angleAbove = getAngle(j, iorAbove);
+
+        const auto delta = (2.0 * PI / wavelength) * iorBelow * complex::cos(angleBelow) * layers[j].thickness;
         const auto phase = complex::exp(complex::Complex(0.0, 2.0) * delta);
 
-        const auto r_j = calcReflectAmplitude(thetas[j], thetas[j + 1], iors[j], iors[j + 1]);
+        const auto r_j = calcReflectAmplitude(angleAbove, angleBelow, iorAbove, iorBelow);
 
         r.s = (r_j.s + r.s * phase) / (complex::Complex(1.0) + r_j.s * r.s * phase);
         r.p = (r_j.p + r.p * phase) / (complex::Complex(1.0) + r_j.p * r.p * phase);
@@ -208,6 +233,67 @@ inline ComplexFresnelCoeffs computeMultilayerReflectance(
     return r;
 }
 
+/// complex s and p reflection amplitudes of a coated mirror (one coating or multilayer coating), for a photon of `energy` hitting the mirror
+/// under `angle` (in rad, to the normal). `material` is the material of the substrate
+RAYX_FN_ACC
+inline ComplexFresnelCoeffs computeCoatingReflectance(const double energy, const double angle, const Coating& __restrict coating, const int material,
+                                                      const CoatingLayer* __restrict coatingLayers, const int* __restrict materialIndices,
+                                                      const double* __restrict materialTable) {
+    constexpr int vacuum_material = -1;
+    const auto vacuum_ior         = getRefractiveIndex(energy, vacuum_material, materialIndices, materialTable);
+    const auto substrate_ior      = getRefractiveIndex(energy, material, materialIndices, materialTable);
+
+    const auto incidentAngle = complex::Complex(angle == 0.0 ? 1e-8 : angle, 0.0);
+    const double wavelength  = energyToWaveLength(energy);
+
+    if (coating.is<Coating::OneCoating>()) {
+        const auto& oneCoating = coating.get<Coating::OneCoating>();
+        const auto coating_ior = getRefractiveIndex(energy, oneCoating.material, materialIndices, materialTable);
+        return computeSingleCoatingReflectance(incidentAngle, wavelength, oneCoating.thickness, vacuum_ior, coating_ior, substrate_ior);
+    }
+
+    const auto& mlCoating = coating.get<Coating::MultilayerCoating>();
+    return computeMultilayerReflectance(incidentAngle, wavelength, energy, mlCoating.numLayers, coatingLayers + mlCoating.layerOffset, vacuum_ior,
+                                        substrate_ior, materialIndices, materialTable);
+}
+
+/// layout of a precomputed reflectivity table of a coated mirror, see Element/ReflectivityTable.h. the header is followed by one entry
+/// (s.real, s.imag, p.real, p.imag, valid) per grid point, ordered by energy first, then by angle. valid is 1 if interpolation in the grid cell
+/// that starts at this grid point is within tolerance, otherwise 0
+constexpr int REFLECTIVITY_TABLE_HEADER_SIZE = 6;  // energy start, inverse energy step, number of energies, same for angles
+constexpr int REFLECTIVITY_TABLE_ENTRY_SIZE  = 5;
+
+/// bilinear interpolation of the reflection amplitudes in a precomputed reflectivity table. returns nothing if energy or angle are outside of
+/// the grid, or if interpolation in their grid cell is not within tolerance. in this case the reflection amplitudes have to be computed exactly
+RAYX_FN_ACC
+inline std::optional<ComplexFresnelCoeffs> lookupReflectivityTable(const double energy, const double angle, const double* __restrict table) {
+    const auto numEnergies = static_cast<int>(table[2]);
+    const auto numAngles   = static_cast<int>(table[5]);
+
+    // position on the grid in units of grid steps. the negated comparisons also reject nan
+    const auto u = (energy - table[0]) * table[1];
+    const auto v = (angle - table[3]) * table[4];
+    if (!(0.0 <= u && u <= numEnergies - 1 && 0.0 <= v && v <= numAngles - 1)) return std::nullopt;
+
+    const auto i  = glm::min(static_cast<int>(u), numEnergies - 2);
+    const auto j  = glm::min(static_cast<int>(v), numAngles - 2);
+    const auto tu = u - i;
+    const auto tv = v - j;
+
+    const auto* entries = table + REFLECTIVITY_TABLE_HEADER_SIZE;
+    if (entries[REFLECTIVITY_TABLE_ENTRY_SIZE * (i * numAngles + j) + 4] == 0.0) return std::nullopt;
+
+    const auto entry = [&](const int ei, const int aj) {
+        const auto* e = entries + REFLECTIVITY_TABLE_ENTRY_SIZE * (ei * numAngles + aj);
+        return ComplexFresnelCoeffs{complex::Complex(e[0], e[1]), complex::Complex(e[2], e[3])};
+    };
+    const auto lerp = [](const ComplexFresnelCoeffs a, const ComplexFresnelCoeffs b, const double t) {
+        return ComplexFresnelCoeffs{a.s + t * (b.s - a.s), a.p + t * (b.p - a.p)};
+    };
+
+    return lerp(lerp(entry(i, j), entry(i, j + 1), tv), lerp(entry(i + 1, j), entry(i + 1, j + 1), tv), tu);
+}
+
 RAYX_FN_ACC
 inline ElectricField interceptReflect(const ElectricField incidentElectricField, const glm::dvec3 incidentVec, const glm::dvec3 reflectVec,
                                       const glm::dvec3 normalVec, const complex::Complex iorI, const complex::Complex iorT) {
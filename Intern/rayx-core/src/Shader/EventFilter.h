@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glm.hpp>
+#include <limits>
+
+#include "Core.h"
+#include "ElectricField.h"
+#include "EventType.h"
+#include "Ray.h"
+
+namespace rayx {
+
+/**
+ * @brief Selects the events that are recorded. Filters are evaluated on the device, rejected events are never transferred to the host.
+ * An event is recorded if it passes all filters that apply to its object. Positions and directions are compared as they are recorded, i.e. in
+ * element coordinates for events on elements.
+ * Rejected events still count in path_event_id, so the recorded events are the same as if all events were recorded and filtered on the host.
+ */
+struct RAYX_API EventFilter {
+    static constexpr double INF = std::numeric_limits<double>::infinity();
+
+    int objectId             = -1;  ///< object the filter applies to, as in Rays::object_id. -1 applies the filter to all objects
+    EventTypeMask eventTypes = ~EventTypeMask::None;
+    double minEnergy         = -INF;
+    double maxEnergy         = INF;
+    glm::dvec3 minPosition   = glm::dvec3(-INF);
+    glm::dvec3 maxPosition   = glm::dvec3(INF);
+    glm::dvec3 minDirection  = glm::dvec3(-INF);
+    glm::dvec3 maxDirection  = glm::dvec3(INF);
+    double minIntensity      = -INF;  ///< minimum intensity of the electric field
+};
+
+/// whether the event passes the filter. ranges are inclusive
+RAYX_FN_ACC
+inline bool passesEventFilter(const detail::Ray& __restrict ray, const EventFilter& __restrict filter) {
+    if (filter.objectId != -1 && filter.objectId != ray.object_id) return true;
+
+    return !!(filter.eventTypes & eventTypeToMask(ray.event_type)) && filter.minEnergy <= ray.energy && ray.energy <= filter.maxEnergy &&
+           glm::all(glm::lessThanEqual(filter.minPosition, ray.position)) && glm::all(glm::lessThanEqual(ray.position, filter.maxPosition)) &&
+           glm::all(glm::lessThanEqual(filter.minDirection, ray.direction)) && glm::all(glm::lessThanEqual(ray.direction, filter.maxDirection)) &&
+           (filter.minIntensity == -EventFilter::INF || filter.minIntensity <= intensity(ray.electric_field));
+}
+
+/// whether the event passes all filters
+RAYX_FN_ACC
+inline bool passesEventFilters(const detail::Ray& __restrict ray, const EventFilter* __restrict filters, const int numFilters) {
+    for (int i = 0; i < numFilters; ++i)
+        if (!passesEventFilter(ray, filters[i])) return false;
+    return true;
+}
+
+}  // namespace rayx
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Atomic.h"
+#include "Core.h"
+#include "ElectricField.h"
+#include "Ray.h"
+
+namespace rayx {
+
+/// attribute of an event that is binned along an axis of a histogram. positions and directions of events on elements are in element coordinates
+enum class HistogramAttr { None, PositionX, PositionY, PositionZ, DirectionX, DirectionY, DirectionZ, Energy, OpticalPathLength, Order };
+
+/// uniform bins of an attribute in the range [min, max). an axis with attribute None has a single bin, that contains every event
+struct RAYX_API HistogramAxis {
+    HistogramAttr attr = HistogramAttr::None;
+    int numBins        = 1;
+    double min         = 0.0;
+    double max         = 1.0;
+};
+
+/**
+ * @brief Declares a histogram that is accumulated on the device while tracing, instead of recording events.
+ * Every event on the object `objectId` that is selected by the object record mask adds its weight to the bin of its attributes `x` and `y`.
+ * Events outside the range of either axis are dropped. E.g. an intensity map at an image plane bins PositionX and PositionY, weighted by
+ * intensity. An energy spectrum bins Energy along `x` and leaves `y` unused. A footprint on an element bins PositionX and PositionZ.
+ */
+struct RAYX_API HistogramConfig {
+    int objectId;  ///< index of the object, as in Rays::object_id
+    HistogramAxis x;
+    HistogramAxis y;
+    bool weightByIntensity = false;  ///< weight each event by the intensity of its electric field, instead of 1
+
+    RAYX_FN_ACC int numBins() const { return x.numBins * y.numBins; }
+};
+
+RAYX_FN_ACC
+inline double getHistogramAttr(const detail::Ray& __restrict ray, const HistogramAttr attr) {
+    switch (attr) {
+        case HistogramAttr::PositionX:
+            return ray.position.x;
+        case HistogramAttr::PositionY:
+            return ray.position.y;
+        case HistogramAttr::PositionZ:
+            return ray.position.z;
+        case HistogramAttr::DirectionX:
+            return ray.direction.x;
+        case HistogramAttr::DirectionY:
+            return ray.direction.y;
+        case HistogramAttr::DirectionZ:
+            return ray.direction.z;
+        case HistogramAttr::Energy:
+            return ray.energy;
+        case HistogramAttr::OpticalPathLength:
+            return ray.optical_path_length;
+        case HistogramAttr::Order:
+            return ray.order;
+        default:  // HistogramAttr::None
+            return 0.0;
+    }
+}
+
+/// returns the bin of the attribute of the ray along the axis, or -1 if it is outside the range of the axis
+RAYX_FN_ACC
+inline int getHistogramBin(const detail::Ray& __restrict ray, const HistogramAxis& axis) {
+    if (axis.attr == HistogramAttr::None) return 0;
+
+    const auto value = getHistogramAttr(ray, axis.attr);
+    if (!(axis.min <= value && value < axis.max)) return -1;
+    const auto bin = static_cast<int>((value - axis.min) / (axis.max - axis.min) * axis.numBins);
+    return glm::min(bin, axis.numBins - 1);
+}
+
+/// adds the event to the bins of all histograms of its object. the bins of the histograms are stored one after the other, each in row-major
+/// order of (y, x). returns whether the event was selected by the object record mask, like storeRay
+RAYX_FN_ACC
+inline bool accumulateHistograms(const detail::Ray& __restrict ray, const HistogramConfig* __restrict histograms, const int numHistograms,
+                                 double* __restrict bins, const bool* __restrict objectRecordMask, const int objectIndex) {
+    // object record mask
+    if (!objectRecordMask[objectIndex]) return false;
+
+    auto offset = 0;
+    for (int i = 0; i < numHistograms; ++i) {
+        const auto& histogram = histograms[i];
+        if (histogram.objectId == objectIndex) {
+            const auto binX = getHistogramBin(ray, histogram.x);
+            const auto binY = getHistogramBin(ray, histogram.y);
+            if (binX != -1 && binY != -1) {
+                const auto weight = histogram.weightByIntensity ? intensity(ray.electric_field) : 1.0;
+                atomicAddDouble(bins + offset + binY * histogram.x.numBins + binX, weight);
+            }
+        }
+        offset += histogram.numBins();
+    }
+
+    return true;
+}
+
+}  // namespace rayx
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <algorithm>
+#include <glm.hpp>
+#include <vector>
+
+#include "Core.h"
+
+namespace rayx {
+
+/**
+ * @brief Tabulates the inverse cumulative distribution function of a distribution, for sampling it in constant time.
+ * Writes `numQuantiles` equidistant quantiles of the distribution with the given (non-negative) density at `nodes` to `quantiles`. The cdf is
+ * integrated with the trapezoidal rule. A vanishing density yields a uniform distribution.
+ */
+inline void calcInverseCdf(const std::vector<double>& nodes, const std::vector<double>& density, const int numQuantiles, double* quantiles) {
+    auto cdf = std::vector<double>(nodes.size(), 0.0);
+    for (size_t i = 1; i < nodes.size(); ++i) cdf[i] = cdf[i - 1] + 0.5 * (density[i - 1] + density[i]) * (nodes[i] - nodes[i - 1]);
+    const auto total = cdf.back();
+
+    if (!(total > 0.0)) {
+        for (int k = 0; k < numQuantiles; ++k) quantiles[k] = nodes.front() + (nodes.back() - nodes.front()) * k / (numQuantiles - 1);
+        return;
+    }
+
+    size_t i = 1;
+    for (int k = 0; k < numQuantiles; ++k) {
+        const auto target = total * k / (numQuantiles - 1);
+        while (i < nodes.size() - 1 && cdf[i] < target) ++i;
+        const auto segment = cdf[i] - cdf[i - 1];
+        const auto t       = segment > 0.0 ? std::clamp((target - cdf[i - 1]) / segment, 0.0, 1.0) : 0.0;
+        quantiles[k]       = nodes[i - 1] + t * (nodes[i] - nodes[i - 1]);
+    }
+}
+
+/// samples a distribution by linear interpolation in a table of its equidistant quantiles (see calcInverseCdf). `u` is uniformly distributed
+/// in [0, 1]
+RAYX_FN_ACC
+inline double sampleQuantiles(const double* __restrict quantiles, const int numQuantiles, const double u) {
+    const auto x = u * (numQuantiles - 1);
+    const auto i = glm::clamp(static_cast<int>(x), 0, numQuantiles - 2);
+    const auto t = x - i;
+    return quantiles[i] + t * (quantiles[i + 1] - quantiles[i]);
+}
+
+}  // namespace rayx
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "Element/Element.h"
+#include "Element/ElementBvh.h"
+#include "EventFilter.h"
+#include "Histogram.h"
 #include "RaysPtr.h"
 
 namespace rayx {
@@ -16,13 +19,26 @@ struct RAYX_API ConstState {
     Sequential sequential = Sequential::No;
     int numSources;
     int numElements;
+    int numElementBvhNodes;
     int outputEventsGridStride;
+    int appendEventsCapacity;  // capacity of the compact events buffer, if events are appended
+    int numEventFilters;
+    int numHistograms;
+    int numHistogramBins;      // number of bins of all histograms together
+    int numHistogramReplicas;  // number of copies of the histogram bins. blocks accumulate into the copy of their block index
 
-    ObjectTransform* __restrict objectTransforms;
+    AffineObjectTransform* __restrict objectTransforms;
+    AffineTransform* __restrict sequentialTransforms;  // transform from the previous element (in_i * out_{i-1}), or from world for the first element
     OpticalElement* __restrict elements;
+    CoatingLayer* __restrict coatingLayers;      // layer table of multilayer coatings, referenced by Coating::MultilayerCoating::layerOffset
+    ElementBvhNode* __restrict elementBvhNodes;  // bounding volume hierarchy over elements, used to cull elements in non-sequential tracing
+    double* __restrict reflectivityTables;       // precomputed reflectivity tables of coated mirrors, referenced by reflectivityTableOffset
+    double* __restrict diffractionTable;         // inverse cdfs of the diffraction angles of slits, see Diffraction.h
     int* __restrict materialIndices;
     double* __restrict materialTable;
-    bool* __restrict objectRecordMask;  // Mask that decides which elements to record events for (array length is numElements)
+    bool* __restrict objectRecordMask;     // Mask that decides which elements to record events for (array length is numElements)
+    EventFilter* __restrict eventFilters;  // filters that decide which events to record, in addition to objectRecordMask
+    HistogramConfig* __restrict histograms;
     RayAttrMask attrRecordMask;
     RaysPtr rays;
 };
@@ -31,6 +47,8 @@ struct RAYX_API ConstState {
 struct RAYX_API MutableState {
     RaysPtr events;
     bool* __restrict storedFlags;
+    int* numAppendedEvents;  // if not null, events are appended to the compact events buffer at this counter, instead of stored at their record index
+    double* histogramBins;   // if not null, events are accumulated into the histograms, instead of recorded
 };
 
 }  // namespace rayx
@@ -5,15 +5,14 @@
 #include "Debug/Debug.h"
 #include "Debug/Instrumentor.h"
 #include "Design/DesignSource.h"
-#include "Random.h"
 #include "Rml/xml.h"
 #include "Shader/Constants.h"
 #include "Shader/EventType.h"
+#include "Shader/InverseCdf.h"
 #include "Shader/Utils.h"
 
 namespace rayx {
 
-// TODO: why does this source get seeded with randomDouble in the constructor?
 // TODO: do we only use schwinger log?
 // TODO: what about unused functions?
 
@@ -376,15 +375,56 @@ DipoleSource::DipoleSource(const DesignSource& dSource)
       // m_photonWaveLength(hvlam(m_photonEnergy)),
       m_energySpread(dSource.getEnergySpread()),
       m_horDivergence(dSource.getHorDivergence()) {
-    auto rand       = Rand(randomUint());
     m_gamma         = calcGamma(m_electronEnergy);
     m_verDivergence = calcVerDivergence(m_photonEnergy, m_verEbeamDivergence, m_electronEnergy, m_criticalEnergy);
     // m_stokes = DipoleSource::getStokesSyn(m_photonEnergy, -3 * m_verDivergence, 3 * m_verDivergence);
-    m_maxIntensity = calcMaxIntensity(m_photonEnergy, m_verDivergence, m_electronEnergy, m_criticalEnergy, m_electronEnergyOrientation, rand);
-    m_maxFlux      = calcMaxFlux(m_photonEnergy, m_energySpread, m_criticalEnergy, m_gamma);
     // m_flux = calcFluxOrg(m_photonEnergy, m_energySpread, dSource.getEnergySpreadUnit(), m_horDivergence, m_stokes);
 }
 
+/**
+ * tabulates the distributions that were previously sampled with rejection loops:
+ * the energy is distributed according to the schwinger function within the energy spread,
+ * psi is distributed according to the intensity of the synchrotron radiation at the energy of the ray, within 3 times the vertical divergence
+ */
+std::vector<double> DipoleSource::calcSamplingTable() const {
+    auto table = std::vector<double>(SAMPLING_TABLE_SIZE);
+
+    const auto halfSpread = std::abs(m_energySpread) / 2.0;
+    const auto energyMin  = m_photonEnergy - halfSpread;
+    const auto energyMax  = m_photonEnergy + halfSpread;
+
+    // energy
+    auto energies = std::vector<double>(NUM_ENERGY_NODES);
+    auto fluxes   = std::vector<double>(NUM_ENERGY_NODES);
+    for (int i = 0; i < NUM_ENERGY_NODES; ++i) {
+        energies[i] = energyMin + (energyMax - energyMin) * i / (NUM_ENERGY_NODES - 1);
+        fluxes[i]   = std::max(schwinger(energies[i], m_gamma, m_criticalEnergy), 0.0);
+    }
+    calcInverseCdf(energies, fluxes, NUM_ENERGY_QUANTILES, table.data() + ENERGY_QUANTILES_OFFSET);
+
+    // psi and stokes vector, per energy row
+    const auto psiRange = 3.0 * m_verDivergence;
+    auto psis           = std::vector<double>(NUM_PSI_NODES);
+    auto intensities    = std::vector<double>(NUM_PSI_NODES);
+    for (int j = 0; j < NUM_PSI_NODES; ++j) psis[j] = -psiRange + 2.0 * psiRange * j / (NUM_PSI_NODES - 1);
+
+    for (int r = 0; r < NUM_PSI_ROWS; ++r) {
+        const auto energy = energyMin + (energyMax - energyMin) * r / (NUM_PSI_ROWS - 1);
+        for (int j = 0; j < NUM_PSI_NODES; ++j) {
+            const auto syn = getStokesSyn(energy, psis[j], psis[j], m_electronEnergy, m_criticalEnergy, m_electronEnergyOrientation);
+            // same order of components as in calcDipoleFold
+            const auto stokes = glm::dvec4(syn[2] + syn[3], syn[0], 0.0, syn[1]);
+            intensities[j]    = std::max(stokes[0], 0.0);
+
+            auto* entry = table.data() + STOKES_OFFSET + 4 * (r * NUM_PSI_NODES + j);
+            for (int c = 0; c < 4; ++c) entry[c] = stokes[c];
+        }
+        calcInverseCdf(psis, intensities, NUM_PSI_QUANTILES, table.data() + PSI_QUANTILES_OFFSET + r * NUM_PSI_QUANTILES);
+    }
+
+    return table;
+}
+
 /**
  * Creates random ray from dipole source
  *
@@ -395,7 +435,7 @@ DipoleSource::DipoleSource(const DesignSource& dSource)
  * @returns Ray
  */
 RAYX_FN_ACC
-detail::Ray DipoleSource::genRay(const int rayPathIndex, const int sourceId, Rand& __restrict rand) const {
+detail::Ray DipoleSource::genRay(const int64_t rayPathIndex, const int sourceId, Rand& __restrict rand) const {
     double phi, en;  // phi=horizontal Angle, en=energy
 
     // create ray with random position and divergence within the given span
@@ -472,14 +512,7 @@ double DipoleSource::getNormalFromRange(double range, Rand& __restrict rand) con
  */
 RAYX_FN_ACC
 double DipoleSource::getEnergy(Rand& __restrict rand) const {
-    double flux   = 0.0;
-    double energy = 0.0;
-
-    do {
-        energy = m_photonEnergy + (rand.randomDouble() - 0.5) * m_energySpread;
-        flux   = schwinger(energy, m_gamma, m_criticalEnergy);
-    } while ((flux / m_maxFlux - rand.randomDouble()) < 0);
-    return energy;
+    return sampleQuantiles(m_samplingTable + ENERGY_QUANTILES_OFFSET, NUM_ENERGY_QUANTILES, rand.randomDouble());
 }
 
 /**
@@ -487,14 +520,39 @@ double DipoleSource::getEnergy(Rand& __restrict rand) const {
  */
 RAYX_FN_ACC
 PsiAndStokes DipoleSource::getPsiandStokes(double en, Rand& __restrict rand) const {
-    PsiAndStokes psiandstokes;
-    do {
-        psiandstokes.psi = (rand.randomDouble() - 0.5) * 6 * m_verDivergence;
-        psiandstokes =
-            calcDipoleFold(psiandstokes.psi, en, m_verEbeamDivergence, m_electronEnergy, m_criticalEnergy, m_electronEnergyOrientation, rand);
-    } while ((psiandstokes.stokes[0]) / m_maxIntensity < rand.randomDouble());
+    // position of the energy on the grid of energy rows
+    const auto halfSpread = glm::abs(m_energySpread) / 2.0;
+    const auto e          = halfSpread > 0.0 ? glm::clamp((en - m_photonEnergy + halfSpread) / (2.0 * halfSpread), 0.0, 1.0) : 0.0;
+    const auto r          = e * (NUM_PSI_ROWS - 1);
+    const auto row        = glm::min(static_cast<int>(r), NUM_PSI_ROWS - 2);
+    const auto tr         = r - row;
+
+    // the same quantile in the neighbouring energy rows, interpolated
+    const auto u             = rand.randomDouble();
+    const auto* psiQuantiles = m_samplingTable + PSI_QUANTILES_OFFSET + row * NUM_PSI_QUANTILES;
+    const auto psi0          = sampleQuantiles(psiQuantiles, NUM_PSI_QUANTILES, u);
+    const auto psi1          = sampleQuantiles(psiQuantiles + NUM_PSI_QUANTILES, NUM_PSI_QUANTILES, u);
+    auto psi                 = psi0 + tr * (psi1 - psi0);
+
+    // stokes vector, bilinear in energy and psi
+    const auto psiRange = 3.0 * m_verDivergence;
+    const auto p        = psiRange > 0.0 ? glm::clamp((psi + psiRange) / (2.0 * psiRange), 0.0, 1.0) * (NUM_PSI_NODES - 1) : 0.0;
+    const auto node     = glm::min(static_cast<int>(p), NUM_PSI_NODES - 2);
+    const auto tp       = p - node;
+    const auto stokesAt = [this](const int rowIndex, const int nodeIndex) {
+        const auto* entry = m_samplingTable + STOKES_OFFSET + 4 * (rowIndex * NUM_PSI_NODES + nodeIndex);
+        return glm::dvec4(entry[0], entry[1], entry[2], entry[3]);
+    };
+    const auto stokes0 = glm::mix(stokesAt(row, node), stokesAt(row, node + 1), tp);
+    const auto stokes1 = glm::mix(stokesAt(row + 1, node), stokesAt(row + 1, node + 1), tp);
+
+    // fold with the divergence of the electron beam (see calcDipoleFold). the shift is within 0.2% of the divergence, where its gaussian
+    // weight is 1 in good approximation, so it is sampled uniformly
+    if (m_verEbeamDivergence != 0) psi += (rand.randomDouble() - 0.5) * 4.0e-3 * m_verEbeamDivergence;
 
-    psiandstokes.psi = psiandstokes.psi * 1e-3;  // psi in rad
+    PsiAndStokes psiandstokes;
+    psiandstokes.stokes = glm::mix(stokes0, stokes1, tr);
+    psiandstokes.psi    = psi * 1e-3;  // psi in rad
 
     return psiandstokes;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <list>
+#include <vector>
 
 #include "LightSource.h"
 #include "Shader/Rand.h"
@@ -29,11 +30,37 @@ RAYX_API RAYX_FN_ACC double schwinger(double energy, double gamma, double critic
 RAYX_API double calcMaxFlux(double photonEnergy, double energySpread, double criticalEnergy, double gamma);
 RAYX_API double calcGamma(double electronEnergy);
 
+/**
+ * Energy and vertical angle (psi) of the dipole source are sampled from tabulated inverse cumulative distribution functions, in constant time.
+ * The tables are computed on the host by calcSamplingTable and have to be uploaded to the device and assigned with setSamplingTable, before
+ * generating rays. Layout of the sampling table:
+ *   energy quantiles: NUM_ENERGY_QUANTILES energies, inverse cdf of the schwinger distribution over the energy spread
+ *   psi quantiles:    NUM_PSI_ROWS rows of NUM_PSI_QUANTILES angles, inverse cdf of the intensity over psi, one row per energy on a uniform
+ *                     energy grid over the energy spread
+ *   stokes:           NUM_PSI_ROWS rows of NUM_PSI_NODES stokes vectors, on a uniform psi grid over [-3, 3] times the vertical divergence
+ */
 class RAYX_API DipoleSource : public LightSourceBase {
   public:
+    static constexpr int NUM_ENERGY_NODES     = 1024;
+    static constexpr int NUM_ENERGY_QUANTILES = 4096;
+    static constexpr int NUM_PSI_ROWS         = 32;
+    static constexpr int NUM_PSI_NODES        = 256;
+    static constexpr int NUM_PSI_QUANTILES    = 1024;
+
+    static constexpr int ENERGY_QUANTILES_OFFSET = 0;
+    static constexpr int PSI_QUANTILES_OFFSET    = ENERGY_QUANTILES_OFFSET + NUM_ENERGY_QUANTILES;
+    static constexpr int STOKES_OFFSET           = PSI_QUANTILES_OFFSET + NUM_PSI_ROWS * NUM_PSI_QUANTILES;
+    static constexpr int SAMPLING_TABLE_SIZE     = STOKES_OFFSET + NUM_PSI_ROWS * NUM_PSI_NODES * 4;
+
     DipoleSource(const DesignSource&);
 
-    RAYX_FN_ACC detail::Ray genRay(const int rayPathIndex, const int sourceId, Rand& __restrict rand) const;
+    RAYX_FN_ACC detail::Ray genRay(const int64_t rayPathIndex, const int sourceId, Rand& __restrict rand) const;
+
+    /// computes the sampling table of this source on the host
+    std::vector<double> calcSamplingTable() const;
+
+    /// assigns the sampling table, computed by calcSamplingTable. must point to device memory when generating rays on the device
+    void setSamplingTable(const double* samplingTable) { m_samplingTable = samplingTable; }
 
   private:
     // calculate Ray-Information
@@ -75,10 +102,10 @@ class RAYX_API DipoleSource : public LightSourceBase {
     double m_energySpread;
     // EnergySpreadUnit m_energySpreadUnit;
     // double m_photonFluxOrg;
-    double m_maxFlux;
-    double m_maxIntensity;
     double m_horDivergence;
     double m_verDivergence;
+
+    const double* m_samplingTable = nullptr;
 };
 
 }  // namespace rayx
@@ -25,7 +25,7 @@ MatrixSource::MatrixSource(const DesignSource& dSource)
  * returns vector of rays
  */
 RAYX_FN_ACC
-detail::Ray MatrixSource::genRay(const int rayPathIndex, const int sourceId, const EnergyDistributionDataVariant& __restrict energyDistribution,
+detail::Ray MatrixSource::genRay(const int64_t rayPathIndex, const int sourceId, const EnergyDistributionDataVariant& __restrict energyDistribution,
                                  Rand& __restrict rand) const {
     // Calculate grid size
     const int rmat  = static_cast<int>(std::sqrt(m_numberOfRays));
@@ -40,7 +40,7 @@ double getPosInDistribution(SourceDist l, double extent, Rand& __restrict rand)
  * @returns list of rays
  */
 RAYX_FN_ACC
-detail::Ray PixelSource::genRay(const int rayPathIndex, const int sourceId, const EnergyDistributionDataVariant& __restrict energyDistribution,
+detail::Ray PixelSource::genRay(const int64_t rayPathIndex, const int sourceId, const EnergyDistributionDataVariant& __restrict energyDistribution,
                                 Rand& __restrict rand) const {
     // create ray with random position and divergence within the given span
     // for width, height, depth, horizontal and vertical divergence
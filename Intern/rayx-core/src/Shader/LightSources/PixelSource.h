@@ -9,7 +9,7 @@ class RAYX_API PixelSource : public LightSourceBase {
   public:
     PixelSource(const DesignSource&);
 
-    RAYX_FN_ACC detail::Ray genRay(const int rayPathIndex, const int sourceId, const EnergyDistributionDataVariant& __restrict energyDistribution,
+    RAYX_FN_ACC detail::Ray genRay(const int64_t rayPathIndex, const int sourceId, const EnergyDistributionDataVariant& __restrict energyDistribution,
                                    Rand& __restrict rand) const;
 
   private:
@@ -9,7 +9,7 @@ class RAYX_API SimpleUndulatorSource : public LightSourceBase {
   public:
     SimpleUndulatorSource(const DesignSource&);
 
-    RAYX_FN_ACC detail::Ray genRay(const int rayPathIndex, const int sourceId, const EnergyDistributionDataVariant& __restrict energyDistribution,
+    RAYX_FN_ACC detail::Ray genRay(const int64_t rayPathIndex, const int sourceId, const EnergyDistributionDataVariant& __restrict energyDistribution,
                                    Rand& __restrict rand) const;
 
     RAYX_FN_ACC double getCoord(const double extent, Rand& __restrict rand) const;
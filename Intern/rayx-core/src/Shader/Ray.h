@@ -24,7 +24,7 @@ struct Ray {
 
     Rand rand;  // deletes copy constructor/assignment
 
-    int path_id;
+    int64_t path_id;
     int path_event_id;
     int order;
     int object_id;
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glm.hpp>
+
+#include "Core.h"
+
+// vectorizes a loop over the lanes of a ray packet. ray packets are only traced on CPU
+#if defined(_OPENMP) && !defined(__CUDA_ARCH__)
+#define RAYX_SIMD_LOOP _Pragma("omp simd")
+#else
+#define RAYX_SIMD_LOOP
+#endif
+
+namespace rayx {
+
+/// number of rays in a packet. 8 doubles fill an AVX-512 register, or two AVX2 registers
+constexpr int RAY_PACKET_SIZE = 8;
+
+/// positions and directions of a packet of rays, one SIMD lane per ray (structure of arrays, like RaysPtr).
+/// lanes of rays that are terminated, missed an element or are beyond the end of the batch are masked out by `active`
+struct RayPacket {
+    alignas(64) double position_x[RAY_PACKET_SIZE];
+    alignas(64) double position_y[RAY_PACKET_SIZE];
+    alignas(64) double position_z[RAY_PACKET_SIZE];
+    alignas(64) double direction_x[RAY_PACKET_SIZE];
+    alignas(64) double direction_y[RAY_PACKET_SIZE];
+    alignas(64) double direction_z[RAY_PACKET_SIZE];
+    bool active[RAY_PACKET_SIZE];
+
+    RAYX_FN_ACC glm::dvec3 position(const int lane) const { return glm::dvec3(position_x[lane], position_y[lane], position_z[lane]); }
+    RAYX_FN_ACC void position(const int lane, const glm::dvec3 position) {
+        position_x[lane] = position.x;
+        position_y[lane] = position.y;
+        position_z[lane] = position.z;
+    }
+
+    RAYX_FN_ACC glm::dvec3 direction(const int lane) const { return glm::dvec3(direction_x[lane], direction_y[lane], direction_z[lane]); }
+    RAYX_FN_ACC void direction(const int lane, const glm::dvec3 direction) {
+        direction_x[lane] = direction.x;
+        direction_y[lane] = direction.y;
+        direction_z[lane] = direction.z;
+    }
+};
+
+}  // namespace rayx
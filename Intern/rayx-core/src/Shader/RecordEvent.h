@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Atomic.h"
 #include "Ray.h"
 #include "RaysPtr.h"
 
@@ -49,14 +50,7 @@ inline void storeRay(const int i, RaysPtr& __restrict rays, const detail::Ray& _
 }
 
 RAYX_FN_ACC
-inline bool storeRay(const int i, bool* __restrict storedFlags, RaysPtr& __restrict rays, detail::Ray& __restrict ray,
-                     const bool* __restrict objectRecordMask, const int objectIndex, const RayAttrMask attrRecordMask) {
-    // TODO: should we do a syncwarp here, to make the whole warp access gmem?
-
-    // object record mask
-    if (!objectRecordMask[objectIndex]) return false;
-
-    // attribute record mask
+inline void storeRayAttrs(const int i, RaysPtr& __restrict rays, const detail::Ray& __restrict ray, const RayAttrMask attrRecordMask) {
     if (!!(attrRecordMask & RayAttrMask::PathId)) rays.path_id[i] = ray.path_id;
     if (!!(attrRecordMask & RayAttrMask::PathEventId)) rays.path_event_id[i] = ray.path_event_id;
     if (!!(attrRecordMask & RayAttrMask::PositionX)) rays.position_x[i] = ray.position.x;
@@ -75,10 +69,34 @@ inline bool storeRay(const int i, bool* __restrict storedFlags, RaysPtr& __restr
     if (!!(attrRecordMask & RayAttrMask::ObjectId)) rays.object_id[i] = ray.object_id;
     if (!!(attrRecordMask & RayAttrMask::SourceId)) rays.source_id[i] = ray.source_id;
     if (!!(attrRecordMask & RayAttrMask::RandCounter)) rays.rand_counter[i] = ray.rand.counter;
+}
+
+RAYX_FN_ACC
+inline bool storeRay(const int i, bool* __restrict storedFlags, RaysPtr& __restrict rays, detail::Ray& __restrict ray,
+                     const bool* __restrict objectRecordMask, const int objectIndex, const RayAttrMask attrRecordMask) {
+    // TODO: should we do a syncwarp here, to make the whole warp access gmem?
+
+    // object record mask
+    if (!objectRecordMask[objectIndex]) return false;
+
+    storeRayAttrs(i, rays, ray, attrRecordMask);
 
     // mark as stored
     storedFlags[i] = true;
     return true;
 }
 
+/// appends the ray to the compact `rays` at the next free index of `numRays`. if `rays` is full, the ray is dropped, but still counted, so that
+/// `numRays` holds the required capacity afterwards
+RAYX_FN_ACC
+inline bool appendRay(int* numRays, const int capacity, RaysPtr& __restrict rays, detail::Ray& __restrict ray,
+                      const bool* __restrict objectRecordMask, const int objectIndex, const RayAttrMask attrRecordMask) {
+    // object record mask
+    if (!objectRecordMask[objectIndex]) return false;
+
+    const auto i = atomicAppendIndex(numRays);
+    if (i < capacity) storeRayAttrs(i, rays, ray, attrRecordMask);
+    return true;
+}
+
 }  // namespace rayx
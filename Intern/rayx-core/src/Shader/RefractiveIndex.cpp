@@ -23,6 +23,8 @@ namespace rayx {
 
 // The concrete layout of materialTable and materialIndices has to be compatible with the "loadMaterialTables" function from Material.cpp
 // It is responsible for creating these tables.
+// Optionally, materialTable also holds an energy gridded lookup table per material, appended by "appendRefractiveIndexLuts" from
+// RefractiveIndexLut.cpp. These are referenced by materialIndices[533 + m], see REFRACTIVE_INDEX_LUT_INDICES_OFFSET.
 
 /// The number of palik entries we currently store for this material.
 RAYX_FN_ACC
@@ -123,6 +125,26 @@ NKEntry RAYX_API getMolecEntry(int index, int material, const int* __restrict ma
     return e;
 }
 
+RAYX_FN_ACC
+std::optional<complex::Complex> RAYX_API lookupRefractiveIndexLut(double energy, const double* __restrict lut) {
+    const auto gridStart     = lut[0];
+    const auto invGridStep   = lut[1];
+    const auto numGridPoints = static_cast<int>(lut[2]);
+    const auto logarithmic   = lut[3] != 0.0;
+
+    // position on the grid in units of grid steps. the negated comparison also rejects nan, e.g. the log of a non-positive energy
+    const auto u = ((logarithmic ? glm::log(energy) : energy) - gridStart) * invGridStep;
+    if (!(0.0 <= u && u <= numGridPoints - 1)) return std::nullopt;
+
+    const auto i     = glm::min(static_cast<int>(u), numGridPoints - 2);
+    const auto* low  = lut + REFRACTIVE_INDEX_LUT_HEADER_SIZE + REFRACTIVE_INDEX_LUT_ENTRY_SIZE * i;
+    const auto* high = low + REFRACTIVE_INDEX_LUT_ENTRY_SIZE;
+    if (low[2] == 0.0) return std::nullopt;
+
+    const auto t = u - i;
+    return complex::Complex(low[0] + t * (high[0] - low[0]), low[1] + t * (high[1] - low[1]));
+}
+
 // returns dvec2 to represent a complex number
 RAYX_FN_ACC
 complex::Complex RAYX_API getRefractiveIndex(double energy, int material, const int* __restrict materialIndices,
@@ -140,6 +162,14 @@ complex::Complex RAYX_API getRefractiveIndex(double energy, int material, const
         return complex::Complex(-1.0, -1.0);
     }
 
+    // fast path: O(1) lookup in the energy gridded lookup table of this material, if there is one
+    if (material <= 133) {
+        const auto lutOffset = materialIndices[REFRACTIVE_INDEX_LUT_INDICES_OFFSET + material - 1];
+        if (lutOffset >= 0) {
+            if (const auto ior = lookupRefractiveIndexLut(energy, materialTable + lutOffset)) return *ior;
+        }
+    }
+
     //check if material is an atom < 92 
     if (material <= 92) {
             // try to get refractive index using Palik table
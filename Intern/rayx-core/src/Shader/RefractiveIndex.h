@@ -1,5 +1,7 @@
 #pragma once
 
+#include <optional>
+
 #include "Complex.h"
 #include "InvocationState.h"
 
@@ -31,6 +33,15 @@ struct CromerEntry {
     double m_f2;
 };
 
+/// materialIndices[REFRACTIVE_INDEX_LUT_INDICES_OFFSET + material - 1] is the offset of the energy gridded lookup table of a material in
+/// materialTable, or -1 if the material has no lookup table. see Material/RefractiveIndexLut.h
+constexpr int REFRACTIVE_INDEX_LUT_INDICES_OFFSET = 4 * 133 + 1;
+
+/// layout of an energy gridded refractive index lookup table in materialTable. the header is followed by one entry (n, k, valid) per grid point,
+/// where valid tells whether linear interpolation between this grid point and the next one is within the error bound
+constexpr int REFRACTIVE_INDEX_LUT_HEADER_SIZE = 4;  // grid start, inverse grid step, number of grid points, logarithmic spacing (0 or 1)
+constexpr int REFRACTIVE_INDEX_LUT_ENTRY_SIZE  = 3;
+
 RAYX_FN_ACC int RAYX_API getPalikEntryCount(int material, const int* materialIndices);
 
 RAYX_FN_ACC int RAYX_API getNffEntryCount(int material, const int* materialIndices);
@@ -47,6 +58,10 @@ RAYX_FN_ACC NKEntry RAYX_API getCromerEntry(int index, int material, const int*
 
 RAYX_FN_ACC NKEntry RAYX_API getMolecEntry(int index, int material, const int* materialIndices, const double* materialTable);
 
+// looks up the refractive index in an energy gridded lookup table. returns nothing if the energy is outside of the grid, or if interpolation is
+// not accurate enough at this energy. in this case the exact refractive index has to be used
+RAYX_FN_ACC std::optional<complex::Complex> RAYX_API lookupRefractiveIndexLut(double energy, const double* lut);
+
 // returns dvec2 to represent a complex number
 RAYX_FN_ACC complex::Complex RAYX_API getRefractiveIndex(double energy, int material, const int* materialIndices, const double* materialTable);
 
@@ -2,6 +2,7 @@
 
 #include "Behave.h"
 #include "Collision.h"
+#include "RayPacket.h"
 #include "RecordEvent.h"
 #include "Utils.h"
 
@@ -10,6 +11,51 @@ namespace rayx {
 #define assertObjectIdInBounds(object_id, numObjects) \
     _debug_assert(0 <= object_id && object_id < numObjects, "error: ray object id '%d' is out of bounds [0, %d)", object_id, numObjects);
 
+namespace {
+
+// stores the event at its record index in the dense events buffer, or appends it to the compact events buffer if append recording is enabled,
+// or accumulates it into the histograms if histograms are accumulated instead of recording events
+RAYX_FN_ACC
+bool recordEvent(const int gid, const int recordIndex, detail::Ray& __restrict ray, const ConstState& __restrict constState,
+                 MutableState& __restrict mutableState) {
+    // rejected events are not stored, but count as recorded, so that path_event_id is the same as without filters
+    if (!passesEventFilters(ray, constState.eventFilters, constState.numEventFilters)) return constState.objectRecordMask[ray.object_id];
+
+    if (mutableState.histogramBins)
+        return accumulateHistograms(ray, constState.histograms, constState.numHistograms, mutableState.histogramBins, constState.objectRecordMask,
+                                    ray.object_id);
+
+    if (mutableState.numAppendedEvents)
+        return appendRay(mutableState.numAppendedEvents, constState.appendEventsCapacity, mutableState.events, ray, constState.objectRecordMask,
+                         ray.object_id, constState.attrRecordMask);
+
+    return storeRay(getRecordIndex(gid, recordIndex, constState.outputEventsGridStride), mutableState.storedFlags, mutableState.events, ray,
+                    constState.objectRecordMask, ray.object_id, constState.attrRecordMask);
+}
+
+// moves the ray onto its collision with the element of a sequential beamline, applies the behaviour of the element and records the event
+RAYX_FN_ACC
+void hitElementSequential(const int gid, const int elementIndex, const CollisionPoint& __restrict col, detail::Ray& __restrict ray,
+                          const ConstState& __restrict constState, MutableState& __restrict mutableState) {
+    const auto& element = constState.elements[elementIndex];
+
+    const auto col_optical_distance = glm::length(ray.position - col.hitpoint);
+    ray.optical_path_length += col_optical_distance;
+    ray.electric_field = advanceElectricField(ray.electric_field, energyToWaveLength(ray.energy), col_optical_distance);
+    ray.position       = col.hitpoint;
+    ray.object_id      = constState.numSources + elementIndex;
+    ray.event_type     = EventType::HitElement;
+
+    behave(ray, col, element, constState.coatingLayers, constState.reflectivityTables, constState.diffractionTable, constState.materialIndices,
+           constState.materialTable);
+
+    assertObjectIdInBounds(ray.object_id, constState.numSources + constState.numElements);
+    const auto stored = recordEvent(gid, ray.object_id, ray, constState, mutableState);
+    ray.path_event_id += stored ? 1 : 0;
+}
+
+}  // unnamed namespace
+
 RAYX_FN_ACC
 void traceSequential(const int gid, const ConstState& __restrict constState, MutableState& __restrict mutableState) {
     auto ray = loadRay(gid, constState.rays);
@@ -18,8 +64,7 @@ void traceSequential(const int gid, const ConstState& __restrict constState, Mut
     // ray_path_id does not overlap, because it was incremented
     ++ray.path_event_id;
 
-    const auto stored = storeRay(getRecordIndex(gid, 0, constState.outputEventsGridStride), mutableState.storedFlags, mutableState.events, ray,
-                                 constState.objectRecordMask, ray.object_id, constState.attrRecordMask);
+    const auto stored = recordEvent(gid, 0, ray, constState, mutableState);
     ray.path_event_id += stored ? 1 : 0;
 
     rayMatrixMult(constState.objectTransforms[ray.object_id].m_inTrans, ray.position, ray.direction, ray.electric_field);
@@ -27,30 +72,134 @@ void traceSequential(const int gid, const ConstState& __restrict constState, Mut
     for (int elementIndex = 0; elementIndex < constState.numElements; ++elementIndex) {
         if (isRayTerminated(ray.event_type)) break;
 
-        const auto element = constState.elements[elementIndex];
+        const auto& element = constState.elements[elementIndex];
 
-        rayMatrixMult(constState.objectTransforms[elementIndex + constState.numSources].m_inTrans, ray.position, ray.direction, ray.electric_field);
+        // one hop from the coordinates of the previous element (or world coordinates) to the coordinates of this element
+        rayMatrixMult(constState.sequentialTransforms[elementIndex], ray.position, ray.direction, ray.electric_field);
 
         const auto col = findCollisionInElementCoords(ray.position, ray.direction, element, ray.rand);
 
         // no element was hit. tracing is done!
         if (!col) break;
 
-        const auto col_optical_distance = glm::length(ray.position - col->hitpoint);
-        ray.optical_path_length += col_optical_distance;
-        ray.electric_field = advanceElectricField(ray.electric_field, energyToWaveLength(ray.energy), col_optical_distance);
-        ray.position       = col->hitpoint;
-        ray.object_id      = constState.numSources + elementIndex;
-        ray.event_type     = EventType::HitElement;
+        hitElementSequential(gid, elementIndex, *col, ray, constState, mutableState);
+    }
+}
+
+RAYX_FN_ACC
+void traceSequentialPacket(const int packetIndex, const int n, const ConstState& __restrict constState, MutableState& __restrict mutableState) {
+    const auto gidBegin = packetIndex * RAY_PACKET_SIZE;
+    const auto& rays    = constState.rays;
 
-        behave(ray, *col, element, constState.materialIndices, constState.materialTable);
+    RayPacket packet;
+    detail::Ray lanes[RAY_PACKET_SIZE];
+    int objectIds[RAY_PACKET_SIZE];
 
+    // load positions and directions straight from the columns of the rays. lanes beyond the end of the batch load the last ray and stay masked
+    RAYX_SIMD_LOOP
+    for (int lane = 0; lane < RAY_PACKET_SIZE; ++lane) {
+        const auto gid           = glm::min(gidBegin + lane, n - 1);
+        packet.active[lane]      = gidBegin + lane < n;
+        packet.position_x[lane]  = rays.position_x[gid];
+        packet.position_y[lane]  = rays.position_y[gid];
+        packet.position_z[lane]  = rays.position_z[gid];
+        packet.direction_x[lane] = rays.direction_x[gid];
+        packet.direction_y[lane] = rays.direction_y[gid];
+        packet.direction_z[lane] = rays.direction_z[gid];
+        objectIds[lane]          = rays.object_id[gid];
+    }
+
+    // the lanes hold the remaining attributes, which only the per lane steps of traceSequential use
+    for (int lane = 0; lane < RAY_PACKET_SIZE; ++lane) {
+        if (!packet.active[lane]) continue;
+
+        const auto gid = gidBegin + lane;
+
+        lanes[lane] = detail::Ray{
+            .position            = packet.position(lane),
+            .direction           = packet.direction(lane),
+            .energy              = rays.energy[gid],
+            .optical_path_length = rays.optical_path_length[gid],
+            .electric_field      = rays.electric_field(gid),
+            .rand                = Rand(rays.rand_counter[gid]),
+            .path_id             = rays.path_id[gid],
+            .path_event_id       = rays.path_event_id[gid],
+            .order               = rays.order[gid],
+            .object_id           = objectIds[lane],
+            .source_id           = rays.source_id[gid],
+            .event_type          = rays.event_type[gid],
+        };
+
+        auto& ray = lanes[lane];
         assertObjectIdInBounds(ray.object_id, constState.numSources + constState.numElements);
-        const auto stored = storeRay(getRecordIndex(gid, ray.object_id, constState.outputEventsGridStride), mutableState.storedFlags,
-                                     mutableState.events, ray, constState.objectRecordMask, ray.object_id, constState.attrRecordMask);
+        // TODO: see above (traceSequential)
+        ++ray.path_event_id;
+
+        const auto stored = recordEvent(gid, 0, ray, constState, mutableState);
         ray.path_event_id += stored ? 1 : 0;
+    }
+
+    // from world coordinates to the coordinates of the source of each lane
+    RAYX_SIMD_LOOP
+    for (int lane = 0; lane < RAY_PACKET_SIZE; ++lane) {
+        auto position  = packet.position(lane);
+        auto direction = packet.direction(lane);
+        rayMatrixMult(constState.objectTransforms[objectIds[lane]].m_inTrans, position, direction);
+        packet.position(lane, position);
+        packet.direction(lane, direction);
+    }
+
+    for (int lane = 0; lane < RAY_PACKET_SIZE; ++lane) {
+        if (!packet.active[lane]) continue;
+
+        const auto linear          = glm::dmat3(constState.objectTransforms[objectIds[lane]].m_inTrans);
+        lanes[lane].electric_field = linear * lanes[lane].electric_field;
+    }
 
-        rayMatrixMult(constState.objectTransforms[elementIndex + constState.numSources].m_outTrans, ray.position, ray.direction, ray.electric_field);
+    for (int elementIndex = 0; elementIndex < constState.numElements; ++elementIndex) {
+        auto anyActive = false;
+        for (int lane = 0; lane < RAY_PACKET_SIZE; ++lane) {
+            packet.active[lane] = packet.active[lane] && !isRayTerminated(lanes[lane].event_type);
+            anyActive |= packet.active[lane];
+        }
+        if (!anyActive) break;
+
+        const auto& element   = constState.elements[elementIndex];
+        const auto& transform = constState.sequentialTransforms[elementIndex];
+
+        // one hop from the coordinates of the previous element (or world coordinates) to the coordinates of this element
+        RAYX_SIMD_LOOP
+        for (int lane = 0; lane < RAY_PACKET_SIZE; ++lane) {
+            auto position  = packet.position(lane);
+            auto direction = packet.direction(lane);
+            rayMatrixMult(transform, position, direction);
+            packet.position(lane, position);
+            packet.direction(lane, direction);
+        }
+
+        const auto linear = glm::dmat3(transform);
+        for (int lane = 0; lane < RAY_PACKET_SIZE; ++lane)
+            if (packet.active[lane]) lanes[lane].electric_field = linear * lanes[lane].electric_field;
+
+        PacketCollisions cols;
+        findCollisionsInElementCoords(packet, element, lanes, cols);
+
+        for (int lane = 0; lane < RAY_PACKET_SIZE; ++lane) {
+            if (!packet.active[lane]) continue;
+
+            // no element was hit. tracing of this lane is done!
+            if (!cols.hit[lane]) {
+                packet.active[lane] = false;
+                continue;
+            }
+
+            auto& ray     = lanes[lane];
+            ray.position  = packet.position(lane);
+            ray.direction = packet.direction(lane);
+            hitElementSequential(gidBegin + lane, elementIndex, cols.collision(lane), ray, constState, mutableState);
+            packet.position(lane, ray.position);
+            packet.direction(lane, ray.direction);
+        }
     }
 }
 
@@ -61,8 +210,7 @@ void traceNonSequential(const int gid, const ConstState& __restrict constState,
     // TODO: see above (traceSequential)
     ++ray.path_event_id;
 
-    const auto stored = storeRay(getRecordIndex(gid, 0, constState.outputEventsGridStride), mutableState.storedFlags, mutableState.events, ray,
-                                 constState.objectRecordMask, ray.object_id, constState.attrRecordMask);
+    const auto stored = recordEvent(gid, 0, ray, constState, mutableState);
     ray.path_event_id += stored ? 1 : 0;
 
     // TODO: object_id from previous beamline is not correct for this beamline
@@ -72,12 +220,13 @@ void traceNonSequential(const int gid, const ConstState& __restrict constState,
         if (isRayTerminated(ray.event_type)) break;
 
         const auto col = findCollisionWithElements(ray.position, ray.direction, constState.elements, constState.objectTransforms,
-                                                   constState.numSources, constState.numElements, ray.rand);
+                                                   constState.elementBvhNodes, constState.numElementBvhNodes, constState.numSources,
+                                                   constState.numElements, ray.rand);
 
         // no element was hit. tracing is done!
         if (!col) break;
 
-        const auto element = constState.elements[col->elementIndex];
+        const auto& element = constState.elements[col->elementIndex];
         rayMatrixMult(constState.objectTransforms[col->elementIndex + constState.numSources].m_inTrans, ray.position, ray.direction,
                       ray.electric_field);
 
@@ -88,20 +237,20 @@ void traceNonSequential(const int gid, const ConstState& __restrict constState,
         ray.object_id      = constState.numSources + col->elementIndex;
         ray.event_type     = EventType::HitElement;
 
-        behave(ray, col->point, element, constState.materialIndices, constState.materialTable);
+        behave(ray, col->point, element, constState.coatingLayers, constState.reflectivityTables, constState.diffractionTable,
+               constState.materialIndices, constState.materialTable);
 
         // check if the number of events exceed capacity. if so, set event type to TooManyEvents
         if (hitIndex == constState.maxEvents - 1 && !isRayTerminated(ray.event_type)) {
             // still something to hit?
-            if (findCollisionWithElements(ray.position, ray.direction, constState.elements, constState.objectTransforms, constState.numSources,
-                                          constState.numElements, ray.rand))
+            if (findCollisionWithElements(ray.position, ray.direction, constState.elements, constState.objectTransforms, constState.elementBvhNodes,
+                                          constState.numElementBvhNodes, constState.numSources, constState.numElements, ray.rand))
                 ray.event_type = EventType::TooManyEvents;
         }
 
         const auto recordIndex = hitIndex + 1;  // add 1 because one source event has potentially been stored already
         assertObjectIdInBounds(ray.object_id, constState.numSources + constState.numElements);
-        const auto stored = storeRay(getRecordIndex(gid, recordIndex, constState.outputEventsGridStride), mutableState.storedFlags,
-                                     mutableState.events, ray, constState.objectRecordMask, ray.object_id, constState.attrRecordMask);
+        const auto stored = recordEvent(gid, recordIndex, ray, constState, mutableState);
         ray.path_event_id += stored ? 1 : 0;
 
         rayMatrixMult(constState.objectTransforms[col->elementIndex + constState.numSources].m_outTrans, ray.position, ray.direction,
@@ -2,10 +2,17 @@
 
 #include "Core.h"
 #include "InvocationState.h"
+#include "RayPacket.h"
 
 namespace rayx {
 
 RAYX_FN_ACC void traceSequential(const int gid, const ConstState& __restrict constState, MutableState& __restrict mutableState);
+
+/// traces the packet of rays [packetIndex * RAY_PACKET_SIZE, (packetIndex + 1) * RAY_PACKET_SIZE) of `n` rays sequentially, with the transforms and
+/// plane and quadric collisions in SIMD lanes. records the same events as traceSequential for each ray of the packet
+RAYX_FN_ACC void traceSequentialPacket(const int packetIndex, const int n, const ConstState& __restrict constState,
+                                       MutableState& __restrict mutableState);
+
 RAYX_FN_ACC void traceNonSequential(const int gid, const ConstState& __restrict constState, MutableState& __restrict mutableState);
 
 }  // namespace rayx
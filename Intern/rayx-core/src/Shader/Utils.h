@@ -33,4 +33,20 @@ inline void RAYX_API rayMatrixMult(const glm::dmat4& __restrict m, glm::dvec3& _
     rayElectricField = glm::dmat3(m) * rayElectricField;
 }
 
+// overloads for compact affine transformations (3x4, see AffineTransform)
+RAYX_FN_ACC
+inline void RAYX_API rayMatrixMult(const glm::dmat4x3& __restrict m, glm::dvec3& __restrict rayPosition, glm::dvec3& __restrict rayDirection) {
+    rayPosition  = m * glm::dvec4(rayPosition, 1);
+    rayDirection = glm::dmat3(m) * rayDirection;
+}
+
+RAYX_FN_ACC
+inline void RAYX_API rayMatrixMult(const glm::dmat4x3& __restrict m, glm::dvec3& __restrict rayPosition, glm::dvec3& __restrict rayDirection,
+                                   ElectricField& __restrict rayElectricField) {
+    const auto linear = glm::dmat3(m);
+    rayPosition       = m * glm::dvec4(rayPosition, 1);
+    rayDirection      = linear * rayDirection;
+    rayElectricField  = linear * rayElectricField;
+}
+
 }  // namespace rayx
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "Rays.h"
+
+namespace rayx {
+namespace {
+
+/**
+ * @brief Transfers the events of batches to the host on a single long-lived thread, while the tracing thread continues with the next batches.
+ * Transfers run in order of requests. At most `maxPendingTransfers` transfers are pending (requested but not yet taken) at once, further requests
+ * block until the oldest transferred batch was taken. The transfer functions do not log, so that all log lines stem from the tracing thread.
+ * Exceptions thrown by a transfer function are rethrown by `take`. Pending transfers are finished by the destructor.
+ */
+class BatchTransferThread {
+  public:
+    using TransferFn = std::function<Rays()>;
+
+    explicit BatchTransferThread(const int maxPendingTransfers) : m_maxPendingTransfers(maxPendingTransfers), m_thread([this] { run(); }) {}
+
+    ~BatchTransferThread() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        m_thread.join();
+    }
+
+    BatchTransferThread(const BatchTransferThread&)            = delete;
+    BatchTransferThread& operator=(const BatchTransferThread&) = delete;
+
+    /// enqueues a transfer. blocks while `maxPendingTransfers` transfers are pending
+    void request(TransferFn transfer) {
+        std::unique_lock lock(m_mutex);
+        m_cv.wait(lock, [&] { return m_numPendingTransfers < m_maxPendingTransfers; });
+        m_requests.push_back(std::move(transfer));
+        ++m_numPendingTransfers;
+        lock.unlock();
+        m_cv.notify_all();
+    }
+
+    /// takes the events of the oldest pending transfer. blocks until the transfer is done
+    Rays take() {
+        std::unique_lock lock(m_mutex);
+        m_cv.wait(lock, [&] { return !m_results.empty(); });
+        auto result = std::move(m_results.front());
+        m_results.pop_front();
+        --m_numPendingTransfers;
+        lock.unlock();
+        m_cv.notify_all();
+
+        if (result.error) std::rethrow_exception(result.error);
+        return std::move(result.rays);
+    }
+
+  private:
+    struct Result {
+        Rays rays;
+        std::exception_ptr error;
+    };
+
+    void run() {
+        std::unique_lock lock(m_mutex);
+
+        while (true) {
+            m_cv.wait(lock, [&] { return m_stop || !m_requests.empty(); });
+            if (m_requests.empty()) return;  // stopped and all requested transfers are done
+
+            auto transfer = std::move(m_requests.front());
+            m_requests.pop_front();
+            lock.unlock();
+
+            auto result = Result{};
+            try {
+                result.rays = transfer();
+            } catch (...) { result.error = std::current_exception(); }
+
+            lock.lock();
+            m_results.push_back(std::move(result));
+            m_cv.notify_all();
+        }
+    }
+
+    const int m_maxPendingTransfers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;  // notifies of requests, results, taken results and shutdown
+    std::deque<TransferFn> m_requests;
+    std::deque<Result> m_results;
+    int m_numPendingTransfers = 0;
+    bool m_stop               = false;
+
+    std::thread m_thread;  // started last, after all members are initialized
+};
+
+}  // unnamed namespace
+}  // namespace rayx
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cstring>
+#include <functional>
+#include <optional>
 #include <vector>
 
 #include "Core.h"
@@ -10,6 +12,21 @@
 
 namespace rayx {
 
+// this value is picked in a 'good' way if it can divide number of rays without rest. for a number of rays picked by humans, this
+// value is probably good. though, if it could be power of two, the shader would benefit
+constexpr int DEFAULT_BATCH_SIZE = 100000;
+
+/// receives the recorded events of one batch as soon as they are available on the host. batches are passed in order of tracing
+using RaysSink = std::function<void(Rays&&)>;
+
+/// a histogram accumulated by Tracer::traceHistograms
+struct RAYX_API Histogram {
+    HistogramConfig config;
+    std::vector<double> bins;  ///< sum of the weights of the events per bin, in row-major order of (y, x)
+
+    double bin(const int x, const int y = 0) const { return bins[y * config.x.numBins + x]; }
+};
+
 /**
  * @brief DeviceTracer is an interface to a tracer implementation
  * we need this interface to remove the actual implementation from the rayx api
@@ -18,8 +35,14 @@ class RAYX_API DeviceTracer {
   public:
     virtual ~DeviceTracer() = default;
 
-    virtual Rays trace(const Group& beamline, Sequential sequential, const ObjectIndexMask& objectRecordMask, const RayAttrMask attrRecordMask,
-                       const int maxEvents, const int maxBatchSize) = 0;
+    virtual void traceStreaming(const Group& beamline, Sequential sequential, const ObjectIndexMask& objectRecordMask,
+                                const RayAttrMask attrRecordMask, const int maxEvents, const std::optional<int> maxBatchSize,
+                                const std::vector<EventFilter>& eventFilters, const RaysSink& sink) = 0;
+
+    virtual std::vector<Histogram> traceHistograms(const Group& beamline, Sequential sequential, const ObjectIndexMask& objectRecordMask,
+                                                   const int maxEvents, const std::optional<int> maxBatchSize,
+                                                   const std::vector<EventFilter>& eventFilters,
+                                                   const std::vector<HistogramConfig>& histograms) = 0;
 };
 
 }  // namespace rayx
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <alpaka/alpaka.hpp>
+#include <array>
 
 #include "Beamline/Beamline.h"
 #include "Beamline/StringConversion.h"
@@ -26,7 +27,7 @@ struct GenRaysKernel {
     // DipoleSource
     template <typename Acc>
     RAYX_FN_ACC void operator()(const Acc& __restrict acc, RaysPtr dstRays, const int startRayIndexBatch, const DipoleSource source,
-                                const int sourceId, const int startRayIndex, const int numRaysTotal, const double seed, const int n) const {
+                                const int sourceId, const int64_t startRayIndex, const int64_t numRaysTotal, const double seed, const int n) const {
         const auto gid = alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0];
 
         if (gid < n) {
@@ -57,7 +58,7 @@ struct GenRaysKernel {
     // other sources
     template <typename Acc, typename Source>
     RAYX_FN_ACC void operator()(const Acc& __restrict acc, RaysPtr dstRays, const int startRayIndexBatch, const Source source, const int sourceId,
-                                const EnergyDistributionDataVariant energyDistribution, const int startRayIndex, const int numRaysTotal,
+                                const EnergyDistributionDataVariant energyDistribution, const int64_t startRayIndex, const int64_t numRaysTotal,
                                 const double seed, const int n) const {
         const auto gid = alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0];
 
@@ -77,7 +78,7 @@ template <typename Acc>
 struct GenRays {
     /// holds configuration state of sources
     struct SourceConfig {
-        int numRaysTotal;
+        int64_t numRaysTotal;
         int numRaysBatchAtMost;
         int numBatches;
     };
@@ -98,14 +99,25 @@ struct GenRays {
         m_startRayIndex = 0;
 
         auto rayListSourcesIndex = 0;
+        auto dipoleSourcesIndex  = 0;
         const auto compileSource = [&, this](const DesignSource& designSource) -> std::optional<SourceVariant> {
             switch (designSource.getType()) {
                 case ElementType::PointSource:
                     return PointSource(designSource);
                 case ElementType::MatrixSource:
                     return MatrixSource(designSource);
-                case ElementType::DipoleSource:
-                    return DipoleSource(designSource);
+                case ElementType::DipoleSource: {
+                    // upload the sampling table of the source and let the source reference it
+                    auto source      = DipoleSource(designSource);
+                    const auto index = dipoleSourcesIndex++;
+                    const auto table = source.calcSamplingTable();
+                    const auto size  = static_cast<int>(table.size());
+                    if (static_cast<int>(d_dipoleSamplingTables.size()) <= index) d_dipoleSamplingTables.emplace_back();
+                    allocBuf(q, d_dipoleSamplingTables[index], size);
+                    alpaka::memcpy(q, *d_dipoleSamplingTables[index], alpaka::createView(devHost, table, size), size);
+                    source.setSamplingTable(alpaka::getPtrNative(*d_dipoleSamplingTables[index]));
+                    return source;
+                }
                 case ElementType::PixelSource:
                     return PixelSource(designSource);
                 case ElementType::CircleSource:
@@ -186,14 +198,13 @@ struct GenRays {
                 designSource.getEnergyDistribution());
         };
 
-        m_numRaysTotal      = 0;
-        auto numRaysSources = std::vector<int>();
-        auto sourceId       = static_cast<int>(0);
+        m_numRaysTotal = 0;
+        auto sourceId  = static_cast<int>(0);
 
         for (const auto* designSource : beamline.getSources()) {
             const auto source             = *compileSource(*designSource);
             const auto energyDistribution = compileEnergyDistribution(*designSource);
-            const auto numRaysSource      = static_cast<int>(designSource->getNumberOfRays());
+            const auto numRaysSource      = static_cast<int64_t>(designSource->getNumberOfRays());
             m_numRaysTotal += numRaysSource;
 
             m_sourceStates.push_back(SourceState{
@@ -208,14 +219,17 @@ struct GenRays {
             ++sourceId;
         }
 
-        m_numRaysBatchAtMost = std::min(m_numRaysTotal, maxBatchSize);
+        m_numRaysBatchAtMost = static_cast<int>(std::min(m_numRaysTotal, static_cast<int64_t>(maxBatchSize)));
 
-#define X(type, name, flag) allocBuf(q, d_rays.name, m_numRaysBatchAtMost);
+        // one set of generated rays per batch buffer, so that rays of the next batch can be generated while the current batch is traced
+        for (auto& d_raysBuffer : d_rays) {
+#define X(type, name, flag) allocBuf(q, d_raysBuffer.name, m_numRaysBatchAtMost);
 
-        RAYX_X_MACRO_RAY_ATTR
+            RAYX_X_MACRO_RAY_ATTR
 #undef X
+        }
 
-        const auto numBatches = m_numRaysBatchAtMost ? ceilIntDivision(m_numRaysTotal, m_numRaysBatchAtMost) : 0;
+        const auto numBatches = m_numRaysBatchAtMost ? static_cast<int>((m_numRaysTotal + m_numRaysBatchAtMost - 1) / m_numRaysBatchAtMost) : 0;
 
         m_seed = randomDouble();
 
@@ -226,17 +240,21 @@ struct GenRays {
         };
     }
 
+    /// generates the rays of batch `batchIndex` into the batch buffer `bufferIndex`. batches must be generated in order
     template <typename DevAcc, typename Queue>
-    BatchConfig genRaysBatch(DevAcc devAcc, Queue q, const int batchIndex) {
+    BatchConfig genRaysBatch(DevAcc devAcc, Queue q, const int batchIndex, const int bufferIndex) {
         RAYX_PROFILE_FUNCTION_STDOUT();
 
-        const auto batchStartRayIndex    = batchIndex * m_numRaysBatchAtMost;
+        auto& d_raysBuffer = d_rays[bufferIndex];
+
+        // ray indices of all batches exceed int, ray indices within a batch do not
+        const auto batchStartRayIndex    = static_cast<int64_t>(batchIndex) * m_numRaysBatchAtMost;
         const auto numRaysTotalRemaining = m_numRaysTotal - batchStartRayIndex;
-        const auto numRaysBatch          = std::min(numRaysTotalRemaining, m_numRaysBatchAtMost);
+        const auto numRaysBatch          = static_cast<int>(std::min(numRaysTotalRemaining, static_cast<int64_t>(m_numRaysBatchAtMost)));
         auto numRaysBatchRemaining       = numRaysBatch;
 
         for (auto& sourceState : m_sourceStates) {
-            const auto numRaysBatchSource  = std::min(numRaysBatchRemaining, sourceState.numRaysSourceRemaining);
+            const auto numRaysBatchSource  = static_cast<int>(std::min<int64_t>(numRaysBatchRemaining, sourceState.numRaysSourceRemaining));
             const auto startRayIndexSource = sourceState.numRaysSource - sourceState.numRaysSourceRemaining;
 
             if (numRaysBatchSource) {
@@ -251,21 +269,21 @@ struct GenRays {
                         // DipoleSource
                         if constexpr (std::is_same_v<Source, DipoleSource>) {
                             execWithValidWorkDiv<Acc>(devAcc, q, numRaysBatchSource, BlockSizeConstraint::None{}, GenRaysKernel{},
-                                                      raysBufToRaysPtr(d_rays), startRayIndexBatch, source, sourceState.sourceId, m_startRayIndex,
-                                                      m_numRaysTotal, m_seed, numRaysBatchSource);
+                                                      raysBufToRaysPtr(d_raysBuffer), startRayIndexBatch, source, sourceState.sourceId,
+                                                      m_startRayIndex, m_numRaysTotal, m_seed, numRaysBatchSource);
                         }
 
                         // RayListSource
                         else if constexpr (std::is_same_v<Source, RayListSource>) {
                             execWithValidWorkDiv<Acc>(devAcc, q, numRaysBatchSource, BlockSizeConstraint::None{}, GenRaysKernel{},
-                                                      raysBufToRaysPtr(d_rays), startRayIndexBatch, source, sourceState.sourceId, startRayIndexSource,
-                                                      numRaysBatchSource);
+                                                      raysBufToRaysPtr(d_raysBuffer), startRayIndexBatch, source, sourceState.sourceId,
+                                                      static_cast<int>(startRayIndexSource), numRaysBatchSource);
                         }
 
                         // other sources
                         else {
                             execWithValidWorkDiv<Acc>(devAcc, q, numRaysBatchSource, BlockSizeConstraint::None{}, GenRaysKernel{},
-                                                      raysBufToRaysPtr(d_rays), startRayIndexBatch, source, sourceState.sourceId,
+                                                      raysBufToRaysPtr(d_raysBuffer), startRayIndexBatch, source, sourceState.sourceId,
                                                       *sourceState.energyDistribution, m_startRayIndex, m_numRaysTotal, m_seed, numRaysBatchSource);
                         }
                     },
@@ -280,17 +298,20 @@ struct GenRays {
 
         return BatchConfig{
             .numRaysBatch = numRaysBatch,
-            .d_rays       = d_rays,
+            .d_rays       = d_raysBuffer,
         };
     }
 
   private:
     // resources per batch. constant per batch
-    /// generated rays
-    RaysBuf<Acc> d_rays;
+    /// generated rays, one set per batch buffer
+    std::array<RaysBuf<Acc>, NUM_BATCH_BUFFERS> d_rays;
 
     std::vector<RaysBuf<Acc>> d_rayListSources;
 
+    // sampling tables of DipoleSources
+    std::vector<OptBuf<Acc, double>> d_dipoleSamplingTables;
+
     // buffers for EnergyDistributionList (DatFile)
     std::vector<OptBuf<Acc, double>> d_energyDistributionListWeights;
     std::vector<OptBuf<Acc, double>> d_energyDistributionListEnergies;
@@ -301,14 +322,14 @@ struct GenRays {
         const SourceVariant source;
         const int sourceId;
         const std::optional<EnergyDistributionDataVariant> energyDistribution;
-        int numRaysSource;
-        int numRaysSourceRemaining;
+        int64_t numRaysSource;
+        int64_t numRaysSourceRemaining;
         std::string name;
     };
 
     std::vector<SourceState> m_sourceStates;
-    int m_startRayIndex;
-    int m_numRaysTotal;
+    int64_t m_startRayIndex;
+    int64_t m_numRaysTotal;
     int m_numRaysBatchAtMost;
     double m_seed;
 };
@@ -1,15 +1,22 @@
 #pragma once
 
+#include <algorithm>
+#include <limits>
 #include <numeric>
 #include <set>
 
+#include "BatchTransferThread.h"
 #include "Beamline/Beamline.h"
 #include "Debug/Instrumentor.h"
 #include "DeviceTracer.h"
+#include "Element/ReflectivityTable.h"
 #include "GenRays.h"
 #include "Material/Material.h"
+#include "Material/RefractiveIndexLut.h"
 #include "Random.h"
+#include "Shader/Diffraction.h"
 #include "Shader/Trace.h"
+#include "TracerConfig.h"
 #include "Util.h"
 
 namespace rayx {
@@ -18,37 +25,303 @@ namespace {
 constexpr int WARP_SIZE            = 32;
 constexpr int GRID_STRIDE_MULTIPLE = WARP_SIZE;
 
+/// histograms are accumulated into one of several replicas of their bins, picked by the block index, to spread the atomic additions of the blocks.
+/// the bins of the histograms easily exceed shared memory, so the replicas reside in global memory
+template <typename Acc>
+RAYX_FN_ACC void selectHistogramReplica(const Acc& __restrict acc, const ConstState& constState, MutableState& mutableState) {
+    if (!mutableState.histogramBins) return;
+
+    const auto blockIndex = alpaka::getIdx<alpaka::Grid, alpaka::Blocks>(acc)[0];
+    mutableState.histogramBins += (blockIndex % constState.numHistogramReplicas) * constState.numHistogramBins;
+}
+
 struct TraceSequentialKernel {
     template <typename Acc>
     RAYX_FN_ACC void operator()(const Acc& __restrict acc, const ConstState constState, MutableState mutableState, const int n) const {
         const auto gid = alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0];
+        selectHistogramReplica(acc, constState, mutableState);
 
         if (gid < n) traceSequential(gid, constState, mutableState);
     }
 };
 
+/// traces a packet of RAY_PACKET_SIZE rays per thread. only used on CPU
+struct TraceSequentialPacketKernel {
+    template <typename Acc>
+    RAYX_FN_ACC void operator()(const Acc& __restrict acc, const ConstState constState, MutableState mutableState, const int n) const {
+        const auto packetIndex = alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0];
+        selectHistogramReplica(acc, constState, mutableState);
+
+        if (packetIndex * RAY_PACKET_SIZE < n) traceSequentialPacket(packetIndex, n, constState, mutableState);
+    }
+};
+
 struct TraceNonSequentialKernel {
     template <typename Acc>
     RAYX_FN_ACC void operator()(const Acc& __restrict acc, const ConstState constState, MutableState mutableState, const int n) const {
         const auto gid = alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0];
+        selectHistogramReplica(acc, constState, mutableState);
 
         if (gid < n) traceNonSequential(gid, constState, mutableState);
     }
 };
 
-struct ScatterCompactKernel {
-    template <typename Acc, typename T>
-    RAYX_FN_ACC void operator()(const Acc& __restrict acc, T* __restrict dst, const T* __restrict src, const int* __restrict prefix,
-                                const bool* __restrict flags, const int n) const {
+/// sums up all replicas of the histogram bins into the first replica
+struct MergeHistogramReplicasKernel {
+    template <typename Acc>
+    RAYX_FN_ACC void operator()(const Acc& __restrict acc, double* __restrict bins, const int numBins, const int numReplicas) const {
         const auto gid = alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0];
 
-        if (gid < n && flags[gid]) {
-            const auto index = prefix[gid];
-            dst[index]       = src[gid];
+        if (gid < numBins) {
+            auto sum = bins[gid];
+            for (int replica = 1; replica < numReplicas; ++replica) sum += bins[replica * numBins + gid];
+            bins[gid] = sum;
         }
     }
 };
 
+/// the device side scan and compaction process the values in tiles of SCAN_TILE_SIZE values, one tile per block at a time. a block loads its tile
+/// into shared memory with coalesced accesses, scans it cooperatively and stores or scatters it with coalesced accesses again. blocks have at most
+/// SCAN_BLOCK_SIZE threads. on CPU accelerators, blocks have a single thread, which handles the whole tile
+constexpr int SCAN_TILE_SIZE  = 1024;
+constexpr int SCAN_BLOCK_SIZE = 256;
+
+/// exclusive scan of a tile in shared memory by all threads of the block. each thread scans a contiguous run of the tile, the sums of the runs are
+/// scanned with a Hillis-Steele scan. returns the sum of the tile to all threads. must be called by all threads of the block
+template <typename Acc>
+RAYX_FN_ACC int blockExclusiveScan(const Acc& __restrict acc, int* __restrict tile, int* __restrict runSums) {
+    const auto tid            = static_cast<int>(alpaka::getIdx<alpaka::Block, alpaka::Threads>(acc)[0]);
+    const auto numThreads     = static_cast<int>(alpaka::getWorkDiv<alpaka::Block, alpaka::Threads>(acc)[0]);
+    const auto itemsPerThread = (SCAN_TILE_SIZE + numThreads - 1) / numThreads;
+    const auto begin          = glm::min(tid * itemsPerThread, SCAN_TILE_SIZE);
+    const auto end            = glm::min(begin + itemsPerThread, SCAN_TILE_SIZE);
+
+    auto sum = 0;
+    for (int i = begin; i < end; ++i) sum += tile[i];
+    runSums[tid] = sum;
+    alpaka::syncBlockThreads(acc);
+
+    // inclusive scan of the sums of the runs
+    for (int stride = 1; stride < numThreads; stride *= 2) {
+        const auto value = tid >= stride ? runSums[tid - stride] : 0;
+        alpaka::syncBlockThreads(acc);
+        runSums[tid] += value;
+        alpaka::syncBlockThreads(acc);
+    }
+
+    auto offset = runSums[tid] - sum;
+    for (int i = begin; i < end; ++i) {
+        const auto value = tile[i];
+        tile[i]          = offset;
+        offset += value;
+    }
+
+    const auto tileSum = runSums[numThreads - 1];
+    alpaka::syncBlockThreads(acc);
+    return tileSum;
+}
+
+/// sums up each tile of values
+struct SumTilesKernel {
+    template <typename Acc, typename T>
+    RAYX_FN_ACC void operator()(const Acc& __restrict acc, int* __restrict tileSums, const T* __restrict values, const int n,
+                                const int numTiles) const {
+        const auto tid        = static_cast<int>(alpaka::getIdx<alpaka::Block, alpaka::Threads>(acc)[0]);
+        const auto numThreads = static_cast<int>(alpaka::getWorkDiv<alpaka::Block, alpaka::Threads>(acc)[0]);
+        const auto blockIndex = static_cast<int>(alpaka::getIdx<alpaka::Grid, alpaka::Blocks>(acc)[0]);
+        const auto numBlocks  = static_cast<int>(alpaka::getWorkDiv<alpaka::Grid, alpaka::Blocks>(acc)[0]);
+        auto& sums            = alpaka::declareSharedVar<int[SCAN_BLOCK_SIZE], __COUNTER__>(acc);
+
+        for (int tile = blockIndex; tile < numTiles; tile += numBlocks) {
+            const auto begin = tile * SCAN_TILE_SIZE;
+            const auto end   = glm::min(begin + SCAN_TILE_SIZE, n);
+
+            auto sum = 0;
+            for (int i = begin + tid; i < end; i += numThreads) sum += static_cast<int>(values[i]);
+            sums[tid] = sum;
+            alpaka::syncBlockThreads(acc);
+
+            // tree reduction of the sums of the threads
+            for (int active = numThreads; active > 1;) {
+                const auto half = (active + 1) / 2;
+                if (tid < active - half) sums[tid] += sums[tid + half];
+                alpaka::syncBlockThreads(acc);
+                active = half;
+            }
+
+            if (tid == 0) tileSums[tile] = sums[0];
+            alpaka::syncBlockThreads(acc);
+        }
+    }
+};
+
+/// exclusive scan of each tile of values in place, starting at the offset of the tile (or zero if no offsets are given).
+/// if `total` is given, the last tile writes the sum of all values to it
+struct ExclusiveScanTilesKernel {
+    template <typename Acc>
+    RAYX_FN_ACC void operator()(const Acc& __restrict acc, int* __restrict values, const int* __restrict tileOffsets, int* __restrict total,
+                                const int n, const int numTiles) const {
+        const auto tid        = static_cast<int>(alpaka::getIdx<alpaka::Block, alpaka::Threads>(acc)[0]);
+        const auto numThreads = static_cast<int>(alpaka::getWorkDiv<alpaka::Block, alpaka::Threads>(acc)[0]);
+        const auto blockIndex = static_cast<int>(alpaka::getIdx<alpaka::Grid, alpaka::Blocks>(acc)[0]);
+        const auto numBlocks  = static_cast<int>(alpaka::getWorkDiv<alpaka::Grid, alpaka::Blocks>(acc)[0]);
+        auto& scan            = alpaka::declareSharedVar<int[SCAN_TILE_SIZE], __COUNTER__>(acc);
+        auto& runSums         = alpaka::declareSharedVar<int[SCAN_BLOCK_SIZE], __COUNTER__>(acc);
+
+        for (int tile = blockIndex; tile < numTiles; tile += numBlocks) {
+            const auto begin = tile * SCAN_TILE_SIZE;
+            const auto size  = glm::min(SCAN_TILE_SIZE, n - begin);
+
+            for (int i = tid; i < SCAN_TILE_SIZE; i += numThreads) scan[i] = i < size ? values[begin + i] : 0;
+            alpaka::syncBlockThreads(acc);
+
+            const auto offset  = tileOffsets ? tileOffsets[tile] : 0;
+            const auto tileSum = blockExclusiveScan(acc, scan, runSums);
+            for (int i = tid; i < size; i += numThreads) values[begin + i] = offset + scan[i];
+
+            if (total && tile == numTiles - 1 && tid == 0) *total = offset + tileSum;
+            alpaka::syncBlockThreads(acc);
+        }
+    }
+};
+
+/// compacts all recorded attributes of stored events in a single pass. each block scans a tile of store flags, starting at the offset of the tile
+/// in the compacted output. consecutive threads read consecutive events, and stored events keep their order in the compacted output
+struct ScatterCompactEventsKernel {
+    template <typename Acc>
+    RAYX_FN_ACC void operator()(const Acc& __restrict acc, RaysPtr dst, const RaysPtr src, const RayAttrMask attrMask,
+                                const int* __restrict tileOffsets, const bool* __restrict flags, const int n, const int numTiles) const {
+        const auto tid        = static_cast<int>(alpaka::getIdx<alpaka::Block, alpaka::Threads>(acc)[0]);
+        const auto numThreads = static_cast<int>(alpaka::getWorkDiv<alpaka::Block, alpaka::Threads>(acc)[0]);
+        const auto blockIndex = static_cast<int>(alpaka::getIdx<alpaka::Grid, alpaka::Blocks>(acc)[0]);
+        const auto numBlocks  = static_cast<int>(alpaka::getWorkDiv<alpaka::Grid, alpaka::Blocks>(acc)[0]);
+        auto& scan            = alpaka::declareSharedVar<int[SCAN_TILE_SIZE], __COUNTER__>(acc);
+        auto& runSums         = alpaka::declareSharedVar<int[SCAN_BLOCK_SIZE], __COUNTER__>(acc);
+
+        for (int tile = blockIndex; tile < numTiles; tile += numBlocks) {
+            const auto begin = tile * SCAN_TILE_SIZE;
+            const auto size  = glm::min(SCAN_TILE_SIZE, n - begin);
+
+            for (int i = tid; i < SCAN_TILE_SIZE; i += numThreads) scan[i] = i < size ? static_cast<int>(flags[begin + i]) : 0;
+            alpaka::syncBlockThreads(acc);
+
+            const auto offset = tileOffsets[tile];
+            blockExclusiveScan(acc, scan, runSums);
+
+            for (int i = tid; i < size; i += numThreads) {
+                const auto srcIndex = begin + i;
+                if (!flags[srcIndex]) continue;
+
+                const auto dstIndex = offset + scan[i];
+#define X(type, name, flag) \
+    if (contains(attrMask, RayAttrMask::flag)) dst.name[dstIndex] = src.name[srcIndex];
+
+                RAYX_X_MACRO_RAY_ATTR
+#undef X
+            }
+            alpaka::syncBlockThreads(acc);
+        }
+    }
+};
+
+/// capacity of the compacted output events of a batch, if events are appended. never exceeds the number of events a batch can record
+inline int calcAppendEventsCapacity(const double numEvents, const int numEventsBatchAtMost) {
+    return static_cast<int>(std::clamp(std::ceil(numEvents), 1.0, static_cast<double>(std::max(numEventsBatchAtMost, 1))));
+}
+
+/// maximum number of replicas of the histogram bins, and the maximum number of bytes of all replicas together
+constexpr int MAX_HISTOGRAM_REPLICAS          = 16;
+constexpr size_t MAX_HISTOGRAM_REPLICAS_BYTES = 64 << 20;
+
+/// number of replicas of the histogram bins. more replicas reduce the contention of atomic additions, but cost memory and merging
+inline int calcNumHistogramReplicas(const int numBins) {
+    const auto numReplicasForBytes = MAX_HISTOGRAM_REPLICAS_BYTES / (static_cast<size_t>(std::max(numBins, 1)) * sizeof(double));
+    return static_cast<int>(std::clamp(numReplicasForBytes, size_t{1}, static_cast<size_t>(MAX_HISTOGRAM_REPLICAS)));
+}
+
+/// device and host memory needed for the buffers of a batch
+struct BatchMemory {
+    size_t device;
+    size_t host;
+};
+
+/// estimates the memory needed to trace batches of `numRaysBatch` rays. accounts for the rounding of buffer sizes in allocBuf.
+/// the events of NUM_BATCH_BUFFERS batches are held on the host at once, at most `maxEvents` events per ray (if events are appended, the expected
+/// number of events). if `recordEvents` is false, only the generated rays are accounted for
+inline BatchMemory calcBatchMemory(const int numRaysBatch, const int maxEvents, const RayAttrMask attrRecordMask, const bool recordEvents,
+                                   const TracerConfig& config) {
+    const auto bufBytes     = [](const int size, const size_t elemSize) { return static_cast<size_t>(nextPowerOfTwo(std::max(size, 1))) * elemSize; };
+    const auto raysBufBytes = [&](const RayAttrMask attrMask, const int size) {
+        auto bytes = size_t{0};
+#define X(type, name, flag) \
+    if (contains(attrMask, RayAttrMask::flag)) bytes += bufBytes(size, sizeof(type));
+
+        RAYX_X_MACRO_RAY_ATTR
+#undef X
+        return bytes;
+    };
+
+    // generated rays per batch buffer
+    auto device = NUM_BATCH_BUFFERS * raysBufBytes(RayAttrMask::All, numRaysBatch);
+    if (!recordEvents) return {.device = device, .host = 0};
+
+    const auto numEventsBatchAtMost = numRaysBatch * maxEvents;
+    const auto numEventsBatch       =
+        config.appendEvents ? calcAppendEventsCapacity(numRaysBatch * config.appendEvents->initialEventsPerRay, numEventsBatchAtMost)
+                            : numEventsBatchAtMost;
+
+    // compacted output events per batch buffer
+    device += NUM_BATCH_BUFFERS * raysBufBytes(attrRecordMask, numEventsBatch);
+
+    // output events, store flags and the device side scan of the dense recording
+    if (!config.appendEvents) {
+        const auto numEventsBatchAccountForGridStride = nextMultiple(numRaysBatch, GRID_STRIDE_MULTIPLE) * maxEvents;
+        device += raysBufBytes(attrRecordMask, numEventsBatchAccountForGridStride);
+        device += bufBytes(numEventsBatchAccountForGridStride, sizeof(bool));
+        device += bufBytes(ceilIntDivision(numEventsBatchAccountForGridStride, SCAN_TILE_SIZE), sizeof(int));
+    }
+
+    auto bytesPerEvent = size_t{0};
+#define X(type, name, flag) \
+    if (contains(attrRecordMask, RayAttrMask::flag)) bytesPerEvent += sizeof(type);
+
+    RAYX_X_MACRO_RAY_ATTR
+#undef X
+
+    return {
+        .device = device,
+        .host   = NUM_BATCH_BUFFERS * static_cast<size_t>(numEventsBatch) * bytesPerEvent,
+    };
+}
+
+/// largest batch size, a multiple of GRID_STRIDE_MULTIPLE, whose buffers fit into the available memory
+inline int calcMaxBatchSizeForMemory(const size_t deviceMemory, const size_t hostMemory, const bool deviceIsHost, const int maxEvents,
+                                     const RayAttrMask attrRecordMask, const bool recordEvents, const TracerConfig& config) {
+    const auto fits = [&](const int numRaysBatch) {
+        const auto memory = calcBatchMemory(numRaysBatch, maxEvents, attrRecordMask, recordEvents, config);
+        // on CPU devices, the buffers of device and host share the same memory
+        if (deviceIsHost) return memory.device + memory.host <= std::min(deviceMemory, hostMemory);
+        return memory.device <= deviceMemory && memory.host <= hostMemory;
+    };
+
+    // event indices must fit into int, even after allocBuf rounded the buffer sizes up to the next power of two
+    auto low  = 0;
+    auto high = (1 << 30) / maxEvents / GRID_STRIDE_MULTIPLE;
+    while (low < high) {
+        const auto mid = low + (high - low + 1) / 2;
+        if (fits(mid * GRID_STRIDE_MULTIPLE))
+            low = mid;
+        else
+            high = mid - 1;
+    }
+
+    if (low == 0) {
+        RAYX_WARN << "a batch of " << GRID_STRIDE_MULTIPLE << " rays exceeds the memory budget. tracing with this batch size anyway";
+        return GRID_STRIDE_MULTIPLE;
+    }
+    return low * GRID_STRIDE_MULTIPLE;
+}
+
 }  // unnamed namespace
 
 /// keeps track of all resources used by the tracer. manages allocation and update of buffers
@@ -62,101 +335,288 @@ struct Resources {
     /// material data
     OptBuf<Acc, int> d_materialIndices;
     OptBuf<Acc, double> d_materialTable;
+    /// material tables that are currently uploaded to the device, and the energy range of their lookup tables (if any).
+    /// used to skip the upload if neither the set of materials nor the energy range changed
+    std::shared_ptr<const MaterialTables> h_materialTables;
+    std::optional<glm::dvec2> h_refractiveIndexLutEnergyRange;
 
     // resources per beamline. constant per beamline
     /// beamline object transforms
-    OptBuf<Acc, ObjectTransform> d_objectTransforms;
+    OptBuf<Acc, AffineObjectTransform> d_objectTransforms;
+    /// precomposed transforms between consecutive elements for sequential tracing
+    OptBuf<Acc, AffineTransform> d_sequentialTransforms;
 
     /// beamline elements
     OptBuf<Acc, OpticalElement> d_elements;
 
+    /// layer table of multilayer coatings. elements reference their layers by offset and count
+    OptBuf<Acc, CoatingLayer> d_coatingLayers;
+
+    /// bounding volume hierarchy over elements, used to cull elements in non-sequential tracing
+    OptBuf<Acc, ElementBvhNode> d_elementBvhNodes;
+
+    /// precomputed reflectivity tables of coated mirrors. elements reference their table by offset
+    OptBuf<Acc, double> d_reflectivityTables;
+    /// key of the reflectivity tables that are currently uploaded to the device (if any). used to skip building and uploading the tables if
+    /// neither the coatings and materials of the elements, nor the material tables, the energy range or the table config changed
+    std::optional<ReflectivityTablesKey> h_reflectivityTablesKey;
+
+    /// inverse cdfs of the diffraction angles of slits
+    OptBuf<Acc, double> d_diffractionTable;
+
     /// mask for which elements to record events
     OptBuf<Acc, bool> d_objectRecordMask;
 
+    /// filters that decide which events to record, in addition to the object record mask
+    OptBuf<Acc, EventFilter> d_eventFilters;
+    int numEventFilters = 0;
+
     // output events per tracing. required if 'events' is enabled in output config
     /// output events from tracer kernel
     RaysBuf<Acc> d_eventsBatch;
-    /// output events, compacted for faster transfer
-    RaysBuf<Acc> d_compactEventsBatch;
+    /// output events, compacted for faster transfer. one set per batch buffer, so that the transfer of a batch overlaps with tracing the next batch
+    std::array<RaysBuf<Acc>, NUM_BATCH_BUFFERS> d_compactEventsBatch;
     /// flag for each possible ouput event, wether it was stored or not. used for compaction
     OptBuf<Acc, bool> d_eventStoreFlags;
-    OptBuf<Acc, int> d_eventStoreFlagsPrefixSum;
+    /// offset of each tile of store flags in the compacted output events (exclusive scan over the number of stored events per tile)
+    OptBuf<Acc, int> d_eventStoreFlagsTileOffsets;
+    /// partial sums of the device side scan, one buffer per level of the scan hierarchy
+    std::vector<OptBuf<Acc, int>> d_scanPartialSums;
+    /// number of stored events per batch buffer. the only value of the compaction that is transferred back to the host before the events.
+    /// if events are appended, this is the counter of the atomic append
+    std::array<OptBuf<Acc, int>, NUM_BATCH_BUFFERS> d_numEventsBatch;
+    /// capacity of the compacted output events per batch buffer, if events are appended
+    std::array<int, NUM_BATCH_BUFFERS> appendEventsCapacity{};
+
+    // histograms per tracing. required if histograms are accumulated instead of recording events
+    /// configurations of the histograms
+    OptBuf<Acc, HistogramConfig> d_histograms;
+    /// bins of all histograms, one after the other, in numReplicas replicas
+    OptBuf<Acc, double> d_histogramBins;
 
     /// holds configuration state of allocated resources. required to trace correctly
     struct BeamlineConfig {
         int numSources;
         int numElements;
+        int numElementBvhNodes;
+    };
+
+    /// holds configuration state of the histograms
+    struct HistogramsConfig {
+        int numHistograms;
+        int numBins;
+        int numReplicas;
     };
 
-    /// update resources
+    /// update resources. if `recordEvents` is false, no buffers for recorded events are allocated
     template <typename Queue>
-    BeamlineConfig update(Queue q, const Group& group, int maxEvents, int numRaysBatchAtMost, const ObjectIndexMask& objectRecordMask,
-                          const RayAttrMask attrRecordMask) {
+    BeamlineConfig update(Queue q, const Group& group, const TracerConfig& config, int maxEvents, int numRaysBatchAtMost,
+                          const ObjectIndexMask& objectRecordMask, const RayAttrMask attrRecordMask, const bool recordEvents = true) {
         RAYX_PROFILE_FUNCTION_STDOUT();
 
         const auto platformHost = alpaka::PlatformCpu{};
         const auto devHost      = alpaka::getDevByIdx(platformHost, 0);
 
-        // material data
-        const auto materialTables     = group.calcMinimalMaterialTables();
-        const auto& materialIndices   = materialTables.indices;
-        const auto& materialTable     = materialTables.materials;
-        const auto numMaterialIndices = static_cast<int>(materialIndices.size());
-        const auto materialTableSize  = static_cast<int>(materialTable.size());
-        allocBuf(q, d_materialIndices, materialIndices.size());
-        allocBuf(q, d_materialTable, materialTable.size());
-        alpaka::memcpy(q, *d_materialIndices, alpaka::createView(devHost, materialIndices, numMaterialIndices));
-        alpaka::memcpy(q, *d_materialTable, alpaka::createView(devHost, materialTable, materialTableSize));
+        // material data. the tables are cached process-wide, so the same set of materials yields the same tables
+        const auto materialTables                = group.calcMinimalMaterialTables();
+        const auto refractiveIndexLutEnergyRange = config.refractiveIndexLut ? calcSourcesEnergyRange(group) : std::nullopt;
+        if (materialTables != h_materialTables || refractiveIndexLutEnergyRange != h_refractiveIndexLutEnergyRange) {
+            // optionally extend a copy of the tables by energy gridded lookup tables
+            auto materialTablesWithLuts = std::optional<MaterialTables>();
+            if (refractiveIndexLutEnergyRange) {
+                materialTablesWithLuts = *materialTables;
+                appendRefractiveIndexLuts(*materialTablesWithLuts, *refractiveIndexLutEnergyRange, *config.refractiveIndexLut);
+            }
+
+            const auto& tables            = materialTablesWithLuts ? *materialTablesWithLuts : *materialTables;
+            const auto& materialIndices   = tables.indices;
+            const auto& materialTable     = tables.materials;
+            const auto numMaterialIndices = static_cast<int>(materialIndices.size());
+            const auto materialTableSize  = static_cast<int>(materialTable.size());
+            allocBuf(q, d_materialIndices, numMaterialIndices);
+            allocBuf(q, d_materialTable, materialTableSize);
+            alpaka::memcpy(q, *d_materialIndices, alpaka::createView(devHost, materialIndices, numMaterialIndices), numMaterialIndices);
+            alpaka::memcpy(q, *d_materialTable, alpaka::createView(devHost, materialTable, materialTableSize), materialTableSize);
+            h_materialTables                = materialTables;
+            h_refractiveIndexLutEnergyRange = refractiveIndexLutEnergyRange;
+            RAYX_VERB << "uploaded material tables: " << materialTableSize * sizeof(double) << " bytes";
+        }
+
+        // diffraction table. does not depend on the beamline, so it is uploaded only once
+        if (!d_diffractionTable) {
+            const auto& diffractionTable    = getDiffractionTable();
+            const auto diffractionTableSize = static_cast<int>(diffractionTable.size());
+            allocBuf(q, d_diffractionTable, diffractionTableSize);
+            alpaka::memcpy(q, *d_diffractionTable, alpaka::createView(devHost, diffractionTable, diffractionTableSize), diffractionTableSize);
+        }
 
         // beamline elements
         // TODO: this should be two arrays, one of elements, one for transforms
         const auto elementsAndTransforms = group.compileElements();
-        auto elements                    = std::vector<OpticalElement>(elementsAndTransforms.size());
-        std::transform(elementsAndTransforms.begin(), elementsAndTransforms.end(), elements.begin(),
-                       [](const OpticalElementAndTransform& e) { return e.element; });
+        // move layers of multilayer coatings into the layer table and let the elements reference them
+        auto packedElements = packCoatingLayers(elementsAndTransforms);
+        auto& elements      = packedElements.elements;
+        auto& coatingLayers = packedElements.coatingLayers;
+        for (auto& element : elements)
+            if (element.m_surface.is<Surface::Toroid>()) element.m_surface.get<Surface::Toroid>().m_solver = config.toroidSolver;
+
+        // reflectivity tables. have to be referenced before uploading the elements, because the elements reference their table.
+        // the buffer must not be empty, even if the tables are disabled
+        const auto reflectivityTableEnergyRange = config.reflectivityTable ? calcSourcesEnergyRange(group) : std::nullopt;
+        if (reflectivityTableEnergyRange) {
+            auto reflectivityTablesKey =
+                calcReflectivityTablesKey(elements, coatingLayers, materialTables, *reflectivityTableEnergyRange, *config.reflectivityTable);
+            if (reflectivityTablesKey == h_reflectivityTablesKey) {
+                // the uploaded tables were built from the same key, only the elements have to reference them
+                assignReflectivityTableOffsets(elements, *config.reflectivityTable);
+            } else {
+                const auto reflectivityTables = buildReflectivityTables(elements, coatingLayers, *materialTables, *reflectivityTableEnergyRange,
+                                                                        *config.reflectivityTable);
+                const auto reflectivityTablesSize = static_cast<int>(reflectivityTables.size());
+                allocBuf(q, d_reflectivityTables, std::max(reflectivityTablesSize, 1));
+                if (reflectivityTablesSize)
+                    alpaka::memcpy(q, *d_reflectivityTables, alpaka::createView(devHost, reflectivityTables, reflectivityTablesSize),
+                                   reflectivityTablesSize);
+                h_reflectivityTablesKey = std::move(reflectivityTablesKey);
+                RAYX_VERB << "uploaded reflectivity tables: " << reflectivityTablesSize * sizeof(double) << " bytes";
+            }
+        } else if (!d_reflectivityTables) {
+            allocBuf(q, d_reflectivityTables, 1);
+        }
+
         const auto numElements = static_cast<int>(elements.size());
         allocBuf(q, d_elements, numElements);
         alpaka::memcpy(q, *d_elements, alpaka::createView(devHost, elements, numElements));
 
+        // coating layers. the buffer must not be empty, even if no element has a multilayer coating
+        const auto numCoatingLayers = static_cast<int>(coatingLayers.size());
+        allocBuf(q, d_coatingLayers, std::max(numCoatingLayers, 1));
+        if (numCoatingLayers) alpaka::memcpy(q, *d_coatingLayers, alpaka::createView(devHost, coatingLayers, numCoatingLayers), numCoatingLayers);
+
+        // bounding volume hierarchy over elements. the buffer must not be empty, even if there are no elements
+        const auto elementBvhNodes    = buildElementBvh(elementsAndTransforms);
+        const auto numElementBvhNodes = static_cast<int>(elementBvhNodes.size());
+        allocBuf(q, d_elementBvhNodes, std::max(numElementBvhNodes, 1));
+        if (numElementBvhNodes)
+            alpaka::memcpy(q, *d_elementBvhNodes, alpaka::createView(devHost, elementBvhNodes, numElementBvhNodes), numElementBvhNodes);
+
         const auto sources    = group.getSources();
         const auto numSources = static_cast<int>(sources.size());
         const auto numObjects = numSources + numElements;
 
         // object transforms
         // TODO: compiling of sources/elements should be revisited
-        auto h_objectTransforms = std::vector<ObjectTransform>(numObjects);
+        auto h_objectTransforms = std::vector<AffineObjectTransform>(numObjects);
         std::transform(sources.begin(), sources.end(), h_objectTransforms.begin(), [](const DesignSource* designSource) {
-            return ObjectTransform{
+            return toAffineObjectTransform(ObjectTransform{
                 // TODO: make sure to do this DesignPlane:XZ thing correctly
                 .m_inTrans  = calcTransformationMatrices(designSource->getPosition(), designSource->getOrientation(), true, DesignPlane::XZ),
                 .m_outTrans = calcTransformationMatrices(designSource->getPosition(), designSource->getOrientation(), false, DesignPlane::XZ),
-            };
+            });
         });
         std::transform(elementsAndTransforms.begin(), elementsAndTransforms.end(), h_objectTransforms.begin() + numSources,
-                       [](const OpticalElementAndTransform& e) { return e.transform; });
+                       [](const OpticalElementAndTransform& e) { return toAffineObjectTransform(e.transform); });
         allocBuf(q, d_objectTransforms, numObjects);
         alpaka::memcpy(q, *d_objectTransforms, alpaka::createView(devHost, h_objectTransforms, numObjects), numObjects);
 
+        // sequential transforms. in sequential tracing a ray hops from one element to the next, so out-transform of the previous element and
+        // in-transform of the next element are precomposed into one transform. the buffer must not be empty, even if there are no elements
+        auto h_sequentialTransforms = std::vector<AffineTransform>(numElements);
+        for (int i = 0; i < numElements; ++i) {
+            const auto& inTrans       = h_objectTransforms[numSources + i].m_inTrans;
+            h_sequentialTransforms[i] = i == 0 ? inTrans : composeAffineTransforms(inTrans, h_objectTransforms[numSources + i - 1].m_outTrans);
+        }
+        allocBuf(q, d_sequentialTransforms, std::max(numElements, 1));
+        if (numElements)
+            alpaka::memcpy(q, *d_sequentialTransforms, alpaka::createView(devHost, h_sequentialTransforms, numElements), numElements);
+
         // object record mask
         allocBuf(q, d_objectRecordMask, numObjects);
         auto h_objectRecordMask = std::make_unique<bool[]>(numObjects);
         for (int i = 0; i < numObjects; ++i) { h_objectRecordMask[i] = objectRecordMask.shouldRecordObject(i); }
         alpaka::memcpy(q, *d_objectRecordMask, alpaka::createView(devHost, h_objectRecordMask.get(), numObjects));
 
-        const auto numEventsBatchAtMost                     = numRaysBatchAtMost * maxEvents;
+        const auto beamlineConfig = BeamlineConfig{
+            .numSources         = numSources,
+            .numElements        = numElements,
+            .numElementBvhNodes = numElementBvhNodes,
+        };
+
+        if (!recordEvents) return beamlineConfig;
+
+        for (auto& d_numEventsBatchBuffer : d_numEventsBatch) allocBuf(q, d_numEventsBatchBuffer, 1);
+
+        const auto numEventsBatchAtMost = numRaysBatchAtMost * maxEvents;
+
+        // appended events are compact already. neither the dense output events nor the buffers of the compaction are needed
+        if (config.appendEvents) {
+            const auto initialCapacity =
+                calcAppendEventsCapacity(numRaysBatchAtMost * config.appendEvents->initialEventsPerRay, numEventsBatchAtMost);
+            for (int bufferIndex = 0; bufferIndex < NUM_BATCH_BUFFERS; ++bufferIndex) {
+                allocRaysBuf(q, attrRecordMask, d_compactEventsBatch[bufferIndex], initialCapacity);
+                appendEventsCapacity[bufferIndex] = initialCapacity;
+            }
+
+            return beamlineConfig;
+        }
+
         const auto numEventsBatchAtMostAccountForGridStride = nextMultiple(numRaysBatchAtMost, GRID_STRIDE_MULTIPLE) * maxEvents;
 
         // output events and compacted output events
         allocRaysBuf(q, attrRecordMask, d_eventsBatch, numEventsBatchAtMostAccountForGridStride);
-        allocRaysBuf(q, attrRecordMask, d_compactEventsBatch, numEventsBatchAtMost);
+        for (auto& d_compactEventsBatchBuffer : d_compactEventsBatch)
+            allocRaysBuf(q, attrRecordMask, d_compactEventsBatchBuffer, numEventsBatchAtMost);
 
         // event storage flags, used for compaction of events
         allocBuf(q, d_eventStoreFlags, numEventsBatchAtMostAccountForGridStride);
-        allocBuf(q, d_eventStoreFlagsPrefixSum, numEventsBatchAtMostAccountForGridStride);
+
+        // buffers for the device side scan over the event storage flags
+        auto numScanValues = ceilIntDivision(numEventsBatchAtMostAccountForGridStride, SCAN_TILE_SIZE);
+        allocBuf(q, d_eventStoreFlagsTileOffsets, std::max(numScanValues, 1));
+        for (size_t level = 0; numScanValues > SCAN_TILE_SIZE; ++level) {
+            numScanValues = ceilIntDivision(numScanValues, SCAN_TILE_SIZE);
+            if (d_scanPartialSums.size() <= level) d_scanPartialSums.emplace_back();
+            allocBuf(q, d_scanPartialSums[level], numScanValues);
+        }
+
+        return beamlineConfig;
+    }
+
+    /// uploads the event filters
+    template <typename Queue>
+    void updateEventFilters(Queue q, const std::vector<EventFilter>& eventFilters) {
+        const auto platformHost = alpaka::PlatformCpu{};
+        const auto devHost      = alpaka::getDevByIdx(platformHost, 0);
+
+        // the buffer must not be empty, even if there are no filters
+        numEventFilters = static_cast<int>(eventFilters.size());
+        allocBuf(q, d_eventFilters, std::max(numEventFilters, 1));
+        if (numEventFilters) alpaka::memcpy(q, *d_eventFilters, alpaka::createView(devHost, eventFilters, numEventFilters), numEventFilters);
+    }
+
+    /// uploads the configurations of the histograms and clears their bins
+    template <typename Queue>
+    HistogramsConfig updateHistograms(Queue q, const std::vector<HistogramConfig>& histograms) {
+        RAYX_PROFILE_FUNCTION_STDOUT();
+
+        const auto platformHost = alpaka::PlatformCpu{};
+        const auto devHost      = alpaka::getDevByIdx(platformHost, 0);
+
+        // the buffer must not be empty, even if there are no histograms
+        const auto numHistograms = static_cast<int>(histograms.size());
+        allocBuf(q, d_histograms, std::max(numHistograms, 1));
+        if (numHistograms) alpaka::memcpy(q, *d_histograms, alpaka::createView(devHost, histograms, numHistograms), numHistograms);
+
+        auto numBins = 0;
+        for (const auto& histogram : histograms) numBins += histogram.numBins();
+        const auto numReplicas = calcNumHistogramReplicas(numBins);
+        allocBuf(q, d_histogramBins, std::max(numBins * numReplicas, 1));
+        alpaka::memset(q, *d_histogramBins, 0, std::max(numBins * numReplicas, 1));
 
         return {
-            .numSources  = numSources,
-            .numElements = numElements,
+            .numHistograms = numHistograms,
+            .numBins       = numBins,
+            .numReplicas   = numReplicas,
         };
     }
 };
@@ -179,12 +639,15 @@ struct Resources {
  * 2. Execute the mega-kernel tracing function.
  * 3. Compact recorded events to optimize memory transfers.
  * 4. Transfer compacted recorded events back to the host.
- * 5. Aggregate results from all batches into a final Rays object for output.
+ * 5. Pass the recorded events of each batch to the sink, in order of batches.
+ *
+ * Batches are pipelined over NUM_BATCH_BUFFERS buffer sets: rays of batch i+1 are generated on a separate queue
+ * while batch i is traced, and the events of batch i are transferred to the host by a host thread while batch i+1 is traced.
  */
 template <typename AccTag>
 class MegaKernelTracer : public DeviceTracer {
   public:
-    explicit MegaKernelTracer(int deviceIndex) : m_deviceIndex(deviceIndex) {}
+    MegaKernelTracer(int deviceIndex, const TracerConfig& config) : m_deviceIndex(deviceIndex), m_config(config) {}
     MegaKernelTracer(const MegaKernelTracer&)            = delete;
     MegaKernelTracer(MegaKernelTracer&&)                 = default;
     MegaKernelTracer& operator=(const MegaKernelTracer&) = delete;
@@ -196,14 +659,16 @@ class MegaKernelTracer : public DeviceTracer {
     using Acc = alpaka::TagToAcc<AccTag, Dim, Idx>;
 
     const int m_deviceIndex;
+    const TracerConfig m_config;
     Resources<Acc> m_resources;
 
     using GenRaysAcc = GenRays<Acc>;
     GenRaysAcc m_genRaysResources;
 
   public:
-    virtual Rays trace(const Group& beamline, Sequential sequential, const ObjectIndexMask& objectRecordMask, const RayAttrMask attrRecordMask,
-                       const int maxEventsElements, const int maxBatchSize) override {
+    virtual void traceStreaming(const Group& beamline, Sequential sequential, const ObjectIndexMask& objectRecordMask,
+                                const RayAttrMask attrRecordMask, const int maxEventsElements, const std::optional<int> maxBatchSize,
+                                const std::vector<EventFilter>& eventFilters, const RaysSink& sink) override {
         RAYX_PROFILE_FUNCTION_STDOUT();
 
         const auto maxEventsSources = 1;
@@ -216,111 +681,305 @@ class MegaKernelTracer : public DeviceTracer {
         using Queue             = alpaka::Queue<Acc, alpaka::Blocking>;
         auto q                  = Queue(devAcc);
 
-        const auto sourceConf   = m_genRaysResources.update(q, beamline, maxBatchSize);
-        const auto beamlineConf = m_resources.update(q, beamline, maxEvents, sourceConf.numRaysBatchAtMost, objectRecordMask, attrRecordMask);
+        const auto actualMaxBatchSize = calcMaxBatchSize(devAcc, devHost, maxBatchSize, maxEvents, attrRecordMask, true);
+        const auto sourceConf         = m_genRaysResources.update(q, beamline, actualMaxBatchSize);
+        const auto beamlineConf =
+            m_resources.update(q, beamline, m_config, maxEvents, sourceConf.numRaysBatchAtMost, objectRecordMask, attrRecordMask);
+        m_resources.updateEventFilters(q, eventFilters);
 
         RAYX_VERB << "trace beamline:";
         RAYX_VERB << "\t- num sources: " << beamlineConf.numSources;
         RAYX_VERB << "\t- num elements: " << beamlineConf.numElements;
+        RAYX_VERB << "\t- num element bvh nodes: " << beamlineConf.numElementBvhNodes;
         RAYX_VERB << "\t- sequential: " << (sequential == Sequential::Yes ? "yes" : "no");
         RAYX_VERB << "\t- max events on elements: " << maxEventsElements;
         RAYX_VERB << "\t- num rays: " << sourceConf.numRaysTotal;
-        RAYX_VERB << "\t- max batch size: " << maxBatchSize;
+        RAYX_VERB << "\t- max batch size: " << actualMaxBatchSize;
         RAYX_VERB << "\t- batch size: " << sourceConf.numRaysBatchAtMost;
         RAYX_VERB << "\t- num batches: " << sourceConf.numBatches;
         // TODO: print object mask
         RAYX_VERB << "\t- using ray attribute mask: " << to_string(attrRecordMask);
+        RAYX_VERB << "\t- num event filters: " << eventFilters.size();
         RAYX_VERB << "\t- backend tag: " << AccTag{}.get_name();
         RAYX_VERB << "\t- device index: " << m_deviceIndex;
         RAYX_VERB << "\t- device name: " << alpaka::getName(devAcc);
         RAYX_VERB << "\t- host device name: " << alpaka::getName(devHost);
 
-        const auto numRaysBatchAtMostAccountForGridStride   = nextMultiple(sourceConf.numRaysBatchAtMost, GRID_STRIDE_MULTIPLE);
-        const auto numEventsBatchAtMostAccountForGridStride = numRaysBatchAtMostAccountForGridStride * maxEvents;
-        auto h_compactEventsBatches                         = std::vector<Rays>(sourceConf.numBatches);
-        auto h_eventStoreFlags                              = std::make_unique<bool[]>(numEventsBatchAtMostAccountForGridStride);
-        auto h_eventStoreFlagsPrefixSum                     = std::vector<int>(numEventsBatchAtMostAccountForGridStride);
-        auto numEventsTotal                                 = 0;
-
-        for (int batchIndex = 0; batchIndex < sourceConf.numBatches; ++batchIndex) {
-            RAYX_VERB << "processing batch (" << (batchIndex + 1) << "/" << sourceConf.numBatches << ")";
+        // compaction is enqueued on the trace queue after tracing. transfers run on a dedicated host thread with its own blocking queue
+        using QueueNonBlocking = alpaka::Queue<Acc, alpaka::NonBlocking>;
+        using Event            = alpaka::Event<QueueNonBlocking>;
+        auto compactDone       = std::vector<Event>();
+        for (int bufferIndex = 0; bufferIndex < NUM_BATCH_BUFFERS; ++bufferIndex) compactDone.emplace_back(devAcc);
+        auto transferQueue = Queue(devAcc);
+
+        auto h_numEventsBatch = std::array<int, NUM_BATCH_BUFFERS>{};
+        auto h_numRaysBatch   = std::array<int, NUM_BATCH_BUFFERS>{};
+        auto numEventsTotal   = int64_t{0};
+
+        // declared after everything the transfers refer to, so that pending transfers finish before it is destroyed
+        auto transferThread = BatchTransferThread(NUM_BATCH_BUFFERS);
+
+        // only NUM_BATCH_BUFFERS batches are held on the host at any time. each batch is moved to the sink once it was transferred
+        const auto consumeBatch = [&](const int batchIndex) {
+            auto h_compactEventsBatch = transferThread.take();
+            RAYX_VERB << "finished batch (" << (batchIndex + 1) << "/" << sourceConf.numBatches
+                      << ") with batch size = " << h_numRaysBatch[batchIndex % NUM_BATCH_BUFFERS] << ", recorded " << h_compactEventsBatch.size()
+                      << " events";
+            numEventsTotal += h_compactEventsBatch.size();
+            sink(std::move(h_compactEventsBatch));
+        };
 
-            // generate input rays for batch
-            auto batchConf = m_genRaysResources.genRaysBatch(devAcc, q, batchIndex);
+        traceBatches(devAcc, sourceConf.numBatches, [&](auto& traceQueue, const int batchIndex, const int bufferIndex, auto& batchConf) {
+            // the compacted events of the batch that used this buffer before must be on the host, before they are overwritten
+            if (NUM_BATCH_BUFFERS <= batchIndex) consumeBatch(batchIndex - NUM_BATCH_BUFFERS);
 
             const auto numRaysBatchAccountForGridStride   = nextMultiple(batchConf.numRaysBatch, GRID_STRIDE_MULTIPLE);
             const auto numEventsBatchAccountForGridStride = numRaysBatchAccountForGridStride * maxEvents;
 
-            // clear buffers
-            alpaka::memset(q, *m_resources.d_eventStoreFlags, 0, numEventsBatchAccountForGridStride);
+            if (m_config.appendEvents) {
+                // trace current batch, appending events to the compacted output events. retry with a larger buffer until all events fit
+                traceBatchAppendEvents(devAcc, devHost, traceQueue, beamlineConf, maxEvents, sequential, attrRecordMask, batchConf,
+                                       numRaysBatchAccountForGridStride, bufferIndex, h_numEventsBatch[bufferIndex]);
+            } else {
+                // clear buffers
+                alpaka::memset(traceQueue, *m_resources.d_eventStoreFlags, 0, numEventsBatchAccountForGridStride);
 
-            // from here we need to account for grid stride in the output buffers of the trace function: uncompacte events and storedFlag
+                // from here we need to account for grid stride in the output buffers of the trace function: uncompacte events and storedFlag
 
-            // trace current batch
-            traceBatch(devAcc, q, beamlineConf.numSources, beamlineConf.numElements, maxEvents, sequential, attrRecordMask, batchConf,
-                       numRaysBatchAccountForGridStride);
+                // trace current batch. events rejected by the event filters are not flagged as stored, so they are dropped by the compaction
+                traceBatch(devAcc, traceQueue, beamlineConf, maxEvents, sequential, attrRecordMask, batchConf, numRaysBatchAccountForGridStride,
+                           bufferIndex);
 
-            alpaka::memcpy(q, alpaka::createView(devHost, h_eventStoreFlags.get(), numEventsBatchAccountForGridStride),
-                           *m_resources.d_eventStoreFlags, numEventsBatchAccountForGridStride);
-            const auto h_eventStoreFlagsPrefixSumEnd = std::exclusive_scan(
-                h_eventStoreFlags.get(), h_eventStoreFlags.get() + numEventsBatchAccountForGridStride, h_eventStoreFlagsPrefixSum.begin(), 0);
-            const auto numEventsBatch =
-                *(h_eventStoreFlagsPrefixSumEnd - 1);  // access the last element of the exclusive scan result to get the total count
-            alpaka::memcpy(q, *m_resources.d_eventStoreFlagsPrefixSum,
-                           alpaka::createView(devHost, h_eventStoreFlagsPrefixSum, numEventsBatchAccountForGridStride),
-                           numEventsBatchAccountForGridStride);
+                // compact events to remove unused events. only the number of stored events is transferred back to the host
+                compactEvents(devAcc, devHost, traceQueue, numEventsBatchAccountForGridStride, attrRecordMask, bufferIndex,
+                              h_numEventsBatch[bufferIndex]);
+            }
+            alpaka::enqueue(traceQueue, compactDone[bufferIndex]);
 
-            // TODO: here we could apply more filters by turning off storedFlags
+            // end of acocunt for grid stride, because from here we use the compacted buffers
 
-            // compact events to remove unused events
-            compactEvents(devAcc, q, numEventsBatchAccountForGridStride, attrRecordMask);
+            h_numRaysBatch[bufferIndex] = batchConf.numRaysBatch;
+            transferThread.request([&, bufferIndex] {
+                alpaka::wait(compactDone[bufferIndex]);
+                return transferEventsBatch(devHost, transferQueue, h_numEventsBatch[bufferIndex], attrRecordMask, bufferIndex);
+            });
+        });
 
-            // end of acocunt for grid stride, because from here we use the compacted buffers
+        const auto firstPendingBatchIndex = std::max(0, sourceConf.numBatches - NUM_BATCH_BUFFERS);
+        for (int batchIndex = firstPendingBatchIndex; batchIndex < sourceConf.numBatches; ++batchIndex) consumeBatch(batchIndex);
 
-            numEventsTotal += numEventsBatch;
+        RAYX_VERB << "number of recorded events: " << numEventsTotal;
+    }
 
-            h_compactEventsBatches[batchIndex] = transferEventsBatch(devHost, q, numEventsBatch, attrRecordMask);
+    virtual std::vector<Histogram> traceHistograms(const Group& beamline, Sequential sequential, const ObjectIndexMask& objectRecordMask,
+                                                   const int maxEventsElements, const std::optional<int> maxBatchSize,
+                                                   const std::vector<EventFilter>& eventFilters,
+                                                   const std::vector<HistogramConfig>& histograms) override {
+        RAYX_PROFILE_FUNCTION_STDOUT();
 
-            RAYX_VERB << "finished batch (" << (batchIndex + 1) << "/" << sourceConf.numBatches << ") with batch size = " << batchConf.numRaysBatch
-                      << ", recorded " << numEventsBatch << " events";
-        }
+        const auto maxEventsSources = 1;
+        const auto maxEvents        = maxEventsSources + maxEventsElements;
 
-        RAYX_VERB << "number of recorded events: " << numEventsTotal;
+        const auto platformHost = alpaka::PlatformCpu{};
+        const auto devHost      = alpaka::getDevByIdx(platformHost, 0);
+        const auto platformAcc  = alpaka::Platform<Acc>{};
+        const auto devAcc       = alpaka::getDevByIdx(platformAcc, m_deviceIndex);
+        using Queue             = alpaka::Queue<Acc, alpaka::Blocking>;
+        auto q                  = Queue(devAcc);
+
+        // no events are recorded, so only the generated rays count towards the memory budget
+        const auto actualMaxBatchSize = calcMaxBatchSize(devAcc, devHost, maxBatchSize, maxEvents, RayAttrMask::None, false);
+        const auto sourceConf         = m_genRaysResources.update(q, beamline, actualMaxBatchSize);
+        const auto beamlineConf       = m_resources.update(q, beamline, m_config, maxEvents, sourceConf.numRaysBatchAtMost, objectRecordMask,
+                                                           RayAttrMask::None, false);
+        const auto histogramsConf     = m_resources.updateHistograms(q, histograms);
+        m_resources.updateEventFilters(q, eventFilters);
+
+        RAYX_VERB << "trace beamline into histograms:";
+        RAYX_VERB << "\t- num sources: " << beamlineConf.numSources;
+        RAYX_VERB << "\t- num elements: " << beamlineConf.numElements;
+        RAYX_VERB << "\t- sequential: " << (sequential == Sequential::Yes ? "yes" : "no");
+        RAYX_VERB << "\t- max events on elements: " << maxEventsElements;
+        RAYX_VERB << "\t- num rays: " << sourceConf.numRaysTotal;
+        RAYX_VERB << "\t- max batch size: " << actualMaxBatchSize;
+        RAYX_VERB << "\t- batch size: " << sourceConf.numRaysBatchAtMost;
+        RAYX_VERB << "\t- num batches: " << sourceConf.numBatches;
+        RAYX_VERB << "\t- num histograms: " << histogramsConf.numHistograms;
+        RAYX_VERB << "\t- num histogram bins: " << histogramsConf.numBins;
+        RAYX_VERB << "\t- num histogram replicas: " << histogramsConf.numReplicas;
+        RAYX_VERB << "\t- num event filters: " << eventFilters.size();
+        RAYX_VERB << "\t- backend tag: " << AccTag{}.get_name();
+        RAYX_VERB << "\t- device name: " << alpaka::getName(devAcc);
+
+        // there is nothing to compact or transfer per batch
+        traceBatches(devAcc, sourceConf.numBatches, [&](auto& traceQueue, const int, const int bufferIndex, auto& batchConf) {
+            traceBatch(devAcc, traceQueue, beamlineConf, maxEvents, sequential, RayAttrMask::None, batchConf,
+                       nextMultiple(batchConf.numRaysBatch, GRID_STRIDE_MULTIPLE), bufferIndex, histogramsConf);
+        });
 
-        return Rays::concat(h_compactEventsBatches);
+        // merge the replicas and transfer only the merged bins back to the host
+        auto h_bins = std::vector<double>(histogramsConf.numBins);
+        if (histogramsConf.numBins) {
+            RAYX_VERB << "execute MergeHistogramReplicasKernel";
+            execWithValidWorkDiv<Acc>(devAcc, q, histogramsConf.numBins, BlockSizeConstraint::None{}, MergeHistogramReplicasKernel{},
+                                      alpaka::getPtrNative(*m_resources.d_histogramBins), histogramsConf.numBins, histogramsConf.numReplicas);
+            alpaka::memcpy(q, alpaka::createView(devHost, h_bins, histogramsConf.numBins), *m_resources.d_histogramBins, histogramsConf.numBins);
+        }
+
+        auto h_histograms = std::vector<Histogram>();
+        auto offset       = 0;
+        for (const auto& histogram : histograms) {
+            h_histograms.push_back(Histogram{
+                .config = histogram,
+                .bins   = std::vector<double>(h_bins.begin() + offset, h_bins.begin() + offset + histogram.numBins()),
+            });
+            offset += histogram.numBins();
+        }
+        return h_histograms;
     }
 
   private:
+    /// largest batch size. limited by `maxBatchSize` and by the memory budget, if given. if neither is given, DEFAULT_BATCH_SIZE is used.
+    /// if `recordEvents` is false, only the generated rays count towards the memory budget
+    template <typename DevAcc, typename DevHost>
+    int calcMaxBatchSize(DevAcc devAcc, const DevHost& devHost, const std::optional<int> maxBatchSize, const int maxEvents,
+                         const RayAttrMask attrRecordMask, const bool recordEvents) const {
+        auto actualMaxBatchSize = maxBatchSize.value_or(m_config.memoryBudget ? std::numeric_limits<int>::max() : DEFAULT_BATCH_SIZE);
+        if (!m_config.memoryBudget) return actualMaxBatchSize;
+
+        constexpr auto deviceIsHost   = std::is_same_v<alpaka::Platform<Acc>, alpaka::PlatformCpu>;
+        const auto deviceMemory       = std::min(*m_config.memoryBudget, alpaka::getFreeMemBytes(devAcc));
+        const auto hostMemory         = std::min(*m_config.memoryBudget, alpaka::getFreeMemBytes(devHost));
+        const auto batchSizeForMemory =
+            calcMaxBatchSizeForMemory(deviceMemory, hostMemory, deviceIsHost, maxEvents, attrRecordMask, recordEvents, m_config);
+        RAYX_VERB << "batch size for memory budget of " << *m_config.memoryBudget << " bytes (free device memory: " << alpaka::getFreeMemBytes(devAcc)
+                  << " bytes, free host memory: " << alpaka::getFreeMemBytes(devHost) << " bytes): " << batchSizeForMemory;
+        return std::min(actualMaxBatchSize, batchSizeForMemory);
+    }
+
+    /// generates and traces all batches. batches are pipelined over NUM_BATCH_BUFFERS buffer sets: rays of batch i+1 are generated on a
+    /// separate queue while batch i is traced. `traceBatchFn(traceQueue, batchIndex, bufferIndex, batchConf)` enqueues the work of a batch on
+    /// the trace queue, once the rays of the batch are generated. returns after all enqueued work is done
+    template <typename DevAcc, typename TraceBatchFn>
+    void traceBatches(DevAcc devAcc, const int numBatches, TraceBatchFn&& traceBatchFn) {
+        // the pipeline uses one queue for ray generation and one for tracing, synchronized with events per batch buffer
+        using QueueNonBlocking = alpaka::Queue<Acc, alpaka::NonBlocking>;
+        using Event            = alpaka::Event<QueueNonBlocking>;
+        auto genQueue          = QueueNonBlocking(devAcc);
+        auto traceQueue        = QueueNonBlocking(devAcc);
+        auto genDone           = std::vector<Event>();
+        auto traceDone         = std::vector<Event>();
+        for (int bufferIndex = 0; bufferIndex < NUM_BATCH_BUFFERS; ++bufferIndex) {
+            genDone.emplace_back(devAcc);
+            traceDone.emplace_back(devAcc);
+        }
+
+        for (int batchIndex = 0; batchIndex < numBatches; ++batchIndex) {
+            RAYX_VERB << "processing batch (" << (batchIndex + 1) << "/" << numBatches << ")";
+
+            const auto bufferIndex = batchIndex % NUM_BATCH_BUFFERS;
+
+            // generate input rays for batch. the rays of the batch that used this buffer before must be consumed by the trace kernel
+            alpaka::wait(genQueue, traceDone[bufferIndex]);
+            auto batchConf = m_genRaysResources.genRaysBatch(devAcc, genQueue, batchIndex, bufferIndex);
+            alpaka::enqueue(genQueue, genDone[bufferIndex]);
+
+            alpaka::wait(traceQueue, genDone[bufferIndex]);
+            traceBatchFn(traceQueue, batchIndex, bufferIndex, batchConf);
+            alpaka::enqueue(traceQueue, traceDone[bufferIndex]);
+        }
+
+        alpaka::wait(genQueue);
+        alpaka::wait(traceQueue);
+    }
+    /// traces the current batch and appends its events to the compacted output events of batch buffer `bufferIndex`.
+    /// if the events did not fit, the buffer grows and the batch is traced again. this waits for the queue, because the host has to check the
+    /// number of recorded events
+    template <typename DevAcc, typename DevHost, typename Queue>
+    void traceBatchAppendEvents(DevAcc devAcc, DevHost& devHost, Queue q, const Resources<Acc>::BeamlineConfig& beamlineConf, int maxEvents,
+                                Sequential sequential, RayAttrMask attrRecordMask, GenRaysAcc::BatchConfig& batchConf,
+                                int numRaysBatchAccountForGridStride, const int bufferIndex, int& h_numEventsBatch) {
+        RAYX_PROFILE_FUNCTION_STDOUT();
+
+        auto& capacity = m_resources.appendEventsCapacity[bufferIndex];
+        while (true) {
+            alpaka::memset(q, *m_resources.d_numEventsBatch[bufferIndex], 0, 1);
+            traceBatch(devAcc, q, beamlineConf, maxEvents, sequential, attrRecordMask, batchConf, numRaysBatchAccountForGridStride, bufferIndex);
+            alpaka::memcpy(q, alpaka::createView(devHost, &h_numEventsBatch, 1), *m_resources.d_numEventsBatch[bufferIndex], 1);
+            alpaka::wait(q);
+
+            if (h_numEventsBatch <= capacity) return;
+
+            // the counter holds the number of events of the batch, including the dropped ones
+            const auto numEventsBatchAtMost = batchConf.numRaysBatch * maxEvents;
+            const auto newCapacity          = calcAppendEventsCapacity(h_numEventsBatch * m_config.appendEvents->growthFactor, numEventsBatchAtMost);
+            RAYX_VERB << "recorded " << h_numEventsBatch << " events, but the buffer holds only " << capacity << ". grow buffer to " << newCapacity
+                      << " events and trace the batch again";
+            allocRaysBuf(q, attrRecordMask, m_resources.d_compactEventsBatch[bufferIndex], newCapacity);
+            capacity = newCapacity;
+        }
+    }
+
+    /// traces the current batch. events are recorded into the buffers of batch buffer `bufferIndex`, or accumulated into the histograms if
+    /// `histogramsConf` is given
     template <typename DevAcc, typename Queue>
-    void traceBatch(DevAcc devAcc, Queue q, int numSources, int numElements, int maxEvents, Sequential sequential, RayAttrMask attrRecordMask,
-                    GenRaysAcc::BatchConfig& batchConf, int numRaysBatchAccountForGridStride) {
+    void traceBatch(DevAcc devAcc, Queue q, const Resources<Acc>::BeamlineConfig& beamlineConf, int maxEvents, Sequential sequential,
+                    RayAttrMask attrRecordMask, GenRaysAcc::BatchConfig& batchConf, int numRaysBatchAccountForGridStride, const int bufferIndex,
+                    const std::optional<typename Resources<Acc>::HistogramsConfig> histogramsConf = std::nullopt) {
         RAYX_PROFILE_FUNCTION_STDOUT();
 
+        // appended events go straight to the compacted output events of the batch buffer. accumulated events are not recorded at all
+        const auto append = m_config.appendEvents.has_value() && !histogramsConf;
+        const auto dense  = !m_config.appendEvents && !histogramsConf;
+
         const auto constState = ConstState{
             // constants
             .maxEvents              = maxEvents,
             .sequential             = sequential,
-            .numSources             = numSources,
-            .numElements            = numElements,
+            .numSources             = beamlineConf.numSources,
+            .numElements            = beamlineConf.numElements,
+            .numElementBvhNodes     = beamlineConf.numElementBvhNodes,
             .outputEventsGridStride = numRaysBatchAccountForGridStride,
+            .appendEventsCapacity   = append ? m_resources.appendEventsCapacity[bufferIndex] : 0,
+            .numEventFilters        = m_resources.numEventFilters,
+            .numHistograms          = histogramsConf ? histogramsConf->numHistograms : 0,
+            .numHistogramBins       = histogramsConf ? histogramsConf->numBins : 0,
+            .numHistogramReplicas   = histogramsConf ? histogramsConf->numReplicas : 1,
 
             // buffers
-            .objectTransforms = alpaka::getPtrNative(*m_resources.d_objectTransforms),
-            .elements         = alpaka::getPtrNative(*m_resources.d_elements),
-            .materialIndices  = alpaka::getPtrNative(*m_resources.d_materialIndices),
-            .materialTable    = alpaka::getPtrNative(*m_resources.d_materialTable),
-            .objectRecordMask = alpaka::getPtrNative(*m_resources.d_objectRecordMask),
-            .attrRecordMask   = attrRecordMask,
-            .rays             = raysBufToRaysPtr(batchConf.d_rays),
+            .objectTransforms     = alpaka::getPtrNative(*m_resources.d_objectTransforms),
+            .sequentialTransforms = alpaka::getPtrNative(*m_resources.d_sequentialTransforms),
+            .elements             = alpaka::getPtrNative(*m_resources.d_elements),
+            .coatingLayers        = alpaka::getPtrNative(*m_resources.d_coatingLayers),
+            .elementBvhNodes      = alpaka::getPtrNative(*m_resources.d_elementBvhNodes),
+            .reflectivityTables   = alpaka::getPtrNative(*m_resources.d_reflectivityTables),
+            .diffractionTable     = alpaka::getPtrNative(*m_resources.d_diffractionTable),
+            .materialIndices      = alpaka::getPtrNative(*m_resources.d_materialIndices),
+            .materialTable        = alpaka::getPtrNative(*m_resources.d_materialTable),
+            .objectRecordMask     = alpaka::getPtrNative(*m_resources.d_objectRecordMask),
+            .eventFilters         = alpaka::getPtrNative(*m_resources.d_eventFilters),
+            .histograms           = histogramsConf ? alpaka::getPtrNative(*m_resources.d_histograms) : nullptr,
+            .attrRecordMask       = attrRecordMask,
+            .rays                 = raysBufToRaysPtr(batchConf.d_rays),
         };
 
         const auto mutableState = MutableState{
             // buffers
-            .events      = raysBufToRaysPtr(m_resources.d_eventsBatch),
-            .storedFlags = alpaka::getPtrNative(*m_resources.d_eventStoreFlags),
+            .events            = append ? raysBufToRaysPtr(m_resources.d_compactEventsBatch[bufferIndex])
+                                        : (dense ? raysBufToRaysPtr(m_resources.d_eventsBatch) : RaysPtr{}),
+            .storedFlags       = dense ? alpaka::getPtrNative(*m_resources.d_eventStoreFlags) : nullptr,
+            .numAppendedEvents = append ? alpaka::getPtrNative(*m_resources.d_numEventsBatch[bufferIndex]) : nullptr,
+            .histogramBins     = histogramsConf ? alpaka::getPtrNative(*m_resources.d_histogramBins) : nullptr,
         };
 
-        if (sequential == Sequential::Yes) {
+        // ray packets only pay off with SIMD units. GPUs already execute the rays of a warp in lockstep
+        constexpr auto isCpu = std::is_same_v<alpaka::Platform<Acc>, alpaka::PlatformCpu>;
+        if (isCpu && m_config.rayPackets && sequential == Sequential::Yes) {
+            const auto numPackets = ceilIntDivision(batchConf.numRaysBatch, RAY_PACKET_SIZE);
+            RAYX_VERB << "execute TraceSequentialPacketKernel";
+            execWithValidWorkDiv<Acc>(devAcc, q, numPackets, BlockSizeConstraint::None{}, TraceSequentialPacketKernel{}, constState, mutableState,
+                                      batchConf.numRaysBatch);
+        } else if (sequential == Sequential::Yes) {
             RAYX_VERB << "execute TraceSequentialKernel";
             execWithValidWorkDiv<Acc>(devAcc, q, batchConf.numRaysBatch, BlockSizeConstraint::None{}, TraceSequentialKernel{}, constState,
                                       mutableState, batchConf.numRaysBatch);
@@ -331,31 +990,60 @@ class MegaKernelTracer : public DeviceTracer {
         }
     }
 
+    /// launches a kernel of the device side scan and compaction with one block per tile. blocks have at most SCAN_BLOCK_SIZE threads
+    template <typename DevAcc, typename Queue, typename Kernel, typename... Args>
+    void execPerScanTile(DevAcc devAcc, Queue q, const int numTiles, const Kernel& kernel, Args&&... args) {
+        const auto maxBlockSize = static_cast<int>(alpaka::getAccDevProps<Acc>(devAcc).m_blockThreadCountMax);
+        const auto blockSize    = std::min(SCAN_BLOCK_SIZE, maxBlockSize);
+        execWithValidWorkDiv<Acc>(devAcc, q, numTiles * blockSize, BlockSizeConstraint::AtMost{blockSize}, kernel, std::forward<Args>(args)...);
+    }
+
+    /// exclusive scan of `values` in place on the device. writes the sum of all values to `total`.
+    /// the scan is hierarchical: tile sums are scanned recursively, then each tile is scanned starting at the offset of the tile
     template <typename DevAcc, typename Queue>
-    void compactEvents(DevAcc devAcc, Queue q, const int numEventsBatchAccountForGridStride, const RayAttrMask attrRecordMask) {
+    void exclusiveScan(DevAcc devAcc, Queue q, int* values, const int n, int* total, const size_t level = 0) {
+        const auto numTiles = ceilIntDivision(n, SCAN_TILE_SIZE);
+
+        if (numTiles <= 1) {
+            execPerScanTile(devAcc, q, 1, ExclusiveScanTilesKernel{}, values, static_cast<const int*>(nullptr), total, n, 1);
+            return;
+        }
+
+        auto* tileOffsets = alpaka::getPtrNative(*m_resources.d_scanPartialSums[level]);
+        execPerScanTile(devAcc, q, numTiles, SumTilesKernel{}, tileOffsets, static_cast<const int*>(values), n, numTiles);
+        exclusiveScan(devAcc, q, tileOffsets, numTiles, total, level + 1);
+        execPerScanTile(devAcc, q, numTiles, ExclusiveScanTilesKernel{}, values, static_cast<const int*>(tileOffsets), static_cast<int*>(nullptr),
+                        n, numTiles);
+    }
+
+    /// compacts the stored events of the current batch into the batch buffer `bufferIndex`.
+    /// enqueues the transfer of the number of stored events to `h_numEventsBatch`, which is valid once the queue reached this point
+    template <typename DevAcc, typename DevHost, typename Queue>
+    void compactEvents(DevAcc devAcc, DevHost& devHost, Queue q, const int numEventsBatchAccountForGridStride, const RayAttrMask attrRecordMask,
+                       const int bufferIndex, int& h_numEventsBatch) {
         RAYX_PROFILE_FUNCTION_STDOUT();
 
-        // TODO: compare performance to single scatter kernel execution handling all attributes
+        const auto numTiles = ceilIntDivision(numEventsBatchAccountForGridStride, SCAN_TILE_SIZE);
+        auto* flags         = alpaka::getPtrNative(*m_resources.d_eventStoreFlags);
+        auto* tileOffsets   = alpaka::getPtrNative(*m_resources.d_eventStoreFlagsTileOffsets);
+        auto* numEvents     = alpaka::getPtrNative(*m_resources.d_numEventsBatch[bufferIndex]);
 
-        auto execKernel = [&]<typename TOptBuf>(TOptBuf& compactAttrBuf, const TOptBuf& attrBuf) {
-            execWithValidWorkDiv<Acc>(devAcc, q, numEventsBatchAccountForGridStride, BlockSizeConstraint::None{}, ScatterCompactKernel{},
-                                      alpaka::getPtrNative(*compactAttrBuf), alpaka::getPtrNative(*attrBuf),
-                                      alpaka::getPtrNative(*m_resources.d_eventStoreFlagsPrefixSum),
-                                      alpaka::getPtrNative(*m_resources.d_eventStoreFlags), numEventsBatchAccountForGridStride);
-        };
+        // count stored events per tile of store flags and scan the counts to get the offset of each tile in the compacted output
+        RAYX_VERB << "execute SumTilesKernel for event store flags";
+        execPerScanTile(devAcc, q, numTiles, SumTilesKernel{}, tileOffsets, static_cast<const bool*>(flags), numEventsBatchAccountForGridStride,
+                        numTiles);
+        exclusiveScan(devAcc, q, tileOffsets, numTiles, numEvents);
 
-#define X(type, name, flag)                                                                  \
-    if (contains(attrRecordMask, RayAttrMask::flag)) {                                       \
-        RAYX_VERB << "execute ScatterCompactKernel for compaction of ray attribute: " #name; \
-        execKernel(m_resources.d_compactEventsBatch.name, m_resources.d_eventsBatch.name);   \
-    }
+        RAYX_VERB << "execute ScatterCompactEventsKernel for compaction of ray attributes: " << to_string(attrRecordMask);
+        execPerScanTile(devAcc, q, numTiles, ScatterCompactEventsKernel{}, raysBufToRaysPtr(m_resources.d_compactEventsBatch[bufferIndex]),
+                        raysBufToRaysPtr(m_resources.d_eventsBatch), attrRecordMask, static_cast<const int*>(tileOffsets),
+                        static_cast<const bool*>(flags), numEventsBatchAccountForGridStride, numTiles);
 
-        RAYX_X_MACRO_RAY_ATTR
-#undef X
+        alpaka::memcpy(q, alpaka::createView(devHost, &h_numEventsBatch, 1), *m_resources.d_numEventsBatch[bufferIndex], 1);
     }
 
     template <typename DevHost, typename Queue>
-    Rays transferEventsBatch(DevHost& devHost, Queue q, const int numEventsBatch, const RayAttrMask attrRecordMask) {
+    Rays transferEventsBatch(DevHost& devHost, Queue q, const int numEventsBatch, const RayAttrMask attrRecordMask, const int bufferIndex) {
         const auto transfer = [&]<typename T>(std::vector<T>& dst, const OptBuf<Acc, T>& d_compactEventsBatch) {
             // resize to fit source events and element events
             dst.resize(numEventsBatch);
@@ -367,7 +1055,7 @@ class MegaKernelTracer : public DeviceTracer {
         Rays h_compactEventsBatch;
 
 #define X(type, name, flag) \
-    if (contains(attrRecordMask, RayAttrMask::flag)) transfer(h_compactEventsBatch.name, m_resources.d_compactEventsBatch.name);
+    if (contains(attrRecordMask, RayAttrMask::flag)) transfer(h_compactEventsBatch.name, m_resources.d_compactEventsBatch[bufferIndex].name);
 
         RAYX_X_MACRO_RAY_ATTR
 #undef X
@@ -9,11 +9,12 @@ namespace {
 using DeviceType  = rayx::DeviceConfig::DeviceType;
 using DeviceIndex = rayx::DeviceConfig::Device::Index;
 
-inline std::shared_ptr<rayx::DeviceTracer> createDeviceTracer(DeviceType deviceType, DeviceIndex deviceIndex) {
+inline std::shared_ptr<rayx::DeviceTracer> createDeviceTracer(DeviceType deviceType, DeviceIndex deviceIndex,
+                                                              const rayx::TracerConfig& tracerConfig) {
     switch (deviceType) {
         case DeviceType::GpuCuda:
 #if defined(RAYX_CUDA_ENABLED)
-            return std::make_shared<rayx::MegaKernelTracer<alpaka::TagGpuCudaRt>>(deviceIndex);
+            return std::make_shared<rayx::MegaKernelTracer<alpaka::TagGpuCudaRt>>(deviceIndex, tracerConfig);
 #else
             RAYX_EXIT << "Failed to create Tracer with Cuda device. Cuda was disabled during build.";
             return nullptr;
@@ -25,43 +26,89 @@ inline std::shared_ptr<rayx::DeviceTracer> createDeviceTracer(DeviceType deviceT
             RAYX_WARN << "warning: rayx-core was compiled without OpenMP. The CPU tracer will run in a single thread.";
             using TagCpu = alpaka::TagCpuSerial;
 #endif
-            return std::make_shared<rayx::MegaKernelTracer<TagCpu>>(deviceIndex);
+            return std::make_shared<rayx::MegaKernelTracer<TagCpu>>(deviceIndex, tracerConfig);
     }
 }
 
 int defaultNonSequentialMaxEvents(const int numObjects) { return rayx::defaultMaxEvents(numObjects); }
 
+int calcMaxEvents(const rayx::ObjectIndexMask& objectRecordMask, const rayx::Sequential sequential, const std::optional<int> maxEvents) {
+    // in sequential mode maxEvents will be the same as the number of objects to record
+    return sequential == rayx::Sequential::Yes ? objectRecordMask.numObjects()
+                                               // in non-sequential mode maxEvents is optional, if not set, it will be estimated
+                                               : (maxEvents ? *maxEvents : defaultNonSequentialMaxEvents(objectRecordMask.numObjects()));
+}
+
+void checkEventFilters(const std::vector<rayx::EventFilter>& eventFilters, const rayx::ObjectIndexMask& objectRecordMask,
+                       const char* caller) {
+    for (const auto& eventFilter : eventFilters) {
+        if (eventFilter.objectId < -1 || objectRecordMask.numObjects() <= eventFilter.objectId)
+            RAYX_EXIT << caller << ": object id " << eventFilter.objectId << " of event filter is out of bounds [-1, " << objectRecordMask.numObjects()
+                      << ")";
+    }
+}
+
 }  // unnamed namespace
 
 namespace rayx {
 
-Tracer::Tracer(const DeviceConfig& deviceConfig) {
+Tracer::Tracer(const DeviceConfig& deviceConfig, const TracerConfig& tracerConfig) {
     if (deviceConfig.enabledDevicesCount() != 1) RAYX_EXIT << "The number of selected devices must be exactly 1!";
 
     for (const auto& device : deviceConfig.devices) {
         if (device.enable) {
             RAYX_VERB << "Creating tracer with device: " << device.name;
-            m_deviceTracer = createDeviceTracer(device.type, device.index);
+            m_deviceTracer = createDeviceTracer(device.type, device.index, tracerConfig);
             break;
         }
     }
 }
 
 Rays Tracer::trace(const Group& group, const Sequential sequential, const ObjectMask& objectRecordMask, const RayAttrMask attrRecordMask,
-                   std::optional<int> maxEvents, std::optional<int> maxBatchSize) {
+                   std::optional<int> maxEvents, std::optional<int> maxBatchSize, const std::vector<EventFilter>& eventFilters) {
+    auto batches = std::vector<Rays>();
+    traceStreaming(
+        group, [&batches](Rays&& batch) { batches.push_back(std::move(batch)); }, sequential, objectRecordMask, attrRecordMask, maxEvents,
+        maxBatchSize, eventFilters);
+    return Rays::concat(batches);
+}
+
+void Tracer::traceStreaming(const Group& group, const RaysSink& sink, const Sequential sequential, const ObjectMask& objectRecordMask,
+                            const RayAttrMask attrRecordMask, std::optional<int> maxEvents, std::optional<int> maxBatchSize,
+                            const std::vector<EventFilter>& eventFilters) {
     const auto actualObjectRecordMask = objectRecordMask.toObjectIndexMask(group.numSources(), group.numElements());
+    checkEventFilters(eventFilters, actualObjectRecordMask, "Tracer::traceStreaming");
 
-    const auto actualMaxEvents =
-        // in sequential mode maxEvents will be the same as the number of objects to record
-        sequential == Sequential::Yes ? actualObjectRecordMask.numObjects()
-                                      // in non-sequential mode maxEvents is optional, if not set, it will be estimated
-                                      : (maxEvents ? *maxEvents : defaultNonSequentialMaxEvents(actualObjectRecordMask.numObjects()));
+    const auto actualMaxEvents = calcMaxEvents(actualObjectRecordMask, sequential, maxEvents);
 
-    const auto actualMaxBatchSize = maxBatchSize ? *maxBatchSize : DEFAULT_BATCH_SIZE;
+    // the device tracer picks the batch size, if it is not set
+    m_deviceTracer->traceStreaming(group, sequential, actualObjectRecordMask, attrRecordMask, actualMaxEvents, maxBatchSize, eventFilters,
+                                   [&sink](Rays&& batch) {
+                                       if (!batch.isValid())
+                                           RAYX_EXIT << "Tracer::traceStreaming: one or more recorded attributes have different number of items.";
+                                       sink(std::move(batch));
+                                   });
+}
+
+std::vector<Histogram> Tracer::traceHistograms(const Group& group, const std::vector<HistogramConfig>& histograms, const Sequential sequential,
+                                               const ObjectMask& objectRecordMask, std::optional<int> maxEvents, std::optional<int> maxBatchSize,
+                                               const std::vector<EventFilter>& eventFilters) {
+    const auto actualObjectRecordMask = objectRecordMask.toObjectIndexMask(group.numSources(), group.numElements());
+    const auto actualMaxEvents        = calcMaxEvents(actualObjectRecordMask, sequential, maxEvents);
+    checkEventFilters(eventFilters, actualObjectRecordMask, "Tracer::traceHistograms");
+
+    for (const auto& histogram : histograms) {
+        if (histogram.objectId < 0 || actualObjectRecordMask.numObjects() <= histogram.objectId)
+            RAYX_EXIT << "Tracer::traceHistograms: object id " << histogram.objectId << " of histogram is out of bounds [0, "
+                      << actualObjectRecordMask.numObjects() << ")";
+        for (const auto& axis : {histogram.x, histogram.y}) {
+            if (axis.numBins < 1 || (axis.attr != HistogramAttr::None && !(axis.min < axis.max)))
+                RAYX_EXIT << "Tracer::traceHistograms: histogram axes require at least one bin and min < max";
+        }
+    }
 
-    auto rays = m_deviceTracer->trace(group, sequential, actualObjectRecordMask, attrRecordMask, actualMaxEvents, actualMaxBatchSize);
-    if (!rays.isValid()) RAYX_EXIT << "Tracer::trace: one or more recorded attributes have different number of items.";
-    return rays;
+    return m_deviceTracer->traceHistograms(group, sequential, actualObjectRecordMask, actualMaxEvents, maxBatchSize, eventFilters,
+                                           histograms);
 }
 
 }  // namespace rayx
@@ -8,14 +8,11 @@
 #include "DeviceConfig.h"
 #include "DeviceTracer.h"
 #include "Rays.h"
+#include "TracerConfig.h"
 
 // Abstract Tracer base class.
 namespace rayx {
 
-// this value is picked in a 'good' way if it can divide number of rays without rest. for a number of rays picked by humans, this
-// value is probably good. though, if it could be power of two, the shader would benefit
-constexpr int DEFAULT_BATCH_SIZE = 100000;
-
 constexpr int defaultMaxEvents(const int numObjects) { return numObjects * 2 + 8; }
 
 class RAYX_API Tracer {
@@ -23,8 +20,9 @@ class RAYX_API Tracer {
     /**
      * @brief Construct a new Tracer object
      * @param deviceConfig Configuration for the device to be used for tracing
+     * @param tracerConfig Optional optimizations of the tracer
      */
-    Tracer(const DeviceConfig& deviceConfig = DeviceConfig().enableBestDevice());
+    Tracer(const DeviceConfig& deviceConfig = DeviceConfig().enableBestDevice(), const TracerConfig& tracerConfig = TracerConfig());
 
     // This will call the trace implementation of a subclass
     // See `BundleHistory` for information about the return value.
@@ -37,12 +35,51 @@ class RAYX_API Tracer {
      *  @param objectRecordMask Object record mask specifying which sources and elements to record
      *  @param attrRecordMask Attributes to record for each ray
      *  @param maxEvents Optional maximum number of events to trace per ray (only used in non-sequential tracing)
-     *  @param maxBatchSize Optional maximum batch size for tracing
-     *  @return A `Rays` struct containing the traced ray attributes, specified by `attrRecordMask` and filtered by `objectRecordMask`
+     *  @param maxBatchSize Optional maximum batch size for tracing. if not set, the batch size is picked from TracerConfig::memoryBudget, or
+     *  DEFAULT_BATCH_SIZE
+     *  @param eventFilters Filters evaluated on the device, that decide which events to record in addition to `objectRecordMask`.
+     *  see `EventFilter`
+     *  @return A `Rays` struct containing the traced ray attributes, specified by `attrRecordMask` and filtered by `objectRecordMask` and
+     *  `eventFilters`
      */
     Rays trace(const Group& group, const Sequential sequential = Sequential::No, const ObjectMask& objectRecordMask = ObjectMask::all(),
                const RayAttrMask attrRecordMask = RayAttrMask::All, std::optional<int> maxEvents = std::nullopt,
-               std::optional<int> maxBatchSize = std::nullopt);
+               std::optional<int> maxBatchSize = std::nullopt, const std::vector<EventFilter>& eventFilters = {});
+
+    /**
+     *  @brief Trace rays through the given group and pass the recorded events batch by batch to a sink
+     *  Unlike `trace`, the events of all batches are never held in memory at once. The sink may write, reduce or drop each batch.
+     *  @param group The group to trace rays through
+     *  @param sink Receives the recorded events of each batch as soon as they are available, in order of batches
+     *  @param sequential Whether to trace rays sequentially or non-sequentially
+     *  @param objectRecordMask Object record mask specifying which sources and elements to record
+     *  @param attrRecordMask Attributes to record for each ray
+     *  @param maxEvents Optional maximum number of events to trace per ray (only used in non-sequential tracing)
+     *  @param maxBatchSize Optional maximum batch size for tracing. see `trace`
+     *  @param eventFilters Filters evaluated on the device, that decide which events to record. see `trace`
+     */
+    void traceStreaming(const Group& group, const RaysSink& sink, const Sequential sequential = Sequential::No,
+                        const ObjectMask& objectRecordMask = ObjectMask::all(), const RayAttrMask attrRecordMask = RayAttrMask::All,
+                        std::optional<int> maxEvents = std::nullopt, std::optional<int> maxBatchSize = std::nullopt,
+                        const std::vector<EventFilter>& eventFilters = {});
+
+    /**
+     *  @brief Trace rays through the given group and accumulate histograms of the events on the device, instead of recording the events
+     *  Only the bins of the histograms are transferred back to the host. This is much faster than `trace`, if only e.g. intensity maps,
+     *  energy spectra or footprints are of interest.
+     *  @param group The group to trace rays through
+     *  @param histograms The histograms to accumulate. see `HistogramConfig`
+     *  @param sequential Whether to trace rays sequentially or non-sequentially
+     *  @param objectRecordMask Object record mask specifying which sources and elements contribute to the histograms
+     *  @param maxEvents Optional maximum number of events to trace per ray (only used in non-sequential tracing)
+     *  @param maxBatchSize Optional maximum batch size for tracing. see `trace`
+     *  @param eventFilters Filters evaluated on the device, that decide which events contribute to the histograms. see `trace`
+     *  @return The accumulated histograms, in the order of `histograms`
+     */
+    std::vector<Histogram> traceHistograms(const Group& group, const std::vector<HistogramConfig>& histograms,
+                                           const Sequential sequential = Sequential::No, const ObjectMask& objectRecordMask = ObjectMask::all(),
+                                           std::optional<int> maxEvents = std::nullopt, std::optional<int> maxBatchSize = std::nullopt,
+                                           const std::vector<EventFilter>& eventFilters = {});
 
   private:
     std::shared_ptr<DeviceTracer> m_deviceTracer;
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <optional>
+
+#include "Core.h"
+#include "Element/ReflectivityTable.h"
+#include "Element/Surface.h"
+#include "Material/RefractiveIndexLut.h"
+
+namespace rayx {
+
+/**
+ * @brief Configuration of event recording by atomic append.
+ * Each batch starts with a buffer of `initialEventsPerRay` events per ray. If a batch records more events than fit, the buffer grows to
+ * `growthFactor` times the number of recorded events and the batch is traced again.
+ */
+struct RAYX_API AppendEventsConfig {
+    double initialEventsPerRay = 4.0;
+    double growthFactor        = 1.5;
+};
+
+/// optional optimizations of the tracer, that trade accuracy or memory for speed. all of them are disabled by default
+struct RAYX_API TracerConfig {
+    /// resample the refractive indices of the used materials onto an energy grid covering the energies of the sources.
+    /// see RefractiveIndexLutConfig
+    std::optional<RefractiveIndexLutConfig> refractiveIndexLut;
+
+    /// tabulate the reflection amplitudes of mirrors with a single layer or multilayer coating over energy and incidence angle.
+    /// see ReflectivityTableConfig
+    std::optional<ReflectivityTableConfig> reflectivityTable;
+
+    /// method to intersect rays with toroids. the default reproduces the results of RAY-UI, the others need fewer newton steps.
+    /// see ToroidSolver
+    ToroidSolver toroidSolver = ToroidSolver::Newton;
+
+    /// trace sequential beamlines in packets of RAY_PACKET_SIZE rays on CPU devices, with the transforms and the plane and quadric collisions of a
+    /// packet in SIMD lanes. the results are bitwise identical to tracing ray by ray. ignored on GPU devices and for non-sequential tracing
+    bool rayPackets = false;
+
+    /// append recorded events to a compact buffer with atomic counters, instead of storing them in a dense buffer with a slot for every possible
+    /// event (num rays * max events) and compacting it afterwards. device memory then scales with the number of recorded events.
+    /// the order of the events of a batch is unspecified, except that the events of a ray path keep their order. see AppendEventsConfig
+    std::optional<AppendEventsConfig> appendEvents;
+
+    /// maximum number of bytes of device and host memory used for the buffers of a batch. if set, the largest batch size that fits into the
+    /// budget and into the free device and host memory is picked, unless a smaller maximum batch size is given to Tracer::trace.
+    /// batch sizes are multiples of the grid stride. applies to Tracer::traceHistograms as well, which needs no buffers for events
+    std::optional<size_t> memoryBudget;
+};
+
+}  // namespace rayx
@@ -10,6 +10,10 @@
 
 namespace rayx {
 
+/// number of buffer sets used for pipelined batch execution. while one batch is traced, the rays of the next batch are generated and the recorded
+/// events of the previous batch are transferred to the host
+constexpr int NUM_BATCH_BUFFERS = 2;
+
 template <typename Acc, typename T>
 using OptBuf = std::optional<alpaka::Buf<Acc, T, alpaka::DimInt<1>, int32_t>>;
 
@@ -1,8 +1,12 @@
 #include "CsvWriter.h"
 
+#include <charconv>
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <queue>
+#include <string_view>
+#include <thread>
 
 #include "Beamline/StringConversion.h"
 #include "Debug/Debug.h"
@@ -19,25 +23,31 @@ constexpr int PADDING = 0;  // extra spaces on the left side in each cell for be
 // constexpr int MAX_CELL_SIZE_FLOAT  = 16 + PADDING;
 constexpr int MAX_CELL_SIZE_DOUBLE = 24 + PADDING;
 constexpr int MAX_CELL_SIZE_INT    = 11 + PADDING;
+constexpr int MAX_CELL_SIZE_INT64  = 20 + PADDING;
 constexpr int MAX_CELL_SIZE_UINT64 = 20 + PADDING;
 constexpr char DELIMITER           = ',';
 
+constexpr int64_t CSV_CHUNK_ROWS  = 1 << 14;  // number of rows formatted by a thread at once
+constexpr int64_t CSV_CHUNK_BYTES = 1 << 22;  // minimum number of bytes parsed by a thread
+
 std::string trimWhitespaces(std::string s) {
     s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](unsigned char ch) { return !std::isspace(ch); }));
     s.erase(std::find_if(s.rbegin(), s.rend(), [](unsigned char ch) { return !std::isspace(ch); }).base(), s.end());
     return s;
 }
 
-std::string formatAsString(const double v) {
-    // std::format gives us the exact number of digits, that correctly represent the double.
-    return std::format("{}", v);
+// formats a value into [first, last). doubles are formatted with the shortest representation, that reads back to the same value
+template <typename T>
+std::to_chars_result formatAsChars(char* first, char* last, const T v) {
+    return std::to_chars(first, last, v);
 }
 
-std::string formatAsString(const int v) { return std::to_string(v); }
-
-std::string formatAsString(const EventType v) { return EventTypeToString.at(v); }
-
-std::string formatAsString(const RandCounter v) { return std::to_string(v); }
+template <>
+std::to_chars_result formatAsChars<EventType>(char* first, char* last, const EventType v) {
+    const auto& str = EventTypeToString.at(v);
+    if (last - first < static_cast<std::ptrdiff_t>(str.size())) return {last, std::errc::value_too_large};
+    return {std::copy(str.begin(), str.end(), first), std::errc()};
+}
 
 template <typename T>
 int calcCellSize(const std::string header);
@@ -52,6 +62,11 @@ int calcCellSize<int>(const std::string header) {
     return std::max(MAX_CELL_SIZE_INT, static_cast<int>(header.size()) + PADDING);
 }
 
+template <>
+int calcCellSize<int64_t>(const std::string header) {
+    return std::max(MAX_CELL_SIZE_INT64, static_cast<int>(header.size()) + PADDING);
+}
+
 template <>
 int calcCellSize<EventType>(const std::string header) {
     int maxSize = 0;
@@ -89,11 +104,6 @@ std::string formatAsCell(std::string s, const int size) {
     return s;
 }
 
-template <typename T>
-std::string formatAsCell(const T v, const int size) {
-    return formatAsCell(formatAsString(v), size);
-}
-
 void writeCsvHeader(std::ostream& os, const RayAttrMask attr, const std::vector<int>& cellSizes) {
     const auto numAttr = countSetBits(attr);
     int attrCount      = 0;
@@ -119,54 +129,87 @@ void writeCsvHeader(std::ostream& os, const RayAttrMask attr, const std::vector<
 #undef X
 }
 
-void writeCsvBodyLine(std::ostream& os, const int i, const RayAttrMask attr, const Rays& rays, const std::vector<int>& cellSizes) {
-    const auto numAttr = countSetBits(attr);
-    auto attrCount     = 0;
+// cells have a fixed size, so every row of a csv file has the same size
+int calcRowSize(const RayAttrMask attr, const std::vector<int>& cellSizes) {
+    auto rowSize   = 0;
+    auto attrCount = 0;
 
-    auto writeCell = [&]<typename T>(const std::vector<T>& src, const RayAttrMask flag) {
-        if constexpr (std::is_same_v<T, complex::Complex>) {
-            if (contains(attr, flag)) {
-                os << formatAsCell(src[i].real(), cellSizes.at(attrCount)) << DELIMITER;
-                os << formatAsCell(src[i].imag(), cellSizes.at(attrCount));
-                if (++attrCount < numAttr) os << DELIMITER;
-            }
-        } else {
-            if (contains(attr, flag)) {
-                os << formatAsCell(src[i], cellSizes.at(attrCount));
-                if (++attrCount < numAttr) os << DELIMITER;
-            }
-        }
+    auto addCell = [&]<typename T>(const RayAttrMask flag) {
+        if (!contains(attr, flag)) return;
+        const auto cellSize = cellSizes.at(attrCount++);
+        rowSize += std::is_same_v<T, complex::Complex> ? 2 * cellSize + 2 : cellSize + 1;  // cells, delimiters and newline
     };
 
-#define X(type, name, flag) writeCell(rays.name, RayAttrMask::flag);
+#define X(type, name, flag) addCell.operator()<type>(RayAttrMask::flag);
     RAYX_X_MACRO_RAY_ATTR
 #undef X
+
+    return rowSize;
 }
 
+// formats the value right aligned into a cell of `size` characters
 template <typename T>
-T readCell(const std::string& cell);
-
-template <>
-double readCell<double>(const std::string& cell) {
-    return std::stod(cell);
+void formatCell(char* cell, const int size, const T v) {
+    char str[MAX_CELL_SIZE_DOUBLE + 8];
+    const auto [end, ec] = formatAsChars(str, str + sizeof(str), v);
+    const auto length    = static_cast<int>(end - str);
+    if (ec != std::errc() || size < length)
+        RAYX_EXIT << "cell: value \"" << std::string_view(str, ec == std::errc() ? length : 0) << "\" needs to be shortened! maximum size: " << size;
+
+    std::fill(cell, cell + size - length, ' ');
+    std::copy(str, end, cell + size - length);
 }
 
-template <>
-int readCell<int>(const std::string& cell) {
-    return std::stoi(cell);
-}
+// formats the rows [begin, end) into `dst`, column by column. each row occupies `rowSize` characters
+void formatCsvRows(char* dst, const int64_t begin, const int64_t end, const RayAttrMask attr, const Rays& rays, const std::vector<int>& cellSizes,
+                   const int rowSize) {
+    const auto numAttr = countSetBits(attr);
+    auto attrCount     = 0;
+    auto column        = 0;  // offset of the current cell in a row
+
+    auto formatColumn = [&]<typename T>(const std::vector<T>& src, const RayAttrMask flag) {
+        if (!contains(attr, flag)) return;
+
+        const auto cellSize  = cellSizes.at(attrCount);
+        const auto separator = ++attrCount < numAttr ? DELIMITER : '\n';
+        for (int64_t i = begin; i < end; ++i) {
+            auto* cell = dst + (i - begin) * rowSize + column;
+            if constexpr (std::is_same_v<T, complex::Complex>) {
+                formatCell(cell, cellSize, src[i].real());
+                cell[cellSize] = DELIMITER;
+                formatCell(cell + cellSize + 1, cellSize, src[i].imag());
+                cell[2 * cellSize + 1] = separator;
+            } else {
+                formatCell(cell, cellSize, src[i]);
+                cell[cellSize] = separator;
+            }
+        }
+        column += std::is_same_v<T, complex::Complex> ? 2 * cellSize + 2 : cellSize + 1;
+    };
 
-template <>
-EventType readCell<EventType>(const std::string& cell) {
-    return StringToEventType.at(trimWhitespaces(cell));
+#define X(type, name, flag) formatColumn(rays.name, RayAttrMask::flag);
+    RAYX_X_MACRO_RAY_ATTR
+#undef X
 }
 
-template <>
-RandCounter readCell<RandCounter>(const std::string& cell) {
-    // check if the usage of std::stoull is correct
-    static_assert(std::is_same_v<RandCounter, uint64_t>);
-    static_assert(sizeof(RandCounter) <= sizeof(decltype(std::stoull(cell))));
-    return std::stoull(cell);
+bool isWhitespace(const char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// parses a cell, that may be surrounded by whitespaces
+template <typename T>
+T readCell(std::string_view cell) {
+    while (!cell.empty() && isWhitespace(cell.front())) cell.remove_prefix(1);
+    while (!cell.empty() && isWhitespace(cell.back())) cell.remove_suffix(1);
+
+    if constexpr (std::is_same_v<T, EventType>) {
+        const auto it = StringToEventType.find(std::string(cell));
+        if (it == StringToEventType.end()) RAYX_EXIT << "error: unknown event type in csv cell: '" << cell << "'";
+        return it->second;
+    } else {
+        auto v               = T();
+        const auto [end, ec] = std::from_chars(cell.data(), cell.data() + cell.size(), v);
+        if (ec != std::errc() || end != cell.data() + cell.size()) RAYX_EXIT << "error: unable to parse csv cell: '" << cell << "'";
+        return v;
+    }
 }
 
 std::vector<RayAttrMask> readCsvHeader(const std::string& line) {
@@ -208,63 +251,131 @@ std::vector<RayAttrMask> readCsvHeader(const std::string& line) {
     return attrs;
 }
 
-void readCsvBodyLine(Rays& rays, const std::vector<RayAttrMask>& attrs, const std::string& line) {
-    auto ss = std::istringstream(line);
-    std::string item;
+// parses the lines of `body` into `rays`
+void readCsvBody(Rays& rays, const std::vector<RayAttrMask>& attrs, std::string_view body) {
+    std::string_view line;
+    auto nextCell = [&] {
+        const auto pos  = line.find(DELIMITER);
+        const auto cell = line.substr(0, pos);
+        line            = pos == std::string_view::npos ? std::string_view() : line.substr(pos + 1);
+        return cell;
+    };
+
     auto consumeCell = [&]<typename T>(std::vector<T>& dst) {
         if constexpr (std::is_same_v<T, complex::Complex>) {
-            std::getline(ss, item, DELIMITER);
-            const auto real = readCell<typename T::value_type>(item);
-            std::getline(ss, item, DELIMITER);
-            const auto imag = readCell<typename T::value_type>(item);
+            const auto real = readCell<typename T::value_type>(nextCell());
+            const auto imag = readCell<typename T::value_type>(nextCell());
             dst.emplace_back(real, imag);
         } else {
-            std::getline(ss, item, DELIMITER);
-            dst.push_back(readCell<T>(item));
+            dst.push_back(readCell<T>(nextCell()));
         }
     };
 
-    for (const auto attr : attrs) {
-        switch (attr) {
+    while (!body.empty()) {
+        const auto pos = body.find('\n');
+        line           = body.substr(0, pos);
+        body           = pos == std::string_view::npos ? std::string_view() : body.substr(pos + 1);
+        if (line.find_first_not_of(" \t\r") == std::string_view::npos) continue;
+
+        for (const auto attr : attrs) {
+            switch (attr) {
 #define X(type, name, flag)     \
     case RayAttrMask::flag:     \
         consumeCell(rays.name); \
         break;
-            RAYX_X_MACRO_RAY_ATTR
+                RAYX_X_MACRO_RAY_ATTR
 #undef X
-            default:
-                RAYX_EXIT << "error: unknown attribute: '" << to_string(attr) << "'";
+                default:
+                    RAYX_EXIT << "error: unknown attribute: '" << to_string(attr) << "'";
+            }
         }
     }
 }
 
+// number of threads to process `numItems` items, of which each thread processes at least `minItemsPerThread`
+int calcNumThreads(const int64_t numItems, const int64_t minItemsPerThread) {
+    const auto maxThreads = std::max(int64_t{1}, numItems / minItemsPerThread);
+    return static_cast<int>(std::clamp<int64_t>(std::thread::hardware_concurrency(), 1, maxThreads));
+}
+
 }  // namespace
 
 void writeCsv(const fs::path& filepath, const Rays& rays) {
-    const auto attr      = rays.attrMask();
-    const auto cellSizes = calcCellSizes(attr);
+    auto writer = CsvRaysWriter(filepath, rays.attrMask());
+    writer.write(rays);
+}
+
+CsvRaysWriter::CsvRaysWriter(const fs::path& filepath, const RayAttrMask attr)
+    : m_file(filepath, std::ios::binary), m_attr(attr), m_cellSizes(calcCellSizes(attr)), m_rowSize(calcRowSize(attr, m_cellSizes)) {
+    writeCsvHeader(m_file, m_attr, m_cellSizes);
+    m_file << '\n';
+}
 
-    auto file = std::ofstream(filepath);
+void CsvRaysWriter::write(const Rays& rays) {
+    RAYX_PROFILE_FUNCTION_STDOUT();
 
-    writeCsvHeader(file, attr, cellSizes);
-    file << '\n';
+    if (rays.empty()) return;
 
-    const auto size = rays.size();
-    for (int i = 0; i < size; i++) {
-        writeCsvBodyLine(file, i, attr, rays, cellSizes);
-        file << '\n';
+    if (!contains(rays.attrMask(), m_attr))
+        RAYX_EXIT << "error: cannot write rays to csv file, because the rays do not contain all attributes specified in the attribute mask: "
+                  << to_string(m_attr) << ". The rays contain the following attributes: " << to_string(rays.attrMask());
+
+    // the rows are formatted in chunks, that are distributed over all hardware threads. each round of chunks is written with a single write
+    const auto size       = rays.size();
+    const auto numThreads = calcNumThreads(size, CSV_CHUNK_ROWS);
+    const auto roundRows  = numThreads * CSV_CHUNK_ROWS;
+
+    for (int64_t roundBegin = 0; roundBegin < size; roundBegin += roundRows) {
+        const auto roundEnd = std::min(size, roundBegin + roundRows);
+        m_buffer.resize(static_cast<size_t>(roundEnd - roundBegin) * m_rowSize);
+
+        const auto formatChunk = [&](const int threadIndex) {
+            const auto begin = std::min(roundEnd, roundBegin + threadIndex * CSV_CHUNK_ROWS);
+            const auto end   = std::min(roundEnd, begin + CSV_CHUNK_ROWS);
+            formatCsvRows(m_buffer.data() + (begin - roundBegin) * m_rowSize, begin, end, m_attr, rays, m_cellSizes, m_rowSize);
+        };
+
+        auto futures = std::vector<std::future<void>>();
+        for (int t = 1; t < numThreads; ++t) futures.push_back(std::async(std::launch::async, formatChunk, t));
+        formatChunk(0);
+        for (auto& future : futures) future.get();
+
+        m_file.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
     }
 }
 
 Rays readCsv(const fs::path& filepath) {
-    auto file = std::ifstream(filepath);
-    std::string line;
-    std::getline(file, line);
-    const auto attrs = readCsvHeader(line);
+    RAYX_PROFILE_FUNCTION_STDOUT();
+
+    // read the whole file with a single read, then parse it in place
+    auto file = std::ifstream(filepath, std::ios::binary);
+    if (!file) RAYX_EXIT << "error: unable to open csv file: " << filepath;
+    auto content = std::string(static_cast<size_t>(fs::file_size(filepath)), '\0');
+    file.read(content.data(), static_cast<std::streamsize>(content.size()));
+
+    const auto headerEnd = std::min(content.find('\n'), content.size());
+    const auto attrs     = readCsvHeader(content.substr(0, headerEnd));
+    const auto body      = std::string_view(content).substr(std::min(headerEnd + 1, content.size()));
+
+    // split the body at line breaks into chunks, that are parsed in parallel
+    const auto numThreads = calcNumThreads(static_cast<int64_t>(body.size()), CSV_CHUNK_BYTES);
+    const auto chunkSize  = body.size() / numThreads + 1;
+    auto chunks           = std::vector<std::string_view>();
+    for (size_t begin = 0; begin < body.size();) {
+        const auto lineBreak = body.find('\n', std::min(body.size(), begin + chunkSize) - 1);
+        const auto end       = lineBreak == std::string_view::npos ? body.size() : lineBreak + 1;
+        chunks.push_back(body.substr(begin, end - begin));
+        begin = end;
+    }
 
-    Rays rays;
-    while (std::getline(file, line)) readCsvBodyLine(rays, attrs, line);
+    auto chunkRays = std::vector<Rays>(chunks.size());
+    auto futures   = std::vector<std::future<void>>();
+    for (size_t i = 1; i < chunks.size(); ++i)
+        futures.push_back(std::async(std::launch::async, [&, i] { readCsvBody(chunkRays[i], attrs, chunks[i]); }));
+    if (!chunks.empty()) readCsvBody(chunkRays[0], attrs, chunks[0]);
+    for (auto& future : futures) future.get();
 
+    auto rays = chunkRays.size() == 1 ? std::move(chunkRays[0]) : Rays::concat(chunkRays);
     if (!rays.isValid()) RAYX_EXIT << "error: one or more recorded attributes have different number of items";
     return rays;
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <fstream>
 #include <string>
 #include <vector>
 
@@ -12,4 +13,20 @@ namespace rayx {
 void RAYX_API writeCsv(const std::filesystem::path& filepath, const Rays& rays);
 Rays RAYX_API readCsv(const std::filesystem::path& filepath);
 
+/// writes rays to a csv file batch by batch. the header is written on construction, then every call to `write` appends the rows of one batch.
+/// all batches must contain the attributes specified by `attr`
+class RAYX_API CsvRaysWriter {
+  public:
+    CsvRaysWriter(const std::filesystem::path& filepath, const RayAttrMask attr);
+
+    void write(const Rays& rays);
+
+  private:
+    std::ofstream m_file;
+    RayAttrMask m_attr;
+    std::vector<int> m_cellSizes;
+    int m_rowSize;
+    std::vector<char> m_buffer;  // formatted rows of a batch, reused across batches
+};
+
 }  // namespace rayx
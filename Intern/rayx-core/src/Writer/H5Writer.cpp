@@ -2,6 +2,8 @@
 
 #include "H5Writer.h"
 
+#include <algorithm>
+#include <numeric>
 #include <highfive/highfive.hpp>
 
 #include "Debug/Debug.h"
@@ -31,6 +33,54 @@ inline HighFive::DataType highfive_create_type_Complex() {
 HIGHFIVE_REGISTER_TYPE(rayx::EventType, highfive_create_type_EventType);
 HIGHFIVE_REGISTER_TYPE(rayx::complex::Complex, highfive_create_type_Complex);
 
+namespace {
+constexpr auto EVENTS_GROUP   = "rayx/events";
+constexpr auto OBJECT_NAMES   = "rayx/object_names";
+constexpr auto NUM_EVENTS     = "rayx/num_events";
+constexpr auto INDEX_GROUP    = "rayx/index";
+constexpr auto OBJECT_COUNTS  = "rayx/index/object_counts";
+constexpr auto OBJECT_OFFSETS = "rayx/index/object_offsets";
+
+// number of events of which object_id is read at once, when the events of an object are searched in files without index
+constexpr int64_t OBJECT_SCAN_CHUNK_SIZE = int64_t{1} << 20;
+
+HighFive::Group getOrCreateGroup(HighFive::File& file, const std::string& address) {
+    return file.exist(address) ? file.getGroup(address) : file.createGroup(address);
+}
+
+HighFive::DataSetCreateProps createEventsProps(const rayx::H5WriterConfig& config) {
+    auto props = HighFive::DataSetCreateProps();
+    props.add(HighFive::Chunking(std::vector<hsize_t>{std::max(config.chunkSize, size_t{1})}));
+    if (config.shuffle) props.add(HighFive::Shuffle());
+    if (config.deflateLevel > 0) {
+        // deflate is an optional filter of the hdf5 library
+        if (H5Zfilter_avail(H5Z_FILTER_DEFLATE) > 0)
+            props.add(HighFive::Deflate(std::min(config.deflateLevel, 9)));
+        else
+            RAYX_WARN << "the hdf5 library was built without deflate compression. writing uncompressed events";
+    }
+    return props;
+}
+
+// reads the events [begin, end) of a dataset
+template <typename T>
+void readHyperSlab(const HighFive::DataSet& dataset, const int64_t begin, const int64_t end, std::vector<T>& dst) {
+    dst.clear();
+    if (begin == end) return;
+    dataset.select({static_cast<size_t>(begin)}, {static_cast<size_t>(end - begin)}).read(dst);
+}
+
+std::vector<std::string> getRayAttrNames(const rayx::RayAttrMask attr) {
+    auto names = std::vector<std::string>();
+#define X(type, name, flag) \
+    if (contains(attr, rayx::RayAttrMask::flag)) names.push_back(#name);
+
+    RAYX_X_MACRO_RAY_ATTR
+#undef X
+    return names;
+}
+}  // unnamed namespace
+
 namespace rayx {
 
 // TODO: this function should not require, that attr is known beforehand. Mabye we should use attr only to further exclude attributes? Or provide an
@@ -71,7 +121,7 @@ std::vector<std::string> readH5ObjectNames(const std::filesystem::path& filepath
     try {
         auto file = HighFive::File(filepath.string(), HighFive::File::ReadOnly);
 
-        file.getDataSet("/rayx/object_names").read(object_names);
+        file.getDataSet(OBJECT_NAMES).read(object_names);
     } catch (const std::exception& e) { RAYX_EXIT << "exception caught while attempting to read h5 file: " << e.what(); }
 
     return object_names;
@@ -80,57 +130,332 @@ std::vector<std::string> readH5ObjectNames(const std::filesystem::path& filepath
 void writeH5(const std::filesystem::path& filepath, const std::vector<std::string>& object_names, const Rays& rays, const RayAttrMask attr,
              const bool overwrite) {
     RAYX_PROFILE_FUNCTION_STDOUT();
-    RAYX_VERB << "write rays to " << filepath << " with attribute flags: " << to_string(attr);
 
-    if (!contains(rays.attrMask(), attr))
-        RAYX_EXIT << "Cannot write rays to output file '" << filepath
-                  << "' because the rays do not contain all attributes specified in the attribute mask: " << to_string(attr)
-                  << ". The rays contain the following attributes: " << to_string(rays.attrMask());
+    auto writer = H5RaysWriter(filepath, object_names, attr, H5WriterConfig(), overwrite);
+    writer.write(rays);
+}
+
+void appendH5(const std::filesystem::path& filepath, const Rays& rays, const RayAttrMask attr) {
+    RAYX_PROFILE_FUNCTION_STDOUT();
+
+    if (rays.empty()) return;
+
+    auto writer = H5RaysWriter::append(filepath, attr);
+    writer.write(rays);
+}
+
+struct H5RaysWriter::Impl {
+    HighFive::File file;
+    std::filesystem::path filepath;
+    RayAttrMask attr;
+    int64_t numEvents;
+
+    // the object index counts the events of each object. the offsets of the events of each object are only valid, as long as the written
+    // events are sorted by object_id
+    int numObjects;
+    bool hasObjectIndex;
+    bool sortedByObjectId;
+    int lastObjectId;
+    std::vector<int64_t> objectCounts;
+
+    // updates the object index in a single pass over the object ids of a batch
+    void updateObjectIndex(const std::vector<int32_t>& object_id) {
+        if (!hasObjectIndex) return;
+
+        for (const auto id : object_id) {
+            if (id < 0 || numObjects <= id) {
+                RAYX_WARN << "object_id " << id << " is out of range of the " << numObjects << " objects. the object index is not written";
+                hasObjectIndex = false;
+                if (file.exist(INDEX_GROUP)) file.unlink(INDEX_GROUP);
+                return;
+            }
+            if (id < lastObjectId) sortedByObjectId = false;
+            ++objectCounts[id];
+            lastObjectId = id;
+        }
+
+        if (!file.exist(OBJECT_COUNTS)) file.createDataSet<int64_t>(OBJECT_COUNTS, HighFive::DataSpace(objectCounts.size()));
+        file.getDataSet(OBJECT_COUNTS).write(objectCounts);
+
+        if (sortedByObjectId) {
+            auto offsets = std::vector<int64_t>(numObjects + 1, 0);
+            std::inclusive_scan(objectCounts.begin(), objectCounts.end(), offsets.begin() + 1);
+            if (!file.exist(OBJECT_OFFSETS)) file.createDataSet<int64_t>(OBJECT_OFFSETS, HighFive::DataSpace(offsets.size()));
+            file.getDataSet(OBJECT_OFFSETS).write(offsets);
+        } else if (file.exist(OBJECT_OFFSETS)) {
+            file.unlink(OBJECT_OFFSETS);
+        }
+    }
+};
+
+H5RaysWriter::H5RaysWriter(std::unique_ptr<Impl> impl) : m_impl(std::move(impl)) {}
+H5RaysWriter::H5RaysWriter(H5RaysWriter&&) noexcept            = default;
+H5RaysWriter& H5RaysWriter::operator=(H5RaysWriter&&) noexcept = default;
+H5RaysWriter::~H5RaysWriter()                                  = default;
+
+H5RaysWriter::H5RaysWriter(const std::filesystem::path& filepath, const std::vector<std::string>& object_names, const RayAttrMask attr,
+                           const H5WriterConfig& config, const bool overwrite) {
+    RAYX_VERB << "create h5 file " << filepath << " with attribute flags: " << to_string(attr) << ", chunk size: " << config.chunkSize
+              << ", shuffle: " << config.shuffle << ", deflate level: " << config.deflateLevel;
 
     try {
         const auto flags = HighFive::File::ReadWrite | HighFive::File::Create | (overwrite ? HighFive::File::Truncate : HighFive::File::Excl);
         auto file        = HighFive::File(filepath.string(), flags);
 
-#define X(type, name, flag)                                                              \
-    RAYX_VERB << "write ray attribute: " #name " (" << rays.name.size() << " elements)"; \
-    if (contains(attr, RayAttrMask::flag)) file.createDataSet("rayx/events/" #name, rays.name);
+        const auto props = createEventsProps(config);
+        auto events      = getOrCreateGroup(file, EVENTS_GROUP);
+
+#define X(type, name, flag) \
+    if (contains(attr, RayAttrMask::flag)) events.createDataSet<type>(#name, HighFive::DataSpace({0}, {HighFive::DataSpace::UNLIMITED}), props);
 
         RAYX_X_MACRO_RAY_ATTR
 #undef X
 
-        // TODO: store RayAttrMask
-        file.createDataSet("rayx/num_events", rays.size());
-        file.createDataSet("rayx/object_names", object_names);
+        events.createAttribute("attr_names", getRayAttrNames(attr));
+        events.createAttribute("num_events", int64_t{0});
+        file.createDataSet(NUM_EVENTS, int64_t{0});
+        file.createDataSet(OBJECT_NAMES, object_names);
+
+        const auto numObjects = static_cast<int>(object_names.size());
+
+        m_impl = std::make_unique<Impl>(Impl{
+            .file             = std::move(file),
+            .filepath         = filepath,
+            .attr             = attr,
+            .numEvents        = 0,
+            .numObjects       = numObjects,
+            .hasObjectIndex   = contains(attr, RayAttrMask::ObjectId),
+            .sortedByObjectId = true,
+            .lastObjectId     = 0,
+            .objectCounts     = std::vector<int64_t>(numObjects, 0),
+        });
     } catch (const std::exception& e) { RAYX_EXIT << "exception caught while attempting to write h5 file: " << e.what(); }
 }
 
-void appendH5(const std::filesystem::path& filepath, const Rays& rays, const RayAttrMask attr) {
-    // TODO: fix this function
-    assert(false && "unimplemented");
-
-    RAYX_PROFILE_FUNCTION_STDOUT();
+H5RaysWriter H5RaysWriter::append(const std::filesystem::path& filepath, const RayAttrMask attr) {
     RAYX_VERB << "append rays to " << filepath << " with attribute flags: " << to_string(attr);
 
     if (!std::filesystem::is_regular_file(filepath))
         RAYX_EXIT << "Cannot append to output file '" << filepath << "' because it does not exist or is not a regular file.";
 
+    auto impl = std::unique_ptr<Impl>();
+    try {
+        auto file   = HighFive::File(filepath.string(), HighFive::File::ReadWrite);
+        auto events = file.getGroup(EVENTS_GROUP);
+
+        // older files store the number of events only in the dataset rayx/num_events
+        auto numEvents = int64_t{0};
+        if (events.hasAttribute("num_events"))
+            events.getAttribute("num_events").read(numEvents);
+        else if (file.exist(NUM_EVENTS))
+            file.getDataSet(NUM_EVENTS).read(numEvents);
+
+        if (!events.hasAttribute("num_events")) events.createAttribute("num_events", numEvents);
+        if (!file.exist(NUM_EVENTS)) file.createDataSet(NUM_EVENTS, numEvents);
+        if (!events.hasAttribute("attr_names")) events.createAttribute("attr_names", getRayAttrNames(attr));
+
+        // continue the object index of the events in the file. files without index are not indexed, unless they are empty
+        auto objectNames = std::vector<std::string>();
+        file.getDataSet(OBJECT_NAMES).read(objectNames);
+        const auto numObjects = static_cast<int>(objectNames.size());
+        auto objectCounts     = std::vector<int64_t>(numObjects, 0);
+        auto hasObjectIndex   = contains(attr, RayAttrMask::ObjectId) && (numEvents == 0 || file.exist(OBJECT_COUNTS));
+        auto sortedByObjectId = numEvents == 0 || file.exist(OBJECT_OFFSETS);
+        auto lastObjectId     = 0;
+        if (hasObjectIndex && file.exist(OBJECT_COUNTS)) {
+            file.getDataSet(OBJECT_COUNTS).read(objectCounts);
+            hasObjectIndex = static_cast<int>(objectCounts.size()) == numObjects;
+            for (int i = 0; hasObjectIndex && i < numObjects; ++i)
+                if (objectCounts[i] > 0) lastObjectId = i;
+        }
+        if (!hasObjectIndex && file.exist(INDEX_GROUP)) file.unlink(INDEX_GROUP);
+
+        impl = std::make_unique<Impl>(Impl{
+            .file             = std::move(file),
+            .filepath         = filepath,
+            .attr             = attr,
+            .numEvents        = numEvents,
+            .numObjects       = numObjects,
+            .hasObjectIndex   = hasObjectIndex,
+            .sortedByObjectId = sortedByObjectId,
+            .lastObjectId     = lastObjectId,
+            .objectCounts     = std::move(objectCounts),
+        });
+    } catch (const std::exception& e) { RAYX_EXIT << "exception caught while attempting to write h5 file: " << e.what(); }
+
+    return H5RaysWriter(std::move(impl));
+}
+
+void H5RaysWriter::write(const Rays& rays) {
+    RAYX_PROFILE_FUNCTION_STDOUT();
+
+    if (rays.empty()) return;
+
+    if (!contains(rays.attrMask(), m_impl->attr))
+        RAYX_EXIT << "Cannot write rays to output file '" << m_impl->filepath
+                  << "' because the rays do not contain all attributes specified in the attribute mask: " << to_string(m_impl->attr)
+                  << ". The rays contain the following attributes: " << to_string(rays.attrMask());
+
     try {
-        auto file = HighFive::File(filepath.string(), HighFive::File::ReadWrite);
-
-#define X(type, name, flag)                                                               \
-    RAYX_VERB << "append ray attribute: " #name " (" << rays.name.size() << " elements)"; \
-    if (contains(attr, RayAttrMask::flag)) {                                              \
-        auto dataset        = file.getDataSet("rayx/events/" #name);                      \
-        const auto old_size = dataset.getSpace().getDimensions()[0];                      \
-        dataset.resize({old_size + rays.name.size()});                                    \
-        dataset.select({old_size}, {rays.name.size()}).write(rays.name);                  \
+        auto& file  = m_impl->file;
+        auto events = file.getGroup(EVENTS_GROUP);
+
+#define X(type, name, flag)                                                              \
+    RAYX_VERB << "write ray attribute: " #name " (" << rays.name.size() << " elements)"; \
+    if (contains(m_impl->attr, RayAttrMask::flag)) {                                     \
+        auto dataset        = events.getDataSet(#name);                                  \
+        const auto old_size = dataset.getSpace().getDimensions()[0];                     \
+        dataset.resize({old_size + rays.name.size()});                                   \
+        dataset.select({old_size}, {rays.name.size()}).write(rays.name);                 \
     }
 
         RAYX_X_MACRO_RAY_ATTR
 #undef X
+
+        m_impl->numEvents += rays.size();
+        events.getAttribute("num_events").write(m_impl->numEvents);
+        file.getDataSet(NUM_EVENTS).write(m_impl->numEvents);
+        m_impl->updateObjectIndex(rays.object_id);
     } catch (const std::exception& e) { RAYX_EXIT << "exception caught while attempting to write h5 file: " << e.what(); }
 }
 
+struct H5RaysReader::Impl {
+    HighFive::File file;
+    std::filesystem::path filepath;
+    int64_t numEvents;
+    RayAttrMask attrMask;
+
+    Rays readRange(const int64_t begin, const int64_t end, const RayAttrMask attr) const {
+        Rays rays;
+
+        try {
+            const auto events = file.getGroup(EVENTS_GROUP);
+
+#define X(type, name, flag)                                                                 \
+    if (contains(attr & attrMask, RayAttrMask::flag)) {                                     \
+        readHyperSlab(events.getDataSet(#name), begin, end, rays.name);                     \
+        RAYX_VERB << "read ray attribute: " #name " (" << rays.name.size() << " elements)"; \
+    }
+
+            RAYX_X_MACRO_RAY_ATTR
+#undef X
+        } catch (const std::exception& e) { RAYX_EXIT << "exception caught while attempting to read h5 file: " << e.what(); }
+
+        return rays;
+    }
+};
+
+H5RaysReader::H5RaysReader(H5RaysReader&&) noexcept            = default;
+H5RaysReader& H5RaysReader::operator=(H5RaysReader&&) noexcept = default;
+H5RaysReader::~H5RaysReader()                                  = default;
+
+H5RaysReader::H5RaysReader(const std::filesystem::path& filepath) {
+    RAYX_VERB << "open h5 file " << filepath;
+
+    try {
+        auto file         = HighFive::File(filepath.string(), HighFive::File::ReadOnly);
+        const auto events = file.getGroup(EVENTS_GROUP);
+
+        auto attrMask  = RayAttrMask::None;
+        auto numEvents = std::optional<int64_t>();
+#define X(type, name, flag)                                                                                       \
+    if (events.exist(#name)) {                                                                                    \
+        attrMask |= RayAttrMask::flag;                                                                            \
+        if (!numEvents) numEvents = static_cast<int64_t>(events.getDataSet(#name).getSpace().getDimensions()[0]); \
+    }
+
+        RAYX_X_MACRO_RAY_ATTR
+#undef X
+
+        m_impl = std::make_unique<Impl>(Impl{
+            .file      = std::move(file),
+            .filepath  = filepath,
+            .numEvents = numEvents.value_or(0),
+            .attrMask  = attrMask,
+        });
+    } catch (const std::exception& e) { RAYX_EXIT << "exception caught while attempting to read h5 file: " << e.what(); }
+}
+
+int64_t H5RaysReader::numEvents() const { return m_impl->numEvents; }
+
+RayAttrMask H5RaysReader::attrMask() const { return m_impl->attrMask; }
+
+std::vector<std::string> H5RaysReader::objectNames() const {
+    auto object_names = std::vector<std::string>();
+
+    try {
+        m_impl->file.getDataSet(OBJECT_NAMES).read(object_names);
+    } catch (const std::exception& e) { RAYX_EXIT << "exception caught while attempting to read h5 file: " << e.what(); }
+
+    return object_names;
+}
+
+bool H5RaysReader::hasObjectIndex() const { return m_impl->file.exist(OBJECT_OFFSETS); }
+
+std::optional<std::vector<int64_t>> H5RaysReader::objectCounts() const {
+    if (!m_impl->file.exist(OBJECT_COUNTS)) return std::nullopt;
+
+    auto counts = std::vector<int64_t>();
+    try {
+        m_impl->file.getDataSet(OBJECT_COUNTS).read(counts);
+    } catch (const std::exception& e) { RAYX_EXIT << "exception caught while attempting to read h5 file: " << e.what(); }
+
+    return counts;
+}
+
+Rays H5RaysReader::read(const RayAttrMask attr) const { return read(0, m_impl->numEvents, attr); }
+
+Rays H5RaysReader::read(const int64_t begin, const int64_t end, const RayAttrMask attr) const {
+    RAYX_PROFILE_FUNCTION_STDOUT();
+
+    if (begin < 0 || end < begin || m_impl->numEvents < end)
+        RAYX_EXIT << "Cannot read events [" << begin << ", " << end << ") from '" << m_impl->filepath << "', which contains " << m_impl->numEvents
+                  << " events";
+
+    return m_impl->readRange(begin, end, attr);
+}
+
+Rays H5RaysReader::readObject(const int objectId, const RayAttrMask attr) const {
+    RAYX_PROFILE_FUNCTION_STDOUT();
+
+    // the object has no events
+    const auto counts = objectCounts();
+    if (counts && (objectId < 0 || static_cast<int>(counts->size()) <= objectId || (*counts)[objectId] == 0)) return Rays();
+
+    try {
+        if (hasObjectIndex()) {
+            auto offsets = std::vector<int64_t>();
+            m_impl->file.getDataSet(OBJECT_OFFSETS).read(offsets);
+            if (objectId < 0 || static_cast<int>(offsets.size()) <= objectId + 1) return Rays();
+
+            RAYX_VERB << "read events [" << offsets[objectId] << ", " << offsets[objectId + 1] << ") of object " << objectId;
+            return m_impl->readRange(offsets[objectId], offsets[objectId + 1], attr);
+        }
+
+        if (!contains(m_impl->attrMask, RayAttrMask::ObjectId))
+            RAYX_EXIT << "Cannot read events of object " << objectId << " from '" << m_impl->filepath << "', because object_id is not stored";
+
+        // without index, object_id is scanned in chunks of bounded size. only chunks that contain events of the object are read, and their
+        // events are filtered in memory
+        const auto objectIdDataset = m_impl->file.getGroup(EVENTS_GROUP).getDataSet("object_id");
+        auto object_id             = std::vector<int32_t>();
+        auto chunks                = std::vector<Rays>();
+        for (int64_t begin = 0; begin < m_impl->numEvents; begin += OBJECT_SCAN_CHUNK_SIZE) {
+            const auto end = std::min(begin + OBJECT_SCAN_CHUNK_SIZE, m_impl->numEvents);
+            readHyperSlab(objectIdDataset, begin, end, object_id);
+            if (std::find(object_id.begin(), object_id.end(), objectId) == object_id.end()) continue;
+
+            const auto chunk = m_impl->readRange(begin, end, attr);
+            chunks.push_back(chunk.filter([&](const int64_t i) { return object_id[i] == objectId; }));
+        }
+
+        RAYX_VERB << "read events of object " << objectId << " from " << chunks.size() << " chunk(s) of " << OBJECT_SCAN_CHUNK_SIZE << " events";
+        return Rays::concat(chunks);
+    } catch (const std::exception& e) { RAYX_EXIT << "exception caught while attempting to read h5 file: " << e.what(); }
+
+    return Rays();
+}
+
 }  // namespace rayx
 
 #endif
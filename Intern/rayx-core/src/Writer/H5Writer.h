@@ -1,6 +1,10 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
 #include "Rays.h"
 
@@ -13,6 +17,70 @@ RAYX_API std::vector<std::string> readH5ObjectNames(const std::filesystem::path&
 RAYX_API void writeH5(const std::filesystem::path& filepath, const std::vector<std::string>& object_names, const Rays& rays,
                       const RayAttrMask attr = RayAttrMask::All, const bool overwrite = true);
 RAYX_API void appendH5(const std::filesystem::path& filepath, const Rays& rays, const RayAttrMask attr = RayAttrMask::All);
+
+/// layout and compression of the event datasets of h5 files
+struct RAYX_API H5WriterConfig {
+    size_t chunkSize = 1 << 16;  ///< number of events per chunk. datasets are chunked, so that they can be extended and compressed
+    bool shuffle     = true;     ///< shuffle the bytes of the events of a chunk before compression. improves compression of numbers
+    int deflateLevel = 4;        ///< level of the deflate (zlib) compression from 0 to 9. 0 disables compression
+};
+
+/// writes rays to a h5 file batch by batch. the event datasets are chunked, extendible and optionally compressed. every call to `write` appends
+/// the events of one batch. the recorded attributes and the number of events are stored as attributes `attr_names` and `num_events` of the group
+/// `rayx/events`. the number of events is also kept in the dataset `rayx/num_events`, as before. all batches must contain the attributes
+/// specified by `attr`.
+/// if object_id is recorded, the group `rayx/index` indexes the events by object. the dataset `object_counts` stores the number of events of each
+/// object. as long as the events written so far are sorted by object_id, the dataset `object_offsets` stores where the events of each object
+/// are: the events of object i are [offsets[i], offsets[i + 1]). see H5RaysReader::readObject
+class RAYX_API H5RaysWriter {
+  public:
+    /// creates the file with empty event datasets. if `overwrite` is false, the file must not exist
+    H5RaysWriter(const std::filesystem::path& filepath, const std::vector<std::string>& object_names, const RayAttrMask attr,
+                 const H5WriterConfig& config = H5WriterConfig(), const bool overwrite = true);
+    H5RaysWriter(H5RaysWriter&&) noexcept;
+    H5RaysWriter& operator=(H5RaysWriter&&) noexcept;
+    ~H5RaysWriter();
+
+    /// opens an existing file written by H5RaysWriter or writeH5, to append events to it. chunking and compression of the file are kept
+    static H5RaysWriter append(const std::filesystem::path& filepath, const RayAttrMask attr);
+
+    void write(const Rays& rays);
+
+  private:
+    struct Impl;
+    explicit H5RaysWriter(std::unique_ptr<Impl> impl);
+
+    std::unique_ptr<Impl> m_impl;
+};
+
+/// reads parts of a h5 file written by H5RaysWriter or writeH5. the file is opened once, and only the requested attributes and events are read
+/// from disk. attributes in `attr` that are not stored in the file are skipped
+class RAYX_API H5RaysReader {
+  public:
+    explicit H5RaysReader(const std::filesystem::path& filepath);
+    H5RaysReader(H5RaysReader&&) noexcept;
+    H5RaysReader& operator=(H5RaysReader&&) noexcept;
+    ~H5RaysReader();
+
+    int64_t numEvents() const;
+    /// attributes stored in the file
+    RayAttrMask attrMask() const;
+    std::vector<std::string> objectNames() const;
+    /// whether the file stores the offsets of the events of each object, that are written for files sorted by object_id
+    bool hasObjectIndex() const;
+    /// number of events of each object, or nothing if the file has no object index
+    std::optional<std::vector<int64_t>> objectCounts() const;
+
+    Rays read(const RayAttrMask attr = RayAttrMask::All) const;
+    /// reads the events [begin, end)
+    Rays read(const int64_t begin, const int64_t end, const RayAttrMask attr = RayAttrMask::All) const;
+    /// reads the events of an object. without object index, object_id is scanned in chunks of bounded size and matching events are filtered in memory
+    Rays readObject(const int objectId, const RayAttrMask attr = RayAttrMask::All) const;
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
 #endif
 
 }  // namespace rayx
@@ -0,0 +1,100 @@
+#include "RaysWriteQueue.h"
+
+#include <utility>
+
+#include "Debug/Debug.h"
+
+namespace rayx {
+
+RaysWriteQueue::RaysWriteQueue(const size_t maxQueuedBytes) : m_maxQueuedBytes(maxQueuedBytes), m_thread([this] { run(); }) {}
+
+RaysWriteQueue::~RaysWriteQueue() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+    m_cvJobs.notify_one();
+    m_thread.join();
+
+    if (m_error) RAYX_WARN << "error while writing rays was not handled, because the write queue was destroyed";
+}
+
+void RaysWriteQueue::push(Rays&& rays, WriteFn write) {
+    const auto bytes = rays.bytes();
+
+    std::unique_lock lock(m_mutex);
+    rethrowError();
+
+    // back-pressure: wait until the rays fit into the limit. rays larger than the limit are accepted once the queue is empty
+    wait(lock, [&] { return m_error || (m_jobs.empty() && !m_busy) || m_queuedBytes + bytes <= m_maxQueuedBytes; });
+    rethrowError();
+
+    m_jobs.push_back(Job{
+        .rays  = std::move(rays),
+        .write = std::move(write),
+        .bytes = bytes,
+    });
+    m_queuedBytes += bytes;
+    lock.unlock();
+    m_cvJobs.notify_one();
+}
+
+void RaysWriteQueue::flush() {
+    std::unique_lock lock(m_mutex);
+    wait(lock, [&] { return m_error || (m_jobs.empty() && !m_busy); });
+    rethrowError();
+}
+
+RaysWriteQueue::Clock::duration RaysWriteQueue::producerWaitTime() const {
+    std::lock_guard lock(m_mutex);
+    return m_waitTime + (m_waitBegin ? Clock::now() - *m_waitBegin : Clock::duration::zero());
+}
+
+void RaysWriteQueue::run() {
+    std::unique_lock lock(m_mutex);
+
+    while (true) {
+        m_cvJobs.wait(lock, [&] { return m_stop || !m_jobs.empty(); });
+        if (m_jobs.empty()) return;  // stopped and all jobs are written
+
+        auto job         = std::move(m_jobs.front());
+        const auto bytes = job.bytes;
+        m_jobs.pop_front();
+        m_busy = true;
+        lock.unlock();
+
+        auto error = std::exception_ptr();
+        try {
+            job.write(std::move(job.rays));
+        } catch (...) { error = std::current_exception(); }
+
+        // release the rays before the producer is allowed to push more
+        job = Job{};
+
+        lock.lock();
+        m_busy = false;
+        m_queuedBytes -= bytes;
+        if (error && !m_error) m_error = error;
+        // drop the remaining jobs after an error. they would write to files in an undefined state
+        if (m_error) {
+            m_jobs.clear();
+            m_queuedBytes = 0;
+        }
+        m_cvDone.notify_all();
+    }
+}
+
+void RaysWriteQueue::wait(std::unique_lock<std::mutex>& lock, const std::function<bool()>& pred) {
+    if (pred()) return;
+
+    m_waitBegin = Clock::now();
+    m_cvDone.wait(lock, pred);
+    m_waitTime += Clock::now() - *m_waitBegin;
+    m_waitBegin.reset();
+}
+
+void RaysWriteQueue::rethrowError() {
+    if (m_error) std::rethrow_exception(std::exchange(m_error, nullptr));
+}
+
+}  // namespace rayx
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "Core.h"
+#include "Rays.h"
+
+namespace rayx {
+
+/// default limit of the memory of rays in a RaysWriteQueue, that are pushed but not yet written
+constexpr size_t DEFAULT_WRITE_QUEUE_MEMORY = size_t{1} << 30;
+
+/**
+ * @brief Writes rays to files on a background thread, so that tracing continues while previous results are written.
+ * Rays are pushed together with the function that writes them. The functions are called on the writer thread in the order they were pushed.
+ * If the rays in the queue exceed `maxQueuedBytes`, push blocks until enough rays are written (back-pressure). A single push of rays larger
+ * than the limit is accepted once the queue is empty.
+ * Exceptions thrown by a write function are rethrown by the next call to push or flush. Pending writes are flushed by the destructor.
+ */
+class RAYX_API RaysWriteQueue {
+  public:
+    using Clock   = std::chrono::steady_clock;
+    using WriteFn = std::function<void(Rays&& rays)>;
+
+    explicit RaysWriteQueue(const size_t maxQueuedBytes = DEFAULT_WRITE_QUEUE_MEMORY);
+    ~RaysWriteQueue();
+
+    RaysWriteQueue(const RaysWriteQueue&)            = delete;
+    RaysWriteQueue& operator=(const RaysWriteQueue&) = delete;
+
+    /// enqueues `write(std::move(rays))`. `rays` may be empty, e.g. to close a file after its last batch
+    void push(Rays&& rays, WriteFn write);
+
+    /// blocks until all pushed rays are written
+    void flush();
+
+    /// total time the producer was blocked by push or flush, including a wait that is still in progress. the time a write function spends
+    /// writing minus the increase of this value during the write is the time the write overlapped with the producer (e.g. tracing)
+    Clock::duration producerWaitTime() const;
+
+  private:
+    struct Job {
+        Rays rays;
+        WriteFn write;
+        size_t bytes;
+    };
+
+    void run();
+    void wait(std::unique_lock<std::mutex>& lock, const std::function<bool()>& pred);
+    void rethrowError();
+
+    const size_t m_maxQueuedBytes;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cvJobs;  // notifies the writer thread of pushed jobs and shutdown
+    std::condition_variable m_cvDone;  // notifies the producer of written jobs
+    std::deque<Job> m_jobs;
+    size_t m_queuedBytes = 0;
+    bool m_busy          = false;  // the writer thread is running a job, that is no longer in m_jobs
+    bool m_stop          = false;
+    std::exception_ptr m_error;
+
+    Clock::duration m_waitTime = Clock::duration::zero();
+    std::optional<Clock::time_point> m_waitBegin;
+
+    std::thread m_thread;  // started last, after all members are initialized
+};
+
+}  // namespace rayx
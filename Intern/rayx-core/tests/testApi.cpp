@@ -1,3 +1,5 @@
+#include <chrono>
+
 #include "setupTests.h"
 
 namespace {
@@ -142,6 +144,30 @@ TEST_F(TestSuite, testObjectRecordMask) {
     }
 }
 
+TEST_F(TestSuite, testRaysObjectIndex) {
+    const auto rays       = traceRml(beamlineFilename);
+    const auto raysSorted = rays.sortByObjectId();
+    CHECK_EQ(raysSorted.size(), rays.size());
+    CHECK(std::ranges::is_sorted(raysSorted.object_id));
+
+    // the sorted rays keep their index, which matches the index computed from the sorted object ids
+    const auto offsets = raysSorted.objectOffsets();
+    CHECK_EQ(offsets.back(), raysSorted.size());
+    auto batches = std::vector<Rays>();
+    batches.push_back(raysSorted.copy());
+    const auto raysSortedWithoutIndex = Rays::concat(batches);
+    CHECK_EQ(raysSortedWithoutIndex.objectOffsets(), offsets);
+
+    for (int objectId = 0; objectId + 1 < static_cast<int>(offsets.size()); ++objectId) {
+        // the counting sort is stable, so the rays of each object keep their order
+        const auto raysObject = rays.filterByObjectId(objectId);
+        CHECK_EQ(raysSorted.filterByObjectId(objectId), raysObject);
+        CHECK_EQ(raysSorted.copy().filterByObjectId(objectId), raysObject);
+        CHECK_EQ(raysSortedWithoutIndex.filterByObjectId(objectId), raysObject);
+    }
+    EXPECT_TRUE(raysSorted.filterByObjectId(static_cast<int>(offsets.size())).empty());
+}
+
 #ifndef NO_H5
 TEST_F(TestSuite, testH5) {
     const auto [beamline, raysOriginal] = loadBeamlineAndTrace(beamlineFilename);
@@ -165,6 +191,65 @@ TEST_F(TestSuite, testH5) {
         const auto partialRaysOriginal = std::move(raysOriginal.copy().filterByAttrMask(attrMask));
         CHECK_EQ(rays, partialRaysOriginal);
     }
+
+    // write and append
+    {
+        const auto half       = raysOriginal.size() / 2;
+        const auto raysFirst  = raysOriginal.filter([&](const int i) { return i < half; });
+        const auto raysSecond = raysOriginal.filter([&](const int i) { return half <= i; });
+        writeH5(h5Filepath, objectNamesOriginal, raysFirst);
+        appendH5(h5Filepath, raysSecond);
+        const auto rays = readH5Rays(h5Filepath);
+        CHECK_EQ(rays, raysOriginal);
+    }
+
+    // write batches with chunks smaller than a batch and compression
+    {
+        const auto third  = raysOriginal.size() / 3;
+        const auto config = H5WriterConfig{.chunkSize = 64, .shuffle = true, .deflateLevel = 9};
+        {
+            auto writer = H5RaysWriter(h5Filepath, objectNamesOriginal, RayAttrMask::All, config);
+            writer.write(raysOriginal.filter([&](const int64_t i) { return i < third; }));
+            writer.write(Rays());
+            writer.write(raysOriginal.filter([&](const int64_t i) { return third <= i && i < 2 * third; }));
+        }
+        {
+            auto writer = H5RaysWriter::append(h5Filepath, RayAttrMask::All);
+            writer.write(raysOriginal.filter([&](const int64_t i) { return 2 * third <= i; }));
+        }
+        const auto rays = readH5Rays(h5Filepath);
+        CHECK_EQ(rays, raysOriginal);
+        const auto objectNames = readH5ObjectNames(h5Filepath);
+        EXPECT_EQ(objectNames, objectNamesOriginal);
+    }
+
+    // selective read by attribute, event range and object, with and without object index
+    {
+        const auto raysSorted = raysOriginal.sortByObjectId();
+        for (const auto* raysWritten : {&raysOriginal, &raysSorted}) {
+            writeH5(h5Filepath, objectNamesOriginal, *raysWritten);
+            const auto reader = H5RaysReader(h5Filepath);
+            CHECK_EQ(reader.numEvents(), raysWritten->size());
+            CHECK(reader.attrMask() == RayAttrMask::All);
+            EXPECT_EQ(reader.objectNames(), objectNamesOriginal);
+            if (raysWritten == &raysSorted) CHECK(reader.hasObjectIndex());
+
+            const auto attrMask = RayAttrMask::Position | RayAttrMask::ObjectId;  // just an example
+            const auto begin    = raysWritten->size() / 3;
+            const auto end      = 2 * begin;
+            const auto rays     = reader.read(begin, end, attrMask);
+            auto raysExpected   = raysWritten->filter([&](const int64_t i) { return begin <= i && i < end; });
+            CHECK_EQ(rays, raysExpected.filterByAttrMask(attrMask));
+
+            const auto objectCounts = reader.objectCounts();
+            CHECK(objectCounts.has_value());
+            for (int objectId = 0; objectId < static_cast<int>(objectNamesOriginal.size()); ++objectId) {
+                const auto raysObject = raysWritten->filterByObjectId(objectId);
+                CHECK_EQ(reader.readObject(objectId), raysObject);
+                CHECK_EQ((*objectCounts)[objectId], raysObject.size());
+            }
+        }
+    }
 }
 #endif
 
@@ -187,6 +272,238 @@ TEST_F(TestSuite, testCsv) {
         const auto rays = readCsv(csvFilepath);
         CHECK_EQ(rays, partialRaysOriginal);
     }
+
+    // write in batches of many rows, formatted and parsed in parallel chunks
+    {
+        auto batches = std::vector<Rays>();
+        for (int i = 0; i < 8; ++i) batches.push_back(raysOriginal.copy());
+        const auto raysMany = Rays::concat(batches);
+        {
+            auto writer = CsvRaysWriter(csvFilepath, raysMany.attrMask());
+            for (const auto& batch : batches) writer.write(batch);
+        }
+        const auto rays = readCsv(csvFilepath);
+        CHECK_EQ(rays, raysMany);
+    }
+}
+
+TEST_F(TestSuite, testRaysWriteQueue) {
+    const auto raysOriginal = traceRml(beamlineFilename);
+    const auto half         = raysOriginal.size() / 2;
+
+    // a limit smaller than a batch lets the writer hold a single batch at a time
+    auto written = std::vector<Rays>();
+    {
+        auto queue = RaysWriteQueue(1);
+        queue.push(raysOriginal.filter([&](const int64_t i) { return i < half; }), [&](Rays&& rays) { written.push_back(std::move(rays)); });
+        queue.push(Rays(), [&](Rays&& rays) { CHECK(rays.empty()); });
+        queue.push(raysOriginal.filter([&](const int64_t i) { return half <= i; }), [&](Rays&& rays) { written.push_back(std::move(rays)); });
+        queue.flush();
+        CHECK_EQ(static_cast<int>(written.size()), 2);
+    }
+    CHECK_EQ(Rays::concat(written), raysOriginal);
+
+    // errors of the writer thread are rethrown to the producer
+    {
+        auto queue = RaysWriteQueue();
+        queue.push(Rays(), [](Rays&&) { throw std::runtime_error("write failed"); });
+        EXPECT_THROW(queue.flush(), std::runtime_error);
+        queue.flush();
+    }
+}
+
+TEST_F(TestSuite, traceStreaming) {
+    const auto beamline = loadBeamline(beamlineFilename);
+    auto numRays        = 0;
+    for (const auto* source : beamline.getSources()) numRays += static_cast<int>(source->getNumberOfRays());
+    const auto maxBatchSize = std::max(1, numRays / 3);
+
+    auto numBatches = 0;
+    auto numEvents  = 0;
+    tracer->traceStreaming(
+        beamline,
+        [&](Rays&& batch) {
+            EXPECT_TRUE(batch.isValid());
+            numEvents += batch.size();
+            ++numBatches;
+        },
+        Sequential::No, ObjectMask::all(), RayAttrMask::All, std::nullopt, maxBatchSize);
+
+    EXPECT_EQ(numBatches, (numRays + maxBatchSize - 1) / maxBatchSize);
+    EXPECT_LT(0, numEvents);
+}
+
+TEST_F(TestSuite, traceWithMemoryBudget) {
+    // a small budget forces small batches. rays do not depend on the batch size
+    const auto beamline = loadBeamline(beamlineFilename);
+    auto budgetTracer   = Tracer(DeviceConfig(DeviceConfig::DeviceType::Cpu).enableBestDevice(), TracerConfig{.memoryBudget = 4 << 20});
+    auto defaultTracer  = Tracer(DeviceConfig(DeviceConfig::DeviceType::Cpu).enableBestDevice());
+
+    auto batches = std::vector<Rays>();
+    budgetTracer.traceStreaming(beamline, [&](Rays&& batch) { batches.push_back(std::move(batch)); });
+    fixSeed(FIXED_SEED);
+    const auto raysDefault = defaultTracer.trace(beamline);
+
+    EXPECT_LT(1, static_cast<int>(batches.size()));
+    CHECK_EQ(Rays::concat(batches), raysDefault);
+
+    // histograms are traced with the batch size of the budget as well
+    const auto objectId  = static_cast<int>(beamline.numSources() + beamline.numElements()) - 1;
+    const auto histogram = HistogramConfig{
+        .objectId = objectId,
+        .x        = {.attr = HistogramAttr::Energy, .numBins = 32, .min = 0.0, .max = 1e4},
+    };
+    fixSeed(FIXED_SEED);
+    const auto histogramsBudget = budgetTracer.traceHistograms(beamline, {histogram});
+    fixSeed(FIXED_SEED);
+    const auto histogramsDefault = defaultTracer.traceHistograms(beamline, {histogram});
+    CHECK_EQ(histogramsBudget[0].bins, histogramsDefault[0].bins);
+}
+
+TEST_F(TestSuite, traceAppendEvents) {
+    // a small initial buffer forces the tracer to grow the buffer and trace batches again
+    const auto beamline   = loadBeamline(beamlineFilename);
+    auto appendTracer     = Tracer(DeviceConfig(DeviceConfig::DeviceType::Cpu).enableBestDevice(),
+                                   TracerConfig{.appendEvents = AppendEventsConfig{.initialEventsPerRay = 0.1}});
+    auto denseTracer      = Tracer(DeviceConfig(DeviceConfig::DeviceType::Cpu).enableBestDevice());
+    const auto raysAppend = appendTracer.trace(beamline, Sequential::No, ObjectMask::all(), RayAttrMask::All);
+    fixSeed(FIXED_SEED);
+    const auto raysDense = denseTracer.trace(beamline, Sequential::No, ObjectMask::all(), RayAttrMask::All);
+
+    // the order of appended events is unspecified
+    EXPECT_LT(0, raysAppend.size());
+    CHECK_EQ(raysAppend.sortByPathIdAndPathEventId(), raysDense.sortByPathIdAndPathEventId());
+}
+
+TEST_F(TestSuite, traceSequentialRayPackets) {
+    // the lanes of a packet evaluate the same expressions as TraceSequentialKernel, so the results must be bitwise identical
+    const auto beamline   = loadBeamline(beamlineFilename);
+    auto packetTracer     = Tracer(DeviceConfig(DeviceConfig::DeviceType::Cpu).enableBestDevice(), TracerConfig{.rayPackets = true});
+    auto scalarTracer     = Tracer(DeviceConfig(DeviceConfig::DeviceType::Cpu).enableBestDevice());
+    const auto raysPacket = packetTracer.trace(beamline, Sequential::Yes, ObjectMask::all(), RayAttrMask::All);
+    fixSeed(FIXED_SEED);
+    const auto raysScalar = scalarTracer.trace(beamline, Sequential::Yes, ObjectMask::all(), RayAttrMask::All);
+
+    EXPECT_LT(0, raysPacket.size());
+    CHECK_EQ(raysPacket, raysScalar);
+}
+
+// run with --gtest_also_run_disabled_tests --gtest_filter=*benchmarkSequentialRayPackets
+TEST_F(TestSuite, DISABLED_benchmarkSequentialRayPackets) {
+    const auto beamline = loadBeamline(beamlineFilename);
+
+    for (const auto rayPackets : {false, true}) {
+        auto rayTracer = Tracer(DeviceConfig(DeviceConfig::DeviceType::Cpu).enableBestDevice(), TracerConfig{.rayPackets = rayPackets});
+        fixSeed(FIXED_SEED);
+        const auto start = std::chrono::steady_clock::now();
+        const auto rays  = rayTracer.trace(beamline, Sequential::Yes, ObjectMask::all(), RayAttrMask::All);
+        const auto end   = std::chrono::steady_clock::now();
+
+        const auto milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+        RAYX_LOG << "sequential tracing " << (rayPackets ? "in ray packets" : "ray by ray") << ": " << milliseconds << " ms, " << rays.size()
+                 << " events";
+    }
+}
+
+TEST_F(TestSuite, traceWithEventFilters) {
+    // filtering on the device must record exactly the events that filtering on the host keeps, including their path_event_id
+    const auto beamline = loadBeamline(beamlineFilename);
+    const auto objectId = static_cast<int>(beamline.numSources() + beamline.numElements()) - 1;
+    const auto rays     = tracer->trace(beamline);
+
+    const auto quartiles = [](std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+        return std::pair(values[values.size() / 4], values[values.size() * 3 / 4]);
+    };
+    const auto [minEnergy, maxEnergy] = quartiles(rays.energy);
+    const auto [minX, maxX]           = quartiles(rays.filterByObjectId(objectId).position_x);
+
+    const auto energyFilter = EventFilter{
+        .eventTypes = EventTypeMask::HitElement | EventTypeMask::Absorbed,
+        .minEnergy  = minEnergy,
+        .maxEnergy  = maxEnergy,
+    };
+    const auto positionFilter = EventFilter{
+        .objectId    = objectId,
+        .minPosition = glm::dvec3(minX, -EventFilter::INF, -EventFilter::INF),
+        .maxPosition = glm::dvec3(maxX, EventFilter::INF, EventFilter::INF),
+    };
+
+    const auto expected = rays.filter([&](const int64_t i) {
+        const auto eventType = rays.event_type[i];
+        const auto energy    = rays.energy[i];
+        const auto x         = rays.position_x[i];
+        return (eventType == EventType::HitElement || eventType == EventType::Absorbed) && minEnergy <= energy && energy <= maxEnergy &&
+               (rays.object_id[i] != objectId || (minX <= x && x <= maxX));
+    });
+
+    fixSeed(FIXED_SEED);
+    const auto filtered =
+        tracer->trace(beamline, Sequential::No, ObjectMask::all(), RayAttrMask::All, std::nullopt, std::nullopt, {energyFilter, positionFilter});
+
+    EXPECT_LT(0, filtered.size());
+    EXPECT_LT(filtered.size(), rays.size());
+    CHECK_EQ(filtered, expected);
+}
+
+TEST_F(TestSuite, traceHistograms) {
+    // histograms accumulated on the device must match histograms of the recorded events
+    const auto beamline = loadBeamline(beamlineFilename);
+    const auto objectId = static_cast<int>(beamline.numSources() + beamline.numElements()) - 1;
+    const auto rays     = tracer->trace(beamline).filterByObjectId(objectId);
+    ASSERT_LT(0, rays.size());
+
+    const auto [minX, maxX] = std::minmax_element(rays.position_x.begin(), rays.position_x.end());
+    const auto [minZ, maxZ] = std::minmax_element(rays.position_z.begin(), rays.position_z.end());
+    const auto [minE, maxE] = std::minmax_element(rays.energy.begin(), rays.energy.end());
+
+    const auto footprint = HistogramConfig{
+        .objectId = objectId,
+        .x        = {.attr = HistogramAttr::PositionX, .numBins = 16, .min = *minX, .max = *maxX + 1e-9},
+        .y        = {.attr = HistogramAttr::PositionZ, .numBins = 8, .min = *minZ, .max = *maxZ + 1e-9},
+    };
+    const auto spectrum = HistogramConfig{
+        .objectId          = objectId,
+        .x                 = {.attr = HistogramAttr::Energy, .numBins = 32, .min = *minE, .max = *maxE + 1e-9},
+        .weightByIntensity = true,
+    };
+
+    fixSeed(FIXED_SEED);
+    const auto histograms = tracer->traceHistograms(beamline, {footprint, spectrum});
+    ASSERT_EQ(static_cast<int>(histograms.size()), 2);
+
+    auto expectedFootprint = std::vector<double>(footprint.numBins());
+    auto expectedSpectrum  = std::vector<double>(spectrum.numBins());
+
+    const auto bin = [](const double value, const HistogramAxis& axis) {
+        return std::min(static_cast<int>((value - axis.min) / (axis.max - axis.min) * axis.numBins), axis.numBins - 1);
+    };
+    for (int64_t i = 0; i < rays.size(); ++i) {
+        expectedFootprint[bin(rays.position_z[i], footprint.y) * footprint.x.numBins + bin(rays.position_x[i], footprint.x)] += 1.0;
+        expectedSpectrum[bin(rays.energy[i], spectrum.x)] += intensity(rays.electric_field(i));
+    }
+
+    CHECK_EQ(histograms[0].bins, expectedFootprint);
+    for (int i = 0; i < spectrum.numBins(); ++i) EXPECT_NEAR(histograms[1].bin(i), expectedSpectrum[i], 1e-9 * rays.size()) << "bin " << i;
+
+    // events rejected by the event filters do not contribute to the histograms
+    const auto midE         = (*minE + *maxE) / 2;
+    const auto energyFilter = EventFilter{
+        .objectId  = objectId,
+        .maxEnergy = midE,
+    };
+
+    fixSeed(FIXED_SEED);
+    const auto filteredHistograms = tracer->traceHistograms(beamline, {footprint}, Sequential::No, ObjectMask::all(), std::nullopt, std::nullopt,
+                                                            {energyFilter});
+    ASSERT_EQ(static_cast<int>(filteredHistograms.size()), 1);
+
+    auto expectedFilteredFootprint = std::vector<double>(footprint.numBins());
+    for (int64_t i = 0; i < rays.size(); ++i)
+        if (rays.energy[i] <= midE)
+            expectedFilteredFootprint[bin(rays.position_z[i], footprint.y) * footprint.x.numBins + bin(rays.position_x[i], footprint.x)] += 1.0;
+
+    CHECK_EQ(filteredHistograms[0].bins, expectedFilteredFootprint);
 }
 
 TEST_F(TestSuite, testBeamlineBijectionBetweenObjectAndObjectId) {
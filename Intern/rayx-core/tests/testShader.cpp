@@ -1,9 +1,20 @@
 #include <gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <format>
 #include <numeric>
+#include <random>
 
+#include "Element/ElementBvh.h"
+#include "Element/ReflectivityTable.h"
+#include "Material/MaterialDatabase.h"
+#include "Material/RefractiveIndexLut.h"
 #include "Shader/ApplySlopeError.h"
 #include "Shader/Approx.h"
+#include "Shader/Collision.h"
 #include "Shader/Crystal.h"
+#include "Shader/Cubic.h"
+#include "Shader/Diffraction.h"
 #include "Shader/LineDensity.h"
 #include "Shader/Rand.h"
 #include "Shader/Refrac.h"
@@ -57,6 +68,20 @@ TEST_F(TestSuite, testNormalRandom) {
     CHECK(count > int(0.95 * z_scores.size()))
 }
 
+TEST_F(TestSuite, testRandBeyondIntRayIndex) {
+    // ray path indices of runs with more than 2^31 rays must not wrap around, or rays would share their random numbers
+    const auto numRaysTotal = int64_t{10'000'000'000};
+    const auto rayPathIndex = int64_t{1} << 32;
+
+    const auto first   = Rand(rayPathIndex, numRaysTotal, 0.42);
+    const auto next    = Rand(rayPathIndex + 1, numRaysTotal, 0.42);
+    const auto wrapped = Rand(int64_t{0}, numRaysTotal, 0.42);  // the index a 32 bit ray path index would wrap around to
+
+    const auto workerCounterNum = ~static_cast<RandCounter>(0) / static_cast<RandCounter>(numRaysTotal);
+    EXPECT_EQ(next.counter - first.counter, workerCounterNum);
+    EXPECT_EQ(first.counter - wrapped.counter, workerCounterNum << 32);
+}
+
 TEST_F(TestSuite, testSin) {
     std::vector<double> args = {
         -0.5620816275750421, -0.082699735953560394, -0.73692442452247864, -0.93085577907030514, 0.038832744045494971, 0.86938579245347758,
@@ -433,6 +458,25 @@ TEST_F(TestSuite, testRayMatrixMult) {
     }
 }
 
+TEST_F(TestSuite, testComposeAffineTransforms) {
+    const auto a = glm::translate(glm::dmat4(1), glm::dvec3(1, 2, 3)) * glm::rotate(glm::dmat4(1), glm::radians(30.0), glm::dvec3(0, 0, 1));
+    const auto b = glm::rotate(glm::dmat4(1), glm::radians(-45.0), glm::dvec3(1, 0, 0)) * glm::translate(glm::dmat4(1), glm::dvec3(-4, 5, 6));
+
+    const auto composed = composeAffineTransforms(toAffineTransform(a), toAffineTransform(b));
+    CHECK_EQ(glm::dmat4(composed), a * b);
+
+    auto pos         = glm::dvec3(1, -2, 3);
+    auto dir         = glm::normalize(glm::dvec3(1, 1, 0));
+    auto expectedPos = pos;
+    auto expectedDir = dir;
+    rayMatrixMult(composed, pos, dir);
+    rayMatrixMult(b, expectedPos, expectedDir);
+    rayMatrixMult(a, expectedPos, expectedDir);
+
+    CHECK_EQ(pos, expectedPos);
+    CHECK_EQ(dir, expectedDir);
+}
+
 TEST_F(TestSuite, testRayMatrixMultWithComplexElectricField) {
     struct InOutPair {
         glm::dvec3 in_position;
@@ -738,6 +782,63 @@ TEST_F(TestSuite, testBessel1) {
     }
 }
 
+TEST_F(TestSuite, testDiffractionTableMatchesRejectionSampling) {
+    const auto& table      = getDiffractionTable();
+    constexpr int numRays  = 50000;
+    constexpr int numBins  = 20;
+    constexpr double wl    = 1.0;   // nm
+    constexpr double width = 0.05;  // mm
+    constexpr double scale = wl / (width * 1e06);
+
+    using Histogram     = std::array<int, numBins>;
+    const auto addToBin = [&](Histogram& histogram, const double angle, const double min, const double max) {
+        const auto bin = static_cast<int>((angle / scale - min) / (max - min) * numBins);
+        ASSERT_GE(bin, 0);
+        ++histogram[std::min(bin, numBins - 1)];
+    };
+    // two histograms of the same distribution, with numRays samples each
+    const auto expectSameDistribution = [](const Histogram& a, const Histogram& b) {
+        for (int bin = 0; bin < numBins; ++bin) EXPECT_LE(std::abs(a[bin] - b[bin]), 5.0 * std::sqrt(a[bin] + b[bin]) + 5.0) << "bin " << bin;
+    };
+
+    // rectangular slit
+    {
+        auto rejection = Histogram{};
+        auto tabulated = Histogram{};
+        for (int i = 0; i < numRays; ++i) {
+            auto rand = Rand(i, numRays, 0.42);
+            auto a    = 0.0;
+            auto b    = 0.0;
+            fraun_diff(width, wl, a, rand);
+            fraun_diff_tabulated(width, wl, b, rand, table.data());
+            addToBin(rejection, a, -5.0, 5.0);
+            addToBin(tabulated, b, -5.0, 5.0);
+        }
+        expectSameDistribution(rejection, tabulated);
+    }
+
+    // circular aperture
+    {
+        auto rejectionPhi = Histogram{};
+        auto rejectionPsi = Histogram{};
+        auto tabulatedPhi = Histogram{};
+        auto tabulatedPsi = Histogram{};
+        for (int i = 0; i < numRays; ++i) {
+            auto rand = Rand(i, numRays, 0.42);
+            auto dPhi = 0.0;
+            auto dPsi = 0.0;
+            bessel_diff(width, wl, dPhi, dPsi, rand);
+            addToBin(rejectionPhi, std::abs(dPhi), 0.0, 5.0);
+            addToBin(rejectionPsi, std::abs(dPsi), 0.0, 5.0);
+            bessel_diff_tabulated(width, wl, dPhi, dPsi, rand, table.data());
+            addToBin(tabulatedPhi, std::abs(dPhi), 0.0, 5.0);
+            addToBin(tabulatedPsi, std::abs(dPsi), 0.0, 5.0);
+        }
+        expectSameDistribution(rejectionPhi, tabulatedPhi);
+        expectSameDistribution(rejectionPsi, tabulatedPsi);
+    }
+}
+
 TEST_F(TestSuite, testVlsGrating) {
     struct InOutPair {
         double in_lineDensity;
@@ -1230,6 +1331,58 @@ TEST_F(TestSuite, testHvlam) {
     CHECK_EQ(getAtomicMassAndRho(static_cast<int>(Material::U)), glm::dvec2(238.0289, 18.92));
 }*/
 
+TEST_F(TestSuite, testMaterialTablesCache) {
+    std::array<bool, 133> relevantMaterials;
+    relevantMaterials.fill(false);
+    relevantMaterials[static_cast<int>(Material::Cu) - 1] = true;
+
+    const auto cached = loadMaterialTablesCached(relevantMaterials);
+    EXPECT_EQ(cached, loadMaterialTablesCached(relevantMaterials));
+
+    const auto uncached = loadMaterialTables(relevantMaterials);
+    EXPECT_EQ(cached->indices, uncached.indices);
+    EXPECT_EQ(cached->materials, uncached.materials);
+
+    relevantMaterials[static_cast<int>(Material::Au) - 1] = true;
+    auto other = loadMaterialTablesCached(relevantMaterials);
+    EXPECT_NE(cached, other);
+
+    // the cache does not keep tables alive that are no longer used
+    const auto weakOther = std::weak_ptr(other);
+    other.reset();
+    EXPECT_TRUE(weakOther.expired());
+}
+
+TEST_F(TestSuite, testMaterialDatabase) {
+    // unique per test and run, so that parallel or repeated test runs do not race on the file
+    const auto testInfo = ::testing::UnitTest::GetInstance()->current_test_info();
+    auto random         = std::random_device();
+    const auto filename = std::format("rayx-{}-{}-{:08x}{:08x}.rayxmat", testInfo->test_suite_name(), testInfo->name(), random(), random());
+    const auto path     = std::filesystem::temp_directory_path() / filename;
+
+    struct RemoveFile {
+        std::filesystem::path path;
+        ~RemoveFile() {
+            auto error = std::error_code();
+            std::filesystem::remove(path, error);
+        }
+    } const removeFile{path};
+
+    ASSERT_TRUE(MaterialDatabase::write(path));
+    const auto database = MaterialDatabase::open(path);
+    ASSERT_NE(database, nullptr);
+
+    std::array<bool, 133> relevantMaterials;
+    relevantMaterials.fill(false);
+    for (const auto material : {Material::Cu, Material::Au, Material::B4C, Material::SiC})
+        relevantMaterials[static_cast<int>(material) - 1] = true;
+
+    const auto sliced = database->slice(relevantMaterials);
+    const auto parsed = loadMaterialTablesFromText(relevantMaterials);
+    EXPECT_EQ(sliced.indices, parsed.indices);
+    EXPECT_EQ(sliced.materials, parsed.materials);
+}
+
 TEST_F(TestSuite, testPalik) {
     auto mat = createMaterialTables({Material::Cu, Material::Au});
 
@@ -1364,6 +1517,261 @@ TEST_F(TestSuite, testRefractiveIndex) {
     CHECK_EQ(getRefractiveIndex(25146.2, 29, mat.indices.data(), mat.materials.data()), glm::dvec2(1.0, 1.0328e-7), 1e-5);
 }
 
+TEST_F(TestSuite, testRefractiveIndexLut) {
+    const auto exact = createMaterialTables({Material::Cu, Material::Au});
+
+    for (const auto spacing : {EnergyGridSpacing::Uniform, EnergyGridSpacing::Logarithmic}) {
+        const auto config = RefractiveIndexLutConfig{.spacing = spacing, .numGridPoints = 4096, .tolerance = 1e-6};
+        auto mat          = exact;
+        appendRefractiveIndexLuts(mat, glm::dvec2(100.0, 2000.0), config);
+
+        for (const auto material : {Material::Cu, Material::Au}) {
+            const auto m = static_cast<int>(material);
+            EXPECT_GE(mat.indices[REFRACTIVE_INDEX_LUT_INDICES_OFFSET + m - 1], 0);
+
+            // inside and outside of the grid. outside, the exact refractive index is used
+            for (auto energy = 10.0; energy < 20000.0; energy *= 1.0123) {
+                const auto ior      = getRefractiveIndex(energy, m, mat.indices.data(), mat.materials.data());
+                const auto iorExact = getRefractiveIndex(energy, m, exact.indices.data(), exact.materials.data());
+                // the error bound is verified at midpoints and table entries of the grid intervals, allow some slack in between
+                CHECK_EQ(ior, iorExact, 2.0 * config.tolerance);
+            }
+        }
+    }
+}
+
+namespace {
+
+// reflection amplitudes of a multilayer stack, formulated with arrays of the refractive indices and refraction angles of all media, where each
+// angle is refracted from the medium above. this is how computeMultilayerReflectance computed them before the coating layer table
+ComplexFresnelCoeffs referenceMultilayerReflectance(const double energy, const double angle, const std::vector<CoatingLayer>& layers,
+                                                    const int substrateMaterial, const MaterialTables& mat) {
+    const auto numLayers = static_cast<int>(layers.size());
+
+    auto iors = std::vector<complex::Complex>(numLayers + 2);
+    iors[0]   = getRefractiveIndex(energy, -1, mat.indices.data(), mat.materials.data());
+    for (int i = 0; i < numLayers; ++i) iors[i + 1] = getRefractiveIndex(energy, layers[i].material, mat.indices.data(), mat.materials.data());
+    iors[numLayers + 1] = getRefractiveIndex(energy, substrateMaterial, mat.indices.data(), mat.materials.data());
+
+    auto thetas = std::vector<complex::Complex>(numLayers + 2);
+    thetas[0]   = complex::Complex(angle, 0.0);
+    for (int i = 1; i <= numLayers + 1; ++i) thetas[i] = calcRefractAngle(thetas[i - 1], iors[i - 1], iors[i]);
+
+    const auto wavelength = energyToWaveLength(energy);
+    auto r                = calcReflectAmplitude(thetas[numLayers], thetas[numLayers + 1], iors[numLayers], iors[numLayers + 1]);
+    for (int j = numLayers - 1; j >= 0; --j) {
+        const auto delta = (2.0 * PI / wavelength) * iors[j + 1] * complex::cos(thetas[j + 1]) * layers[j].thickness;
+        const auto phase = complex::exp(complex::Complex(0.0, 2.0) * delta);
+        const auto r_j   = calcReflectAmplitude(thetas[j], thetas[j + 1], iors[j], iors[j + 1]);
+
+        r.s = (r_j.s + r.s * phase) / (complex::Complex(1.0) + r_j.s * r.s * phase);
+        r.p = (r_j.p + r.p * phase) / (complex::Complex(1.0) + r_j.p * r.p * phase);
+    }
+
+    return r;
+}
+
+// a mirror of a beamline with a silicon substrate, to be coated by the tests
+std::optional<OpticalElement> loadSiliconMirror() {
+    const auto beamline = loadBeamline("METRIX_U41_G1_H1_318eV_PS_MLearn_v114");
+    for (const auto& e : beamline.compileElements()) {
+        if (!e.element.m_behaviour.is<Behaviour::Mirror>()) continue;
+        auto mirror       = e.element;
+        mirror.m_material = static_cast<int>(Material::Si);
+        return mirror;
+    }
+    return std::nullopt;
+}
+
+}  // unnamed namespace
+
+TEST_F(TestSuite, testMultilayerCoatingLayers) {
+    const auto mat       = createMaterialTables({Material::Si, Material::Mo, Material::W, Material::C, Material::Au});
+    const auto layerMoSi = std::vector<CoatingLayer>{
+        {.material = static_cast<int>(Material::Mo), .thickness = 3.0, .roughness = 0.0},
+        {.material = static_cast<int>(Material::Si), .thickness = 4.0, .roughness = 0.0},
+        {.material = static_cast<int>(Material::Mo), .thickness = 3.0, .roughness = 0.0},
+        {.material = static_cast<int>(Material::Si), .thickness = 4.0, .roughness = 0.0},
+    };
+    const auto layerWC = std::vector<CoatingLayer>{
+        {.material = static_cast<int>(Material::C), .thickness = 2.0, .roughness = 0.0},
+        {.material = static_cast<int>(Material::W), .thickness = 1.5, .roughness = 0.0},
+        {.material = static_cast<int>(Material::C), .thickness = 2.5, .roughness = 0.0},
+        {.material = static_cast<int>(Material::W), .thickness = 1.5, .roughness = 0.0},
+        {.material = static_cast<int>(Material::C), .thickness = 2.5, .roughness = 0.0},
+    };
+
+    const auto mirror = loadSiliconMirror();
+    ASSERT_TRUE(mirror);
+
+    // two elements with different multilayer stacks, separated by an element with a single layer coating, which has no layers in the table
+    auto elementsAndTransforms = std::vector<OpticalElementAndTransform>(3, OpticalElementAndTransform{.element = *mirror});
+
+    elementsAndTransforms[0].element.m_coating = Coating::MultilayerCoating{.numLayers = 0, .layerOffset = 0};
+    elementsAndTransforms[0].coatingLayers     = layerMoSi;
+    elementsAndTransforms[1].element.m_coating = Coating::OneCoating{.material = static_cast<int>(Material::Au), .thickness = 20.0, .roughness = 0.0};
+    elementsAndTransforms[2].element.m_coating = Coating::MultilayerCoating{.numLayers = 0, .layerOffset = 0};
+    elementsAndTransforms[2].coatingLayers     = layerWC;
+
+    const auto packed = packCoatingLayers(elementsAndTransforms);
+    ASSERT_EQ(packed.elements.size(), elementsAndTransforms.size());
+    EXPECT_EQ(packed.coatingLayers.size(), layerMoSi.size() + layerWC.size());
+    EXPECT_TRUE(packed.elements[1].m_coating.is<Coating::OneCoating>());
+
+    for (const auto i : {0, 2}) {
+        const auto& element = packed.elements[i];
+        const auto& layers  = elementsAndTransforms[i].coatingLayers;
+        ASSERT_TRUE(element.m_coating.is<Coating::MultilayerCoating>());
+
+        // the element references its own layers in the table
+        const auto& mlCoating = element.m_coating.get<Coating::MultilayerCoating>();
+        ASSERT_EQ(mlCoating.numLayers, static_cast<int>(layers.size()));
+        ASSERT_LE(mlCoating.layerOffset + mlCoating.numLayers, static_cast<int>(packed.coatingLayers.size()));
+        const auto referencedLayers = std::vector<CoatingLayer>(packed.coatingLayers.begin() + mlCoating.layerOffset,
+                                                                packed.coatingLayers.begin() + mlCoating.layerOffset + mlCoating.numLayers);
+        EXPECT_TRUE(referencedLayers == layers) << "element " << i;
+
+        // the parratt recursion over the layer table matches the formulation with arrays of all media
+        for (const auto energy : {100.0, 318.0, 1000.0}) {
+            for (auto angle = 0.05; angle < PI / 2; angle += 0.1) {
+                const auto reflectance = computeCoatingReflectance(energy, angle, element.m_coating, element.m_material, packed.coatingLayers.data(),
+                                                                   mat.indices.data(), mat.materials.data());
+                const auto expected    = referenceMultilayerReflectance(energy, angle, layers, element.m_material, mat);
+                CHECK_EQ(reflectance.s, expected.s, 1e-9);
+                CHECK_EQ(reflectance.p, expected.p, 1e-9);
+            }
+        }
+    }
+}
+
+TEST_F(TestSuite, testReflectivityTable) {
+    const auto mat    = createMaterialTables({Material::Si, Material::Mo, Material::Au});
+    const auto mirror = loadSiliconMirror();
+    ASSERT_TRUE(mirror);
+
+    // 200 Mo/Si bilayers. the bragg peak and the thickness fringes are narrower than the angle step of a default grid
+    auto coatingLayers = std::vector<CoatingLayer>();
+    for (int i = 0; i < 200; ++i) {
+        coatingLayers.push_back({.material = static_cast<int>(Material::Mo), .thickness = 3.0, .roughness = 0.0});
+        coatingLayers.push_back({.material = static_cast<int>(Material::Si), .thickness = 4.0, .roughness = 0.0});
+    }
+
+    auto singleLayerMirror      = *mirror;
+    auto multilayerMirror       = *mirror;
+    singleLayerMirror.m_coating = Coating::OneCoating{.material = static_cast<int>(Material::Au), .thickness = 20.0, .roughness = 0.0};
+    multilayerMirror.m_coating  = Coating::MultilayerCoating{.numLayers = static_cast<int>(coatingLayers.size()), .layerOffset = 0};
+
+    const auto exact = [&](const OpticalElement& element, const double energy, const double angle) {
+        return computeCoatingReflectance(energy, angle, element.m_coating, element.m_material, coatingLayers.data(), mat.indices.data(),
+                                         mat.materials.data());
+    };
+
+    // builds the table of a single element and checks the reflection amplitudes the tracer would use at the given energies and angles: the
+    // interpolated ones where the table is within tolerance, the exact ones otherwise. returns the number of interpolated amplitudes
+    const auto checkTable = [&](const OpticalElement& element, const glm::dvec2 energyRange, const ReflectivityTableConfig& config,
+                                const std::vector<double>& energies, const std::vector<double>& angles) {
+        auto elements     = std::vector<OpticalElement>{element};
+        const auto tables = buildReflectivityTables(elements, coatingLayers, mat, energyRange, config);
+        const auto offset = elements[0].m_coating.is<Coating::OneCoating>()
+                                ? elements[0].m_coating.get<Coating::OneCoating>().reflectivityTableOffset
+                                : elements[0].m_coating.get<Coating::MultilayerCoating>().reflectivityTableOffset;
+        EXPECT_EQ(offset, 0);
+
+        auto numTabulated = 0;
+        for (const auto energy : energies) {
+            for (const auto angle : angles) {
+                const auto tabulated = lookupReflectivityTable(energy, angle, tables.data());
+                const auto expected  = exact(element, energy, angle);
+                const auto used      = tabulated ? *tabulated : expected;
+                numTabulated += tabulated ? 1 : 0;
+
+                // the error bound is verified at a few points per grid cell only, so allow some margin in between
+                CHECK_EQ(used.s, expected.s, 10.0 * config.tolerance);
+                CHECK_EQ(used.p, expected.p, 10.0 * config.tolerance);
+            }
+        }
+
+        // outside of the grid, the reflection amplitudes have to be computed exactly
+        EXPECT_FALSE(lookupReflectivityTable(energyRange.x - 1.0, config.angleMin + 1e-3, tables.data()));
+        EXPECT_FALSE(lookupReflectivityTable(energyRange.y + 1.0, config.angleMin + 1e-3, tables.data()));
+        EXPECT_FALSE(lookupReflectivityTable(energyRange.x, config.angleMax + 0.1, tables.data()));
+
+        return numTabulated;
+    };
+
+    const auto range = [](const double begin, const double end, const int n) {
+        auto values = std::vector<double>(n);
+        for (int i = 0; i < n; ++i) values[i] = begin + (end - begin) * i / (n - 1);
+        return values;
+    };
+
+    // the single layer coating is smooth over all angles, so interpolation is within tolerance almost everywhere
+    const auto singleLayerConfig = ReflectivityTableConfig{.numEnergies = 64, .numAngles = 2048, .angleMin = 0.0, .angleMax = PI / 2};
+    const auto numSingleLayerTabulated =
+        checkTable(singleLayerMirror, glm::dvec2(500.0, 600.0), singleLayerConfig, range(500.0, 600.0, 17), range(0.0, PI / 2 - 0.01, 157));
+    EXPECT_LT(0, numSingleLayerTabulated);
+
+    // first order bragg peak of the multilayer at 1 keV. searched at grazing angles between 60 and 120 mrad, beyond total reflection
+    const auto energy     = 1000.0;
+    auto braggAngle       = 0.0;
+    auto braggReflectance = 0.0;
+    for (const auto angle : range(PI / 2 - 0.12, PI / 2 - 0.06, 1201)) {
+        const auto reflectance = std::abs(exact(multilayerMirror, energy, angle).s);
+        if (reflectance <= braggReflectance) continue;
+
+        braggAngle       = angle;
+        braggReflectance = reflectance;
+    }
+    ASSERT_LT(0.1, braggReflectance);
+
+    // dense sampling around the bragg peak, which also covers several thickness fringes of the stack (about 0.44 mrad apart)
+    const auto energyRange = glm::dvec2(energy, energy);
+    const auto angles      = range(braggAngle - 0.005, braggAngle + 0.005, 1001);
+
+    // with an angle step of about 1.5 mrad, as with the default grid, neither the peak nor the fringes are resolved. interpolation is rejected
+    // there, and the exact amplitudes are used
+    const auto coarseConfig = ReflectivityTableConfig{
+        .numEnergies = 2,
+        .numAngles   = 8,
+        .angleMin    = braggAngle - 0.005,
+        .angleMax    = braggAngle + 0.005,
+    };
+    const auto numCoarseTabulated = checkTable(multilayerMirror, energyRange, coarseConfig, {energy}, angles);
+    EXPECT_LT(numCoarseTabulated, static_cast<int>(angles.size()));
+
+    // a fine grid resolves the peak and the fringes, so more amplitudes are interpolated
+    auto fineConfig      = coarseConfig;
+    fineConfig.numAngles = 4096;
+
+    const auto numFineTabulated = checkTable(multilayerMirror, energyRange, fineConfig, {energy}, angles);
+    EXPECT_LT(numCoarseTabulated, numFineTabulated);
+
+    // tables are reused as long as their key is equal. the elements then reference the reused tables at the same offsets
+    auto elements             = std::vector<OpticalElement>{singleLayerMirror, multilayerMirror};
+    const auto config         = ReflectivityTableConfig{.numEnergies = 2, .numAngles = 2};
+    const auto tables         = buildReflectivityTables(elements, coatingLayers, mat, energyRange, config);
+    const auto materialTables = std::make_shared<const MaterialTables>(mat);
+    const auto key            = calcReflectivityTablesKey(elements, coatingLayers, materialTables, energyRange, config);
+    auto changedLayers        = coatingLayers;
+
+    changedLayers[1].thickness += 1.0;
+    EXPECT_TRUE(key == calcReflectivityTablesKey(elements, coatingLayers, materialTables, energyRange, config));
+    EXPECT_FALSE(key == calcReflectivityTablesKey(elements, changedLayers, materialTables, energyRange, config));
+    EXPECT_FALSE(key == calcReflectivityTablesKey(elements, coatingLayers, materialTables, energyRange + 1.0, config));
+    EXPECT_FALSE(key == calcReflectivityTablesKey(elements, coatingLayers, materialTables, energyRange, {.numEnergies = 32}));
+    EXPECT_FALSE(key == calcReflectivityTablesKey(elements, coatingLayers, materialTables, energyRange, {.tolerance = 1e-6}));
+
+    auto reusedElements = elements;
+
+    reusedElements[0].m_coating.get<Coating::OneCoating>().reflectivityTableOffset        = -1;
+    reusedElements[1].m_coating.get<Coating::MultilayerCoating>().reflectivityTableOffset = -1;
+    EXPECT_EQ(assignReflectivityTableOffsets(reusedElements, config), tables.size());
+    EXPECT_EQ(reusedElements[0].m_coating.get<Coating::OneCoating>().reflectivityTableOffset,
+              elements[0].m_coating.get<Coating::OneCoating>().reflectivityTableOffset);
+    EXPECT_EQ(reusedElements[1].m_coating.get<Coating::MultilayerCoating>().reflectivityTableOffset,
+              elements[1].m_coating.get<Coating::MultilayerCoating>().reflectivityTableOffset);
+}
+
 TEST_F(TestSuite, testSphericalCoords) {
     std::vector<glm::dvec3> directions = {
         {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}, {-1.0, 0.0, 0.0}, {0.0, -1.0, 0.0}, {0.0, 0.0, -1.0},
@@ -1496,3 +1904,347 @@ TEST_F(TestSuite, testComputeEta) {
         CHECK_EQ(eta.imag(), tc.expected.imag());
     }
 }
+
+TEST_F(TestSuite, testElementBvhMatchesBruteForce) {
+    const auto beamline              = loadBeamline("METRIX_U41_G1_H1_318eV_PS_MLearn_v114");
+    const auto elementsAndTransforms = beamline.compileElements();
+    const auto numElements           = static_cast<int>(elementsAndTransforms.size());
+    const auto bvhNodes              = buildElementBvh(elementsAndTransforms);
+
+    auto elements         = std::vector<OpticalElement>();
+    auto objectTransforms = std::vector<AffineObjectTransform>();
+    auto centers          = std::vector<glm::dvec3>();
+    for (const auto& e : elementsAndTransforms) {
+        elements.push_back(e.element);
+        objectTransforms.push_back(toAffineObjectTransform(e.transform));
+        centers.push_back(glm::dvec3(e.transform.m_outTrans * glm::dvec4(0, 0, 0, 1)));
+    }
+
+    // rays from around each element towards each other element, and in random directions
+    auto rng    = std::mt19937(42);
+    auto offset = std::uniform_real_distribution<double>(-10.0, 10.0);
+    auto rays   = std::vector<std::pair<glm::dvec3, glm::dvec3>>();
+    for (int i = 0; i < numElements; ++i) {
+        for (int j = 0; j < numElements; ++j) {
+            const auto position = centers[i] + glm::dvec3(offset(rng), offset(rng), offset(rng));
+            const auto target   = centers[j] + glm::dvec3(offset(rng), offset(rng), offset(rng));
+            rays.emplace_back(position, glm::normalize(target - position));
+            rays.emplace_back(position, glm::normalize(glm::dvec3(offset(rng), offset(rng), offset(rng))));
+        }
+    }
+
+    auto numCollisions = 0;
+    for (size_t i = 0; i < rays.size(); ++i) {
+        const auto& [position, direction] = rays[i];
+        auto randBruteForce               = Rand(static_cast<RandCounter>(i));
+        auto randBvh                      = Rand(static_cast<RandCounter>(i));
+
+        const auto colBruteForce = findCollisionWithElements(position, direction, elements.data(), objectTransforms.data(), nullptr, 0, 0,
+                                                             numElements, randBruteForce);
+        const auto colBvh        = findCollisionWithElements(position, direction, elements.data(), objectTransforms.data(), bvhNodes.data(),
+                                                             static_cast<int>(bvhNodes.size()), 0, numElements, randBvh);
+
+        ASSERT_EQ(colBruteForce.has_value(), colBvh.has_value());
+        EXPECT_EQ(randBruteForce.counter, randBvh.counter);
+        if (!colBruteForce) continue;
+
+        ++numCollisions;
+        EXPECT_EQ(colBruteForce->elementIndex, colBvh->elementIndex);
+        EXPECT_EQ(colBruteForce->point.hitpoint, colBvh->point.hitpoint);
+        EXPECT_EQ(colBruteForce->point.normal, colBvh->point.normal);
+    }
+
+    EXPECT_LT(0, numCollisions);
+}
+
+namespace {
+
+// y = 0.01 z^2 + 1e-4 x^2 z, tilted by psi
+constexpr auto TEST_CUBIC = Surface::Cubic{
+    .m_a11 = 0.0,
+    .m_a12 = 0.0,
+    .m_a13 = 0.0,
+    .m_a14 = 0.0,
+    .m_a22 = 0.0,
+    .m_a23 = 0.0,
+    .m_a24 = -0.5,
+    .m_a33 = 0.01,
+    .m_a34 = 0.0,
+    .m_a44 = 0.0,
+    .m_b12 = 0.0,
+    .m_b13 = 1e-4,
+    .m_b21 = 0.0,
+    .m_b23 = 0.0,
+    .m_b31 = 0.0,
+    .m_b32 = 0.0,
+    .m_psi = 0.05,
+};
+
+std::vector<std::pair<glm::dvec3, glm::dvec3>> makeCubicTestRays(const int numRays) {
+    auto rng    = std::mt19937(42);
+    auto offset = std::uniform_real_distribution<double>(-20.0, 20.0);
+    auto tilt   = std::uniform_real_distribution<double>(-0.3, 0.3);
+    auto rays   = std::vector<std::pair<glm::dvec3, glm::dvec3>>();
+    for (int i = 0; i < numRays; ++i) {
+        const auto position  = glm::dvec3(offset(rng), 100.0, offset(rng));
+        const auto direction = glm::normalize(glm::dvec3(tilt(rng), -1.0, tilt(rng)));
+        rays.emplace_back(position, direction);
+    }
+    return rays;
+}
+
+}  // unnamed namespace
+
+TEST_F(TestSuite, testCubicCollision) {
+    const auto& cu = TEST_CUBIC;
+
+    const auto surfaceEquation = [&](const glm::dvec3 p) {
+        const auto x = p.x;
+        const auto y = p.y;
+        const auto z = p.z;
+        return cu.m_a11 * x * x + cu.m_a22 * y * y + cu.m_a33 * z * z + 2 * cu.m_a12 * x * y + 2 * cu.m_a13 * x * z + 2 * cu.m_a23 * y * z +
+               2 * cu.m_a14 * x + 2 * cu.m_a24 * y + 2 * cu.m_a34 * z + cu.m_a44 + cu.m_b12 * x * x * y + cu.m_b13 * x * x * z +
+               cu.m_b21 * y * y * x + cu.m_b23 * y * y * z + cu.m_b31 * z * z * x + cu.m_b32 * z * z * y;
+    };
+
+    for (const auto& [position, direction] : makeCubicTestRays(1000)) {
+        const auto col = getCubicCollision(position, direction, cu);
+        ASSERT_TRUE(col.has_value());
+
+        // the hitpoint is on the ray and on the surface
+        const auto toHit = col->hitpoint - position;
+        EXPECT_NEAR(glm::length(glm::cross(toHit, direction)), 0.0, 1e-9);
+        EXPECT_NEAR(surfaceEquation(cubicPosition(col->hitpoint, cu.m_psi)), 0.0, 1e-9);
+        EXPECT_NEAR(glm::length(col->normal), 1.0, 1e-12);
+    }
+
+    // sphere with imaginary radius, x^2 + y^2 + z^2 + 1 = 0
+    const auto noSurface = Surface::Cubic{.m_a11 = 1.0, .m_a22 = 1.0, .m_a33 = 1.0, .m_a44 = 1.0};
+    EXPECT_FALSE(getCubicCollision(glm::dvec3(0, 100, 0), glm::dvec3(0, -1, 0), noSurface).has_value());
+}
+
+// run with --gtest_also_run_disabled_tests --gtest_filter=*benchmarkCubicCollision
+TEST_F(TestSuite, DISABLED_benchmarkCubicCollision) {
+    constexpr int numRays = 1 << 20;
+    const auto rays       = makeCubicTestRays(numRays);
+
+    auto numCollisions = 0;
+    const auto start   = std::chrono::steady_clock::now();
+    for (const auto& [position, direction] : rays) numCollisions += getCubicCollision(position, direction, TEST_CUBIC).has_value() ? 1 : 0;
+    const auto end = std::chrono::steady_clock::now();
+
+    const auto nanoseconds = std::chrono::duration<double, std::nano>(end - start).count();
+    RAYX_LOG << "cubic collision: " << nanoseconds / numRays << " ns per ray, " << numCollisions << " of " << numRays << " rays hit";
+    EXPECT_EQ(numCollisions, numRays);
+}
+
+namespace {
+
+// toroid of the beamline "toroid"
+constexpr auto TEST_TOROID = Surface::Toroid{
+    .m_longRadius  = 10470.4917,
+    .m_shortRadius = 315.723959,
+    .m_toroidType  = ToroidType::Concave,
+    .m_solver      = ToroidSolver::Newton,
+};
+
+// grazing incidence rays towards the area around the origin
+std::vector<std::pair<glm::dvec3, glm::dvec3>> makeToroidTestRays(const int numRays) {
+    auto rng     = std::mt19937(42);
+    auto offsetX = std::uniform_real_distribution<double>(-20.0, 20.0);
+    auto offsetZ = std::uniform_real_distribution<double>(-100.0, 100.0);
+    auto grazing = std::uniform_real_distribution<double>(0.01, 0.1);
+    auto tilt    = std::uniform_real_distribution<double>(-0.05, 0.05);
+    auto rays    = std::vector<std::pair<glm::dvec3, glm::dvec3>>();
+    for (int i = 0; i < numRays; ++i) {
+        const auto target    = glm::dvec3(offsetX(rng), 0.0, offsetZ(rng));
+        const auto direction = glm::normalize(glm::dvec3(glm::sin(tilt(rng)), -glm::sin(grazing(rng)), 1.0));
+        rays.emplace_back(target - 1000.0 * direction, direction);
+    }
+    return rays;
+}
+
+}  // unnamed namespace
+
+TEST_F(TestSuite, testToroidCollisionSolvers) {
+    const auto rays = makeToroidTestRays(10000);
+
+    for (const auto toroidType : {ToroidType::Concave, ToroidType::Convex}) {
+        auto reference         = TEST_TOROID;
+        reference.m_toroidType = toroidType;
+
+        auto meanIterations = std::vector<double>();
+        for (const auto solver : {ToroidSolver::Newton, ToroidSolver::SeededNewton, ToroidSolver::Quartic}) {
+            auto toroid     = reference;
+            toroid.m_solver = solver;
+
+            auto numIterations = std::vector<int>();
+            for (const auto& [position, direction] : rays) {
+                auto n               = 0;
+                auto nReference      = 0;
+                const auto col       = getToroidCollision(position, direction, toroid, false, n);
+                const auto colNewton = getToroidCollision(position, direction, reference, false, nReference);
+                ASSERT_EQ(col.has_value(), colNewton.has_value());
+                if (!col) continue;
+
+                // all solvers stop at the same tolerance of the newton steps
+                EXPECT_NEAR(glm::length(col->hitpoint - colNewton->hitpoint), 0.0, 1e-3);
+                numIterations.push_back(n);
+            }
+
+            const auto mean = std::accumulate(numIterations.begin(), numIterations.end(), 0.0) / numIterations.size();
+            RAYX_LOG << "toroid solver " << static_cast<int>(solver) << ": " << mean << " newton steps on average, at most "
+                     << *std::max_element(numIterations.begin(), numIterations.end());
+            meanIterations.push_back(mean);
+        }
+
+        // the seeded solvers converge in 1-3 steps
+        EXPECT_LT(meanIterations[1], meanIterations[0]);
+        EXPECT_LE(meanIterations[1], 3.0);
+        EXPECT_LE(meanIterations[2], 3.0);
+    }
+}
+
+// run with --gtest_also_run_disabled_tests --gtest_filter=*benchmarkToroidCollision
+TEST_F(TestSuite, DISABLED_benchmarkToroidCollision) {
+    constexpr int numRays = 1 << 20;
+    const auto rays       = makeToroidTestRays(numRays);
+
+    for (const auto solver : {ToroidSolver::Newton, ToroidSolver::SeededNewton, ToroidSolver::Quartic}) {
+        auto toroid     = TEST_TOROID;
+        toroid.m_solver = solver;
+
+        auto numCollisions = 0;
+        auto numIterations = 0;
+        const auto start   = std::chrono::steady_clock::now();
+        for (const auto& [position, direction] : rays) {
+            auto n = 0;
+            numCollisions += getToroidCollision(position, direction, toroid, false, n).has_value() ? 1 : 0;
+            numIterations += n;
+        }
+        const auto end = std::chrono::steady_clock::now();
+
+        const auto nanoseconds = std::chrono::duration<double, std::nano>(end - start).count();
+        RAYX_LOG << "toroid solver " << static_cast<int>(solver) << ": " << nanoseconds / numRays << " ns per ray, "
+                 << static_cast<double>(numIterations) / numRays << " newton steps per ray, " << numCollisions << " of " << numRays << " rays hit";
+    }
+}
+
+namespace {
+
+// quadrics that take both solutions of getQuadricCollision: a sphere, a tilted ellipsoid with mixed terms, and a degenerate quadric without
+// quadratic terms
+constexpr Surface::Quadric TEST_QUADRICS[] = {
+    {.m_icurv = 1, .m_a11 = 1, .m_a12 = 0, .m_a13 = 0, .m_a14 = 0, .m_a22 = 1, .m_a23 = 0, .m_a24 = -100, .m_a33 = 1, .m_a34 = 0, .m_a44 = 0},
+    {.m_icurv = -1, .m_a11 = 1, .m_a12 = 0.1, .m_a13 = -0.2, .m_a14 = 3, .m_a22 = 0.5, .m_a23 = 0.05, .m_a24 = -40, .m_a33 = 2, .m_a34 = 1,
+     .m_a44 = -900},
+    {.m_icurv = 1, .m_a11 = 0, .m_a12 = 0, .m_a13 = 0, .m_a14 = 0, .m_a22 = 0, .m_a23 = 0, .m_a24 = -1, .m_a33 = 0, .m_a34 = 0, .m_a44 = 10},
+};
+
+// rays in all directions, so that every case of getQuadricCollision is taken, and some rays miss or hit behind their position
+std::vector<std::pair<glm::dvec3, glm::dvec3>> makePacketTestRays(const int numRays) {
+    auto rng       = std::mt19937(42);
+    auto offset    = std::uniform_real_distribution<double>(-50.0, 50.0);
+    auto component = std::uniform_real_distribution<double>(-1.0, 1.0);
+    auto rays      = std::vector<std::pair<glm::dvec3, glm::dvec3>>();
+    for (int i = 0; i < numRays; ++i) {
+        const auto position  = glm::dvec3(offset(rng), offset(rng), offset(rng));
+        const auto direction = glm::normalize(glm::dvec3(component(rng), component(rng), component(rng)));
+        rays.emplace_back(position, direction);
+    }
+    return rays;
+}
+
+// fills packet `packetIndex` of `rays`. lanes beyond the end of the rays are not active
+RayPacket makeRayPacket(const std::vector<std::pair<glm::dvec3, glm::dvec3>>& rays, const int packetIndex) {
+    auto packet = RayPacket{};
+    for (int lane = 0; lane < RAY_PACKET_SIZE; ++lane) {
+        const auto i        = std::min(packetIndex * RAY_PACKET_SIZE + lane, static_cast<int>(rays.size()) - 1);
+        packet.active[lane] = packetIndex * RAY_PACKET_SIZE + lane < static_cast<int>(rays.size());
+        packet.position(lane, rays[i].first);
+        packet.direction(lane, rays[i].second);
+    }
+    return packet;
+}
+
+}  // unnamed namespace
+
+TEST_F(TestSuite, testPacketCollisions) {
+    // the lanes of a packet must yield bitwise the same collisions as the scalar functions. the last packet is partially filled
+    const auto rays       = makePacketTestRays(1001);
+    const auto numPackets = (static_cast<int>(rays.size()) + RAY_PACKET_SIZE - 1) / RAY_PACKET_SIZE;
+
+    const auto checkPacket = [&](const RayPacket& packet, const PacketCollisions& cols, const auto& scalarCollision) {
+        auto numHits = 0;
+        for (int lane = 0; lane < RAY_PACKET_SIZE; ++lane) {
+            const auto col = packet.active[lane] ? scalarCollision(packet.position(lane), packet.direction(lane)) : std::nullopt;
+            EXPECT_EQ(cols.hit[lane], col.has_value());
+            if (!col || !cols.hit[lane]) continue;
+
+            ++numHits;
+            EXPECT_EQ(cols.hitpoint_x[lane], col->hitpoint.x);
+            EXPECT_EQ(cols.hitpoint_y[lane], col->hitpoint.y);
+            EXPECT_EQ(cols.hitpoint_z[lane], col->hitpoint.z);
+            EXPECT_EQ(cols.normal_x[lane], col->normal.x);
+            EXPECT_EQ(cols.normal_y[lane], col->normal.y);
+            EXPECT_EQ(cols.normal_z[lane], col->normal.z);
+        }
+        return numHits;
+    };
+
+    auto numPlaneHits = 0;
+    for (int packetIndex = 0; packetIndex < numPackets; ++packetIndex) {
+        const auto packet = makeRayPacket(rays, packetIndex);
+        auto cols         = PacketCollisions{};
+        getPlaneCollisions(packet, cols);
+        numPlaneHits += checkPacket(packet, cols, [](const glm::dvec3& position, const glm::dvec3& direction) {
+            return getPlaneCollision(position, direction);
+        });
+    }
+    EXPECT_LT(0, numPlaneHits);
+    EXPECT_LT(numPlaneHits, static_cast<int>(rays.size()));
+
+    for (const auto& quadric : TEST_QUADRICS) {
+        auto numQuadricHits = 0;
+        for (int packetIndex = 0; packetIndex < numPackets; ++packetIndex) {
+            const auto packet = makeRayPacket(rays, packetIndex);
+            auto cols         = PacketCollisions{};
+            getQuadricCollisions(packet, quadric, cols);
+            numQuadricHits += checkPacket(packet, cols, [&](const glm::dvec3& position, const glm::dvec3& direction) {
+                return getQuadricCollision(position, direction, quadric);
+            });
+        }
+        EXPECT_LT(0, numQuadricHits);
+        EXPECT_LT(numQuadricHits, static_cast<int>(rays.size()));
+    }
+}
+
+// run with --gtest_also_run_disabled_tests --gtest_filter=*benchmarkPacketCollisions
+TEST_F(TestSuite, DISABLED_benchmarkPacketCollisions) {
+    constexpr int numRays    = 1 << 20;
+    constexpr int numPackets = numRays / RAY_PACKET_SIZE;
+    const auto rays          = makePacketTestRays(numRays);
+    const auto& quadric      = TEST_QUADRICS[1];
+
+    auto packets = std::vector<RayPacket>();
+    for (int packetIndex = 0; packetIndex < numPackets; ++packetIndex) packets.push_back(makeRayPacket(rays, packetIndex));
+
+    auto numScalarHits = 0;
+    const auto start   = std::chrono::steady_clock::now();
+    for (const auto& [position, direction] : rays) numScalarHits += getQuadricCollision(position, direction, quadric).has_value() ? 1 : 0;
+    const auto middle = std::chrono::steady_clock::now();
+
+    auto numPacketHits = 0;
+    auto cols          = PacketCollisions{};
+    for (const auto& packet : packets) {
+        getQuadricCollisions(packet, quadric, cols);
+        for (int lane = 0; lane < RAY_PACKET_SIZE; ++lane) numPacketHits += cols.hit[lane] ? 1 : 0;
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const auto scalarNanoseconds = std::chrono::duration<double, std::nano>(middle - start).count();
+    const auto packetNanoseconds = std::chrono::duration<double, std::nano>(end - middle).count();
+    RAYX_LOG << "quadric collision: " << scalarNanoseconds / numRays << " ns per ray scalar, " << packetNanoseconds / numRays
+             << " ns per ray in packets of " << RAY_PACKET_SIZE << ", " << numPacketHits << " of " << numRays << " rays hit";
+    EXPECT_EQ(numPacketHits, numScalarHits);
+}
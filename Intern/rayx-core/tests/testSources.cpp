@@ -1,4 +1,5 @@
 #include <fstream>
+#include <numeric>
 
 #include "Shader/LightSources/DipoleSource.h"
 #include "setupTests.h"
@@ -215,6 +216,54 @@ TEST_F(TestSuite, testSchwingerDipole) {
     }
 }
 
+TEST_F(TestSuite, testDipoleSamplingTable) {
+    const auto beamline      = loadBeamline("dipole_energySpread");
+    const auto& designSource = *beamline.getSources()[0];
+    auto source              = DipoleSource(designSource);
+    const auto table         = source.calcSamplingTable();
+    source.setSamplingTable(table.data());
+
+    const auto photonEnergy   = designSource.getEnergy();
+    const auto halfSpread     = std::abs(designSource.getEnergySpread()) / 2.0;
+    const auto electronEnergy = designSource.getElectronEnergy();
+    const auto gamma          = calcGamma(electronEnergy);
+    const auto criticalEnergy = get_factorCriticalEnergy();
+    const auto verDivergence  = calcVerDivergence(photonEnergy, designSource.getVerEBeamDivergence(), electronEnergy, criticalEnergy);
+
+    // psi is within 3 times the vertical divergence (in mrad), plus the fold with the electron beam divergence
+    const auto maxPsi = (3.0 * verDivergence + 2.0e-3 * std::abs(designSource.getVerEBeamDivergence())) * 1e-3 + 1e-12;
+
+    // histogram of the sampled energies
+    constexpr int numRays = 100000;
+    constexpr int numBins = 20;
+    auto histogram        = std::array<int, numBins>{};
+    for (int i = 0; i < numRays; ++i) {
+        auto rand      = Rand(i, numRays, 0.42);
+        const auto ray = source.genRay(i, 0, rand);
+        CHECK_IN(ray.energy, photonEnergy - halfSpread, photonEnergy + halfSpread);
+        CHECK_IN(std::abs(std::asin(ray.direction.y)), 0.0, maxPsi);
+        const auto bin = std::min(static_cast<int>((ray.energy - photonEnergy + halfSpread) / (2.0 * halfSpread) * numBins), numBins - 1);
+        ++histogram[bin];
+    }
+
+    // expected fraction of rays per bin, integral of the schwinger distribution
+    auto expected = std::array<double, numBins>{};
+    for (int bin = 0; bin < numBins; ++bin) {
+        for (int j = 0; j < 100; ++j) {
+            const auto energy = photonEnergy - halfSpread + 2.0 * halfSpread * (bin + (j + 0.5) / 100) / numBins;
+            expected[bin] += schwinger(energy, gamma, criticalEnergy);
+        }
+    }
+    const auto total = std::accumulate(expected.begin(), expected.end(), 0.0);
+
+    for (int bin = 0; bin < numBins; ++bin) {
+        const auto p         = expected[bin] / total;
+        const auto stddev    = std::sqrt(numRays * p * (1.0 - p));
+        const auto deviation = std::abs(histogram[bin] - numRays * p);
+        EXPECT_LE(deviation, 5.0 * stddev + 1.0) << "bin " << bin;
+    }
+}
+
 TEST_F(TestSuite, testLightsourceGetters) {
     struct RmlInput {
         std::string rmlFile;
@@ -0,0 +1,20 @@
+// rayx-material-db: precompiles the material tables in Data/ into the binary material database, see Material/MaterialDatabase.h
+// usage: rayx-material-db <output file>
+
+#include <iostream>
+
+#include "Material/MaterialDatabase.h"
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::cerr << "usage: " << argv[0] << " <output file>" << std::endl;
+        return 1;
+    }
+
+    if (!rayx::MaterialDatabase::write(argv[1])) {
+        std::cerr << "failed to write material database " << argv[1] << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
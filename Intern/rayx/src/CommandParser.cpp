@@ -7,6 +7,7 @@
 #include "Random.h"
 #include "TerminalAppConfig.h"
 #include "Tracer/Tracer.h"
+#include "Writer/RaysWriteQueue.h"
 
 namespace {
 
@@ -63,10 +64,24 @@ CliArgs parseCliArgs(const int argc, char const* const* const argv) {
                    "Pick device via device index. Available devices are determined by --cpu and --gpu. Default: the best device will be picked "
                    "automatically. Use --list-devices to see the available devices");
     app.add_flag("-c,--csv", args.csv, "Output stored as csv instead of H5 file");
+    app.add_flag("--verify-csv", args.verifyCsv,
+                 "Read the csv output file back and compare it to the traced rays. Requires --csv and --sort-by-object-id, which holds all rays in "
+                 "memory");
     app.add_flag("-V,--verbose", args.verbose, "Dump more information");
     app.add_option("-m,--maxevents", args.maxEvents,
                    "Maximum number of events per ray. Default: A multiple of the number of objects to record events for");
-    app.add_option("-b,--batch-size", args.batchSize, std::format("Batch size for tracing. Default: {}", rayx::DEFAULT_BATCH_SIZE));
+    app.add_option("-b,--batch-size", args.batchSize,
+                   std::format("Maximum batch size for tracing. Default: {}, or the largest batch size that fits into --memory-budget",
+                               rayx::DEFAULT_BATCH_SIZE));
+    app.add_option("-M,--memory-budget", args.memoryBudget,
+                   "Memory budget for the buffers of a batch, e.g. 8G or 512M. Picks the largest batch size that fits into the budget and into the "
+                   "free device and host memory")
+        ->transform(CLI::AsSizeValue(false));
+    app.add_option("-W,--write-queue-memory", args.writeQueueMemory,
+                   std::format("Memory limit for traced events that wait to be written to the output file, e.g. 2G or 512M. Tracing pauses while "
+                               "the limit is exceeded. Default: {}M",
+                               rayx::DEFAULT_WRITE_QUEUE_MEMORY >> 20))
+        ->transform(CLI::AsSizeValue(false));
     app.add_option("-n,--number-of-rays", args.numberOfRays, "Override the number of rays for all sources");
     app.add_flag("-B,--benchmark", args.benchmark, "Dump benchmark durations");
     app.add_flag("-O,--sort-by-object-id", args.sortByObjectId, "Sort rays by object_id before writing to output file");
@@ -116,6 +131,8 @@ CliArgs parseCliArgs(const int argc, char const* const* const argv) {
     }
 
     if (args.append && args.csv) RAYX_EXIT << "error: appending to existing output files is not supported for csv output";
+    // streamed output is written batch by batch and never held in memory as a whole, so there is nothing to compare the file to
+    if (args.verifyCsv && !(args.csv && args.sortByObjectId)) RAYX_EXIT << "error: --verify-csv requires --csv and --sort-by-object-id";
 
     return args;
 }
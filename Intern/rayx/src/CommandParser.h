@@ -14,6 +14,7 @@ struct CliArgs {
     bool sequential  = false;  // -S --sequential
     bool verbose     = false;  // -V --verbose
     bool defaultSeed = false;  // -f, --default-seed
+    bool verifyCsv   = false;  // --verify-csv
     // TODO: maybe we should allow custom sorting by attribute name?
     // TODO: maybe we can use this flag to even sort existing h5 files, that are given as input?
     bool sortByObjectId = false;              // -O --sort-by-object-id
@@ -25,6 +26,8 @@ struct CliArgs {
     std::optional<std::string> outputPath;    // -o --output
     std::optional<int> seed;                  // -s, --seed
     std::optional<int> batchSize;             // -b --batch-size
+    std::optional<size_t> memoryBudget;       // -M --memory-budget
+    std::optional<size_t> writeQueueMemory;   // -W --write-queue-memory
     std::optional<int> deviceId;              // -d --device
     std::vector<int> objectRecordIndices;     // -R --record-indices
     std::vector<std::string> attrRecordMask;  // -A --attributes
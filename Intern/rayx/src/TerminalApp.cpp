@@ -8,7 +8,9 @@
 #include <algorithm>
 #include <filesystem>
 #include <memory>
+#include <optional>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "Beamline/StringConversion.h"
@@ -53,6 +55,20 @@ void dumpBeamline(const fs::path& filepath) {
     dumpBeamlineObjects(beamline.get());
 }
 
+std::string formatDuration(const std::chrono::steady_clock::duration duration) {
+    using namespace std::chrono;
+    using namespace std::chrono_literals;
+    const auto elapsed_time = duration_cast<milliseconds>(duration);
+    const auto mins         = duration_cast<minutes>(elapsed_time);
+    const auto secs         = duration_cast<seconds>(elapsed_time % 1min);
+    const auto millis       = duration_cast<milliseconds>(elapsed_time % 1s);
+
+    auto str = std::string();
+    if (mins > 0min) str += std::to_string(mins.count()) + "m ";
+    if (secs > 0s) str += std::to_string(secs.count()) + "s ";
+    return str + std::to_string(millis.count()) + "ms";
+}
+
 #ifndef NO_H5
 void scanGroup(const HighFive::Group& group, const int depth = 0, const std::string& path = "/") {
     size_t num_objs = group.getNumberObjects();
@@ -143,8 +159,9 @@ int TerminalApp::tracePath(const fs::path& path) {
 }
 
 void TerminalApp::traceRmlAndExportRays(const fs::path& inputFilepath) {
-    using namespace std::chrono;
-    const auto start_time = steady_clock::now();
+    auto report           = std::make_shared<ExportReport>();
+    report->inputFilepath = inputFilepath;
+    report->start         = ExportReport::Clock::now();
 
     std::cout << "Processing: " << inputFilepath << std::endl;
 
@@ -153,29 +170,60 @@ void TerminalApp::traceRmlAndExportRays(const fs::path& inputFilepath) {
 
     const auto beamline = loadBeamline(inputFilepath);
 
-    const auto rays = traceBeamline(beamline, attrRecordMask);
+    // sorting by object id requires all events at once. otherwise the events are written batch by batch while tracing
+    if (m_cliArgs.sortByObjectId) {
+        auto rays = traceBeamline(beamline, attrRecordMask);
+        exportAsync(report, std::move(rays), [this, report, objectNames = beamline.getObjectNames(), attrRecordMask](rayx::Rays&& rays) {
+            report->outputFilepath = exportRays(report->inputFilepath, objectNames, rays, attrRecordMask);
+        });
+    } else {
+        traceBeamlineAndExportRays(report, beamline, attrRecordMask);
+    }
+    report->traceTime = ExportReport::Clock::now() - report->start;
 
-    const auto objectNames    = beamline.getObjectNames();
-    const auto outputFilepath = exportRays(inputFilepath, objectNames, rays, attrRecordMask);
+    // the report is complete after the writes of this file. the device continues with the next file in the meantime
+    m_writeQueue->push(rayx::Rays(), [report](rayx::Rays&&) {
+        report->end = ExportReport::Clock::now();
+        report->done.store(true, std::memory_order_release);
+    });
+    m_pendingReports.push_back(report);
 
-    // print elapsed time and output filepath
+    printExportReports(false);
+}
 
-    using namespace std::chrono_literals;
-    const auto end_time     = steady_clock::now();
-    const auto elapsed_time = duration_cast<milliseconds>(end_time - start_time);
-    const auto mins         = duration_cast<minutes>(elapsed_time);
-    const auto secs         = duration_cast<seconds>(elapsed_time % 1min);
-    const auto millis       = duration_cast<milliseconds>(elapsed_time % 1s);
+void TerminalApp::exportAsync(const std::shared_ptr<ExportReport>& report, rayx::Rays&& rays, std::function<void(rayx::Rays&&)> write) {
+    m_writeQueue->push(std::move(rays), [this, report, write = std::move(write)](rayx::Rays&& rays) {
+        using Clock = ExportReport::Clock;
 
-    std::cout << "Finished in ";
-    if (mins > 0min) std::cout << mins.count() << "m ";
-    if (secs > 0s) std::cout << secs.count() << "s ";
-    std::cout << millis.count() << "ms.";
+        const auto waitTimeBefore = m_writeQueue->producerWaitTime();
+        const auto start          = Clock::now();
+        write(std::move(rays));
+        const auto writeTime = Clock::now() - start;
+        const auto waitTime  = m_writeQueue->producerWaitTime() - waitTimeBefore;
 
-    if (outputFilepath.empty())
-        std::cout << " No rays were exported." << std::endl;
-    else
-        std::cout << " Exported rays to: " << fs::absolute(outputFilepath) << std::endl;
+        // while the main thread waits for the writer, it does not trace
+        report->writeTime += writeTime;
+        report->overlapTime += std::max(writeTime - waitTime, Clock::duration::zero());
+    });
+}
+
+void TerminalApp::printExportReports(const bool wait) {
+    if (wait) m_writeQueue->flush();
+
+    while (!m_pendingReports.empty() && m_pendingReports.front()->done.load(std::memory_order_acquire)) {
+        const auto& report = *m_pendingReports.front();
+
+        std::cout << "Finished " << report.inputFilepath << " in " << formatDuration(report.end - report.start)
+                  << " (trace: " << formatDuration(report.traceTime) << ", write: " << formatDuration(report.writeTime) << ", "
+                  << formatDuration(report.overlapTime) << " of writing overlapped with tracing).";
+
+        if (report.outputFilepath.empty())
+            std::cout << " No rays were exported." << std::endl;
+        else
+            std::cout << " Exported rays to: " << fs::absolute(report.outputFilepath) << std::endl;
+
+        m_pendingReports.pop_front();
+    }
 }
 
 rayx::Beamline TerminalApp::loadBeamline(const fs::path& filepath) {
@@ -200,6 +248,23 @@ rayx::Beamline TerminalApp::loadBeamline(const fs::path& filepath) {
 rayx::Rays TerminalApp::traceBeamline(const rayx::Beamline& beamline, const rayx::RayAttrMask attrRecordMask) {
     RAYX_PROFILE_FUNCTION_STDOUT();
 
+    auto batches = std::vector<rayx::Rays>();
+    traceBeamline(beamline, attrRecordMask, [&batches](rayx::Rays&& batch) { batches.push_back(std::move(batch)); });
+    auto rays = rayx::Rays::concat(batches);
+
+    if (m_cliArgs.sortByObjectId) {
+        if (!(attrRecordMask & rayx::RayAttrMask::ObjectId))
+            RAYX_WARN << "Cannot sort by object_id, because object_id is not recorded. Please add object_id to the attribute record mask.";
+
+        rays = rays.sortByObjectId();
+    }
+
+    return rays;
+}
+
+void TerminalApp::traceBeamline(const rayx::Beamline& beamline, const rayx::RayAttrMask attrRecordMask, const rayx::RaysSink& sink) {
+    RAYX_PROFILE_FUNCTION_STDOUT();
+
     // dump beamline objects
     if (rayx::getDebugVerbose()) { dumpBeamlineObjects(&beamline); }
 
@@ -235,31 +300,27 @@ rayx::Rays TerminalApp::traceBeamline(const rayx::Beamline& beamline, const rayx
     const auto attrRecordMaskTrace = attrRecordMask | rayx::RayAttrMask::EventType;
 
     // do the trace
-    auto rays = m_tracer->trace(beamline, sequential, objectRecordMask, attrRecordMaskTrace, maxEvents, maxBatchSize);
-
-    if (m_cliArgs.sortByObjectId) {
-        if (!(attrRecordMask & rayx::RayAttrMask::ObjectId))
-            RAYX_WARN << "Cannot sort by object_id, because object_id is not recorded. Please add object_id to the attribute record mask.";
-
-        rays = rays.sortByObjectId();
-    }
+    auto eventTypes = rayx::EventTypeMask::None;
+    m_tracer->traceStreaming(
+        beamline,
+        [&](rayx::Rays&& batch) {
+            // collect event types for validation
+            eventTypes = std::ranges::fold_left(
+                batch.event_type.begin(), batch.event_type.end(), eventTypes,
+                [](rayx::EventTypeMask acc, const rayx::EventType eventType) { return acc | rayx::eventTypeToMask(eventType); });
+
+            // return to the user-specified attribute record mask
+            batch.filterByAttrMask(attrRecordMask);
+
+            sink(std::move(batch));
+        },
+        sequential, objectRecordMask, attrRecordMaskTrace, maxEvents, maxBatchSize);
 
     // validate using recorded attribute: event type
-    validateEvents(rays);
-
-    // return to the user-specified attribute record mask
-    rays.filterByAttrMask(attrRecordMask);
-
-    return rays;
+    validateEvents(eventTypes);
 }
 
-void TerminalApp::validateEvents(const rayx::Rays& rays) {
-    RAYX_PROFILE_FUNCTION_STDOUT();
-
-    const auto eventTypes =
-        std::ranges::fold_left(rays.event_type.begin(), rays.event_type.end(), rayx::EventTypeMask::None,
-                               [](rayx::EventTypeMask acc, const rayx::EventType eventType) { return acc | rayx::eventTypeToMask(eventType); });
-
+void TerminalApp::validateEvents(const rayx::EventTypeMask eventTypes) {
     if (!!(eventTypes & rayx::EventTypeMask::Uninitialized)) std::cout << "warning: one or more events in output are uninitialized" << std::endl;
     if (!!(eventTypes & rayx::EventTypeMask::FatalError)) std::cout << "warning: fatal error detected for one or more events" << std::endl;
     if (!!(eventTypes & rayx::EventTypeMask::BeyondHorizon))
@@ -326,23 +387,20 @@ void TerminalApp::run() {
             return rayx::DeviceConfig(deviceType).enableBestDevice();
         }
     };
-    m_tracer = std::make_unique<rayx::Tracer>(getDevice());
+    m_tracer = std::make_unique<rayx::Tracer>(getDevice(), rayx::TracerConfig{.memoryBudget = m_cliArgs.memoryBudget});
+    m_writeQueue = std::make_unique<rayx::RaysWriteQueue>(m_cliArgs.writeQueueMemory.value_or(rayx::DEFAULT_WRITE_QUEUE_MEMORY));
 
     if (!m_cliArgs.inputPaths.size()) RAYX_EXIT << "Please provide an input RML file or directory. Use --help for more information";
 
     // trace and export
     auto rmlCounter = 0;
     for (const auto path : m_cliArgs.inputPaths) rmlCounter += tracePath(path);
+    printExportReports(true);
 
     std::cout << "Done. Processed " << rmlCounter << " RML file(s)" << std::endl;
 }
 
-fs::path TerminalApp::exportRays(const fs::path& inputFilepath, const std::vector<std::string>& objectNames, const rayx::Rays& rays,
-                                 const rayx::RayAttrMask attrRecordMask) {
-    RAYX_PROFILE_FUNCTION_STDOUT();
-
-    if (rays.empty()) return {};
-
+fs::path TerminalApp::getOutputFilepath(const fs::path& inputFilepath) {
     fs::path outputFilepath;
     if (m_cliArgs.outputPath) {
         outputFilepath = *m_cliArgs.outputPath;
@@ -358,10 +416,25 @@ fs::path TerminalApp::exportRays(const fs::path& inputFilepath, const std::vecto
         RAYX_EXIT << "Output directory '" << parent.string() << "' does not exist. Create it first or use a different output path.";
     }
 
+    return outputFilepath;
+}
+
+fs::path TerminalApp::exportRays(const fs::path& inputFilepath, const std::vector<std::string>& objectNames, const rayx::Rays& rays,
+                                 const rayx::RayAttrMask attrRecordMask) {
+    RAYX_PROFILE_FUNCTION_STDOUT();
+
+    if (rays.empty()) return {};
+
+    const auto outputFilepath = getOutputFilepath(inputFilepath);
+
     if (m_cliArgs.csv) {
         rayx::writeCsv(outputFilepath, rays);
-        const auto rays2 = rayx::readCsv(outputFilepath);
-        std::cout << (rays == rays2) << std::endl;
+        if (m_cliArgs.verifyCsv) {
+            if (rayx::readCsv(outputFilepath) == rays)
+                RAYX_VERB << "verified csv output file: " << outputFilepath;
+            else
+                RAYX_WARN << "csv output file " << outputFilepath << " does not match the traced rays";
+        }
     } else {
 #ifdef NO_H5
         RAYX_EXIT << "writeH5 called during NO_H5 (HDF5 disabled during build)";
@@ -375,3 +448,49 @@ fs::path TerminalApp::exportRays(const fs::path& inputFilepath, const std::vecto
 
     return outputFilepath;
 }
+
+void TerminalApp::traceBeamlineAndExportRays(const std::shared_ptr<ExportReport>& report, const rayx::Beamline& beamline,
+                                             const rayx::RayAttrMask attrRecordMask) {
+    RAYX_PROFILE_FUNCTION_STDOUT();
+
+#ifdef NO_H5
+    if (!m_cliArgs.csv) RAYX_EXIT << "writeH5 called during NO_H5 (HDF5 disabled during build)";
+#endif
+
+    const auto outputFilepath = getOutputFilepath(report->inputFilepath);
+    const auto objectNames    = beamline.getObjectNames();
+
+    // the writers are only used on the writer thread. the output file is created with the first non-empty batch, so that no file is written if no
+    // events were recorded. the file is closed, when the last batch that holds the writers is released
+    struct Writers {
+        std::optional<rayx::CsvRaysWriter> csv;
+#ifndef NO_H5
+        std::optional<rayx::H5RaysWriter> h5;
+#endif
+    };
+    const auto writers = std::make_shared<Writers>();
+
+    traceBeamline(beamline, attrRecordMask, [&](rayx::Rays&& batch) {
+        if (batch.empty()) return;
+
+        exportAsync(report, std::move(batch), [this, report, writers, outputFilepath, objectNames, attrRecordMask](rayx::Rays&& batch) {
+            if (m_cliArgs.csv) {
+                if (!writers->csv) writers->csv.emplace(outputFilepath, attrRecordMask);
+                writers->csv->write(batch);
+            } else {
+#ifndef NO_H5
+                // the file is kept open across batches, the event datasets are extended by each batch
+                if (!writers->h5) {
+                    if (m_cliArgs.append)
+                        writers->h5.emplace(rayx::H5RaysWriter::append(outputFilepath, attrRecordMask));
+                    else
+                        writers->h5.emplace(outputFilepath, objectNames, attrRecordMask);
+                }
+                writers->h5->write(batch);
+#endif
+            }
+
+            report->outputFilepath = outputFilepath;
+        });
+    });
+}
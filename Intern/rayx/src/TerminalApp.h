@@ -1,7 +1,11 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <deque>
 #include <filesystem>
+#include <functional>
+#include <memory>
 
 #include "Beamline/Beamline.h"
 #include "CommandParser.h"
@@ -9,6 +13,7 @@
 #include "Rays.h"
 #include "TerminalAppConfig.h"
 #include "Tracer/Tracer.h"
+#include "Writer/RaysWriteQueue.h"
 
 class TerminalApp {
   public:
@@ -18,17 +23,47 @@ class TerminalApp {
     void run();
 
   private:
+    /// timing of processing an rml file. the events are written on the writer thread, which publishes its members by setting `done`
+    struct ExportReport {
+        using Clock = std::chrono::steady_clock;
+
+        std::filesystem::path inputFilepath;
+        std::filesystem::path outputFilepath;  // empty if no rays were exported
+        Clock::time_point start;
+        Clock::duration traceTime   = Clock::duration::zero();  // from start until the last batch is traced
+        Clock::duration writeTime   = Clock::duration::zero();
+        Clock::duration overlapTime = Clock::duration::zero();  // part of writeTime, while the main thread was not waiting for the writer
+        Clock::time_point end;
+        std::atomic<bool> done = false;
+    };
+
     int tracePath(const std::filesystem::path& path);
     void traceRmlAndExportRays(const std::filesystem::path& path);
     rayx::Beamline loadBeamline(const std::filesystem::path& filepath);
     rayx::Rays traceBeamline(const rayx::Beamline& beamline, const rayx::RayAttrMask attr);
-    void validateEvents(const rayx::Rays& rays);
+    /// trace beamline and pass the validated events of each batch, filtered by `attr`, to the sink
+    void traceBeamline(const rayx::Beamline& beamline, const rayx::RayAttrMask attr, const rayx::RaysSink& sink);
+    void validateEvents(const rayx::EventTypeMask eventTypes);
+
+    /// @returns the output filename (either .csv or .h5) for the given input file
+    std::filesystem::path getOutputFilepath(const std::filesystem::path& inputFilepath);
 
     /// write rays to file
     /// @returns the output filename (either .csv or .h5)
     std::filesystem::path exportRays(const std::filesystem::path& filepath, const std::vector<std::string>& objectNames, const rayx::Rays& rays,
                                      const rayx::RayAttrMask attr);
 
+    /// trace beamline and write the events to file batch by batch on the writer thread, without holding all events in memory
+    void traceBeamlineAndExportRays(const std::shared_ptr<ExportReport>& report, const rayx::Beamline& beamline, const rayx::RayAttrMask attr);
+
+    /// enqueue `write` to the writer thread and add its duration to the report
+    void exportAsync(const std::shared_ptr<ExportReport>& report, rayx::Rays&& rays, std::function<void(rayx::Rays&&)> write);
+
+    /// print the reports of files that are completely written, in the order the files were processed. if `wait` is true, wait for all writes
+    void printExportReports(const bool wait);
+
     std::unique_ptr<rayx::Tracer> m_tracer;
     CliArgs m_cliArgs;
+    std::deque<std::shared_ptr<ExportReport>> m_pendingReports;
+    std::unique_ptr<rayx::RaysWriteQueue> m_writeQueue;  // declared last, so that pending writes are flushed before the other members are destroyed
 };